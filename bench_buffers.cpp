@@ -0,0 +1,158 @@
+// bench_buffers.cpp
+// Keyed permutation loops on 4 KB pages against huge pages, and on local
+// against remote NUMA memory when the machine has more than one node. dTLB
+// load misses come from perf_event_open where the kernel allows it.
+#include "src/buffers.h"
+#include "src/prng_permute.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+static double seconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// User-space dTLB load misses of this thread; -1 when perf is unavailable.
+class TlbMisses {
+public:
+    TlbMisses() {
+#ifdef __linux__
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HW_CACHE;
+        attr.config = PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                      (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        fd_ = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+#endif
+    }
+    ~TlbMisses() {
+#ifdef __linux__
+        if (fd_ >= 0) close(fd_);
+#endif
+    }
+
+    void start() {
+#ifdef __linux__
+        if (fd_ < 0) return;
+        ioctl(fd_, PERF_EVENT_IOC_RESET, 0);
+        ioctl(fd_, PERF_EVENT_IOC_ENABLE, 0);
+#endif
+    }
+
+    long long stop() {
+        long long count = -1;
+#ifdef __linux__
+        if (fd_ < 0) return -1;
+        ioctl(fd_, PERF_EVENT_IOC_DISABLE, 0);
+        if (read(fd_, &count, sizeof(count)) != (ssize_t)sizeof(count)) count = -1;
+#endif
+        return count;
+    }
+
+private:
+    int fd_ = -1;
+};
+
+// Anonymous memory of this process currently backed by huge pages.
+static long anon_huge_mb() {
+    std::ifstream smaps("/proc/self/smaps_rollup");
+    std::string key;
+    long kb = 0;
+    while (smaps >> key) {
+        if (key == "AnonHugePages:") {
+            smaps >> kb;
+            return kb / 1024;
+        }
+        smaps.ignore(1 << 10, '\n');
+    }
+    return -1;
+}
+
+struct Result {
+    double shuffle_ms = 0;  // building the permutation (itself a random-access loop)
+    double apply_mbs = 0;   // apply_pixel_permutation, gathering
+    double invert_mbs = 0;  // invert_pixel_permutation, scattering
+    double misses_per_pixel = -1;
+    long huge_mb = -1;
+};
+
+// One policy: buffers are allocated (and first touched) by the calling
+// thread, then `run_node` workers' view is simulated by re-pinning before
+// the timed loops.
+static Result run(size_t pixels, HugePages pages, int alloc_node, int run_node, unsigned nodes) {
+    set_buffer_policy({pages, true});
+    Result r;
+    Permutation perm;
+    std::vector<uint8_t> cover;
+    {
+        NumaWorkerScope place(alloc_node < 0 ? 0 : (size_t)alloc_node, alloc_node < 0 ? 0 : nodes);
+        auto start = std::chrono::steady_clock::now();
+        perm = prng_permutation(pixels, "bench");
+        r.shuffle_ms = seconds_since(start) * 1e3;
+        resize_large(cover, pixels * 3);
+        std::mt19937 rng(1);
+        for (auto& b : cover) b = (uint8_t)rng();
+    }
+    r.huge_mb = anon_huge_mb();
+
+    NumaWorkerScope pin(run_node < 0 ? 0 : (size_t)run_node, run_node < 0 ? 0 : nodes);
+    TlbMisses misses;
+    const int rounds = 3;
+    misses.start();
+    auto start = std::chrono::steady_clock::now();
+    std::vector<uint8_t> keyed;
+    for (int i = 0; i < rounds; ++i) keyed = apply_pixel_permutation(cover, perm);
+    r.apply_mbs = cover.size() * rounds / seconds_since(start) / 1e6;
+    start = std::chrono::steady_clock::now();
+    std::vector<uint8_t> back;
+    for (int i = 0; i < rounds; ++i) back = invert_pixel_permutation(keyed, perm);
+    r.invert_mbs = cover.size() * rounds / seconds_since(start) / 1e6;
+    long long count = misses.stop();
+    if (count >= 0) r.misses_per_pixel = (double)count / (2.0 * rounds * pixels);
+    if (back != cover) std::printf("  !! round trip mismatch\n");
+    return r;
+}
+
+static void print(const char* label, const Result& r) {
+    std::printf("%-26s %10.0f %12.0f %12.0f ", label, r.shuffle_ms, r.apply_mbs, r.invert_mbs);
+    if (r.misses_per_pixel >= 0) std::printf("%14.3f", r.misses_per_pixel);
+    else std::printf("%14s", "n/a");
+    std::printf(" %10ld\n", r.huge_mb);
+}
+
+int main(int argc, char* argv[]) {
+    size_t megapixels = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 16;
+    size_t pixels = megapixels * 1000000;
+    unsigned nodes = numa_node_count();
+    std::printf("%zu MP cover: %zu MB pixels, %zu MB permutation, %u NUMA node(s)\n\n", megapixels,
+                pixels * 3 >> 20, pixels * sizeof(size_t) >> 20, nodes);
+    std::printf("%-26s %10s %12s %12s %14s %10s\n", "buffers", "shuffle ms", "apply MB/s", "invert MB/s",
+                "dTLB miss/px", "huge MB");
+
+    print("4 KB pages", run(pixels, HugePages::Off, -1, -1, nodes));
+    print("transparent huge pages", run(pixels, HugePages::Transparent, -1, -1, nodes));
+    print("explicit huge pages", run(pixels, HugePages::Explicit, -1, -1, nodes));
+    if (nodes > 1) {
+        print("THP, local node", run(pixels, HugePages::Transparent, 0, 0, nodes));
+        print("THP, remote node", run(pixels, HugePages::Transparent, (int)nodes - 1, 0, nodes));
+    } else {
+        std::printf("\n(single NUMA node: local/remote comparison skipped)\n");
+    }
+    std::printf("\nexplicit huge pages fall back to THP when /proc/sys/vm/nr_hugepages is 0\n");
+    return 0;
+}
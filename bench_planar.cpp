@@ -0,0 +1,103 @@
+// bench_planar.cpp
+// Planar against interleaved layout: transpose throughput and the per-channel
+// analyses run on either layout through ImageView
+#include "src/analysis.h"
+#include "src/planar.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+static double seconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Runs fn repeatedly for at least ~0.3 s and returns MB/s over `bytes` per call.
+template <typename Fn>
+static double throughput(size_t bytes, Fn&& fn) {
+    size_t iterations = 0;
+    auto start = std::chrono::steady_clock::now();
+    double elapsed = 0;
+    do {
+        fn();
+        ++iterations;
+        elapsed = seconds_since(start);
+    } while (elapsed < 0.3);
+    return bytes * iterations / elapsed / 1e6;
+}
+
+// Plain per-pixel loops, the baseline for the vector transposes.
+static void deinterleave_scalar(const BMPImage& img, PlanarImage& out) {
+    const uint8_t* p = img.data.data();
+    for (int y = 0; y < img.height; ++y) {
+        uint8_t *b = out.row(0, y), *g = out.row(1, y), *r = out.row(2, y);
+        for (int x = 0; x < img.width; ++x, p += 3) {
+            b[x] = p[0];
+            g[x] = p[1];
+            r[x] = p[2];
+        }
+    }
+}
+
+static void interleave_scalar(const PlanarImage& img, BMPImage& out) {
+    uint8_t* p = out.data.data();
+    for (int y = 0; y < img.height(); ++y) {
+        const uint8_t *b = img.row(0, y), *g = img.row(1, y), *r = img.row(2, y);
+        for (int x = 0; x < img.width(); ++x, p += 3) {
+            p[0] = b[x];
+            p[1] = g[x];
+            p[2] = r[x];
+        }
+    }
+}
+
+int main(int argc, char* argv[]) {
+    size_t megapixels = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 16;
+    int side = 1;
+    while ((size_t)side * side < megapixels * 1000000) ++side;
+    // A smooth gradient with noise, so texture and histograms look like a photo
+    BMPImage img{side, side, std::vector<uint8_t>((size_t)side * side * 3)};
+    std::mt19937 rng(1);
+    for (size_t i = 0; i < img.data.size(); ++i)
+        img.data[i] = (uint8_t)(((i / 3) % side * 255 / side + (i % 3) * 40 + rng() % 8) & 0xFF);
+    const size_t bytes = img.data.size();
+    std::printf("%d x %d cover, %zu MB of pixels, 1 thread\n\n", side, side, bytes >> 20);
+
+    PlanarImage planar = to_planar(img, 1);
+    BMPImage back = img;
+    std::printf("%-34s %12s\n", "transpose", "MB/s");
+    std::printf("%-34s %12.0f\n", "interleaved -> planar, scalar",
+                throughput(bytes, [&] { deinterleave_scalar(img, planar); }));
+    std::printf("%-34s %12.0f\n", "interleaved -> planar, vector", throughput(bytes, [&] {
+                    for (int y = 0; y < side; ++y)
+                        deinterleave_row(&img.data[(size_t)y * side * 3], planar.row(0, y), planar.row(1, y),
+                                         planar.row(2, y), side);
+                }));
+    std::printf("%-34s %12.0f\n", "planar -> interleaved, scalar",
+                throughput(bytes, [&] { interleave_scalar(planar, back); }));
+    std::printf("%-34s %12.0f\n", "planar -> interleaved, vector", throughput(bytes, [&] {
+                    for (int y = 0; y < side; ++y)
+                        interleave_row(planar.row(0, y), planar.row(1, y), planar.row(2, y),
+                                       &back.data[(size_t)y * side * 3], side);
+                }));
+    if (back.data != img.data) std::printf("  !! round trip mismatch\n");
+
+    ImageView iv(img), pv(planar);
+    volatile double sink = 0;
+    std::printf("\n%-34s %12s %12s %8s\n", "analysis", "interleaved", "planar", "gain");
+    double ci = throughput(bytes, [&] { sink = sink + analyze_cover(iv, 1).texture_mean; });
+    double cp = throughput(bytes, [&] { sink = sink + analyze_cover(pv, 1).texture_mean; });
+    std::printf("%-34s %10.0f/s %10.0f/s %7.2fx\n", "analyze_cover (MB)", ci, cp, cp / ci);
+    double ai = throughput(bytes, [&] { sink = sink + analyze_channels(iv, 1)[0].variance; });
+    double ap = throughput(bytes, [&] { sink = sink + analyze_channels(pv, 1)[0].variance; });
+    std::printf("%-34s %10.0f/s %10.0f/s %7.2fx\n", "analyze_channels (MB)", ai, ap, ap / ai);
+    double tp = throughput(bytes, [&] { sink = sink + analyze_channels(ImageView(to_planar(img, 1)), 1)[0].variance; });
+    std::printf("%-34s %10.0f/s %10.0f/s %7.2fx\n", "analyze_channels incl. transpose", ai, tp, tp / ai);
+
+    auto a = analyze_channels(iv, 1), b = analyze_channels(pv, 1);
+    for (int c = 0; c < 3; ++c)
+        if (a[c].variance != b[c].variance || a[c].chi_square_p != b[c].chi_square_p)
+            std::printf("  !! channel %d differs between layouts\n", c);
+    return 0;
+}
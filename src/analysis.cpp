@@ -0,0 +1,219 @@
+// analysis.cpp
+// Cover statistics used for capacity planning and detectability estimates
+#include "analysis.h"
+#include "lsb.h"
+#include "parallel.h"
+#include <array>
+#include <cmath>
+#include <cstdlib>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+struct Partial {
+    std::array<uint64_t, 256> histogram{};
+    uint64_t ones = 0;
+    uint64_t diff_sum = 0;
+    uint64_t diff_count = 0;
+    uint64_t textured = 0;
+};
+
+// Upper tail of the chi-square distribution (Wilson-Hilferty approximation).
+double chi_square_upper_tail(double chi2, int dof) {
+    if (dof <= 0) return 1.0;
+    double k = dof;
+    double z = (std::cbrt(chi2 / k) - (1.0 - 2.0 / (9.0 * k))) / std::sqrt(2.0 / (9.0 * k));
+    return 0.5 * std::erfc(z / std::sqrt(2.0));
+}
+
+// Histogram, LSB and neighbour-difference counts of n channel values whose
+// horizontal neighbour sits `left` bytes earlier.
+void accumulate(const uint8_t* row, size_t n, size_t left, Partial& p) {
+    for (size_t i = 0; i < n; ++i) {
+        ++p.histogram[row[i]];
+        p.ones += row[i] & 1;
+    }
+    for (size_t i = left; i < n; ++i) {
+        unsigned d = (unsigned)std::abs(row[i] - row[i - left]);
+        p.diff_sum += d;
+        p.textured += d >= 2;
+    }
+    if (n > left) p.diff_count += n - left;
+}
+
+// Pairs-of-values: LSB replacement equalizes the counts of 2k and 2k+1
+double pairs_of_values_p(const std::array<uint64_t, 256>& histogram) {
+    double chi2 = 0;
+    int pairs = 0;
+    for (int v = 0; v < 256; v += 2) {
+        double expected = (histogram[v] + histogram[v + 1]) / 2.0;
+        if (expected <= 0) continue;
+        double d = histogram[v] - expected;
+        chi2 += d * d / expected;
+        ++pairs;
+    }
+    return chi_square_upper_tail(chi2, pairs - 1);
+}
+
+struct ChannelPartial {
+    // Four histograms so runs of equal values do not wait on one counter
+    std::array<std::array<uint64_t, 256>, 4> histograms{};
+    uint64_t sum = 0, sum_sq = 0, ones = 0, diff_sum = 0, diff_count = 0;
+};
+
+// One row of one channel: pixel x at row[x * Step]. Planar rows (Step 1)
+// take the SSE2 path, where a SAD against zero sums 16 bytes and a SAD
+// against the row shifted by one sums 16 neighbour differences; interleaved
+// rows (Step 3) would have to be gathered first.
+template <size_t Step>
+void accumulate_channel(const uint8_t* row, size_t width, ChannelPartial& p) {
+    size_t x = 0;
+#if defined(__SSE2__)
+    if (Step == 1) {
+        auto load = [](const uint8_t* q) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(q)); };
+        const __m128i zero = _mm_setzero_si128(), lsb = _mm_set1_epi8(1);
+        __m128i sum = zero, ones = zero, diff = zero;
+        while (x + 16 <= width) {
+            // Squares go into 32-bit lanes; 4096 steps cannot overflow them
+            __m128i sq = zero;
+            for (size_t end = std::min(width & ~size_t(15), x + 16 * 4096); x < end; x += 16) {
+                __m128i v = load(row + x);
+                sum = _mm_add_epi64(sum, _mm_sad_epu8(v, zero));
+                ones = _mm_add_epi64(ones, _mm_sad_epu8(_mm_and_si128(v, lsb), zero));
+                if (x) diff = _mm_add_epi64(diff, _mm_sad_epu8(v, load(row + x - 1)));
+                __m128i lo = _mm_unpacklo_epi8(v, zero), hi = _mm_unpackhi_epi8(v, zero);
+                sq = _mm_add_epi32(sq, _mm_add_epi32(_mm_madd_epi16(lo, lo), _mm_madd_epi16(hi, hi)));
+            }
+            alignas(16) uint32_t lanes[4];
+            _mm_store_si128(reinterpret_cast<__m128i*>(lanes), sq);
+            p.sum_sq += (uint64_t)lanes[0] + lanes[1] + lanes[2] + lanes[3];
+        }
+        auto total = [](__m128i v) {
+            return (uint64_t)_mm_cvtsi128_si64(v) + (uint64_t)_mm_cvtsi128_si64(_mm_unpackhi_epi64(v, v));
+        };
+        p.sum += total(sum);
+        p.ones += total(ones);
+        p.diff_sum += total(diff);
+        // The first vector had no left neighbour for its first byte
+        if (x) {
+            for (size_t i = 1; i < 16; ++i) p.diff_sum += (uint64_t)std::abs(row[i] - row[i - 1]);
+        }
+    }
+#endif
+    uint64_t sum = 0, sum_sq = 0, ones = 0, diff_sum = 0;
+    for (size_t i = x; i < width; ++i) {
+        uint32_t v = row[i * Step];
+        sum += v;
+        sum_sq += v * v;
+        ones += v & 1;
+    }
+    for (size_t i = std::max<size_t>(x, 1); i < width; ++i)
+        diff_sum += (uint64_t)std::abs((int)row[i * Step] - (int)row[(i - 1) * Step]);
+    p.sum += sum;
+    p.sum_sq += sum_sq;
+    p.ones += ones;
+    p.diff_sum += diff_sum;
+    size_t i = 0;
+    for (; i + 4 <= width; i += 4) {
+        ++p.histograms[0][row[i * Step]];
+        ++p.histograms[1][row[(i + 1) * Step]];
+        ++p.histograms[2][row[(i + 2) * Step]];
+        ++p.histograms[3][row[(i + 3) * Step]];
+    }
+    for (; i < width; ++i) ++p.histograms[0][row[i * Step]];
+    if (width > 1) p.diff_count += width - 1;
+}
+
+} // namespace
+
+CoverStats analyze_cover(const ImageView& img, unsigned threads) {
+    CoverStats stats;
+    stats.width = img.width;
+    stats.height = img.height;
+    stats.channels = (uint64_t)img.width * img.height * 3;
+    BMPInfo info;
+    info.width = img.width;
+    info.height = img.height;
+    stats.lsb_capacity = lsb_capacity(info);
+    if (!stats.channels) return stats;
+
+    if (threads == 0) threads = default_thread_count();
+    std::vector<Partial> partials(threads);
+    size_t step = (img.height + threads - 1) / threads;
+    parallel_for(threads, threads, [&](size_t begin, size_t end) {
+        for (size_t t = begin; t < end; ++t) {
+            Partial& p = partials[t];
+            size_t y_end = std::min<size_t>(img.height, (t + 1) * step);
+            for (size_t y = t * step; y < y_end; ++y) {
+                // An interleaved row is one run whose horizontal neighbour is
+                // 3 bytes back; a planar row is three runs with it 1 back
+                if (img.planar()) {
+                    for (const ChannelView& c : img.channel) accumulate(c.row((int)y), img.width, 1, p);
+                } else {
+                    accumulate(img.channel[0].row((int)y), (size_t)img.width * 3, 3, p);
+                }
+            }
+        }
+    });
+
+    Partial total;
+    for (const Partial& p : partials) {
+        for (int v = 0; v < 256; ++v) total.histogram[v] += p.histogram[v];
+        total.ones += p.ones;
+        total.diff_sum += p.diff_sum;
+        total.diff_count += p.diff_count;
+        total.textured += p.textured;
+    }
+
+    stats.chi_square_p = pairs_of_values_p(total.histogram);
+    stats.lsb_ones_ratio = (double)total.ones / stats.channels;
+    if (total.diff_count) {
+        stats.texture_mean = (double)total.diff_sum / total.diff_count;
+        stats.textured_fraction = (double)total.textured / total.diff_count;
+    }
+    stats.detectability = 1.0 - stats.textured_fraction;
+    return stats;
+}
+
+std::array<ChannelStats, 3> analyze_channels(const ImageView& img, unsigned threads) {
+    std::array<ChannelStats, 3> stats;
+    if (!img.width || !img.height) return stats;
+    if (threads == 0) threads = default_thread_count();
+    std::vector<std::array<ChannelPartial, 3>> partials(threads);
+    size_t step = (img.height + threads - 1) / threads;
+    parallel_for(threads, threads, [&](size_t begin, size_t end) {
+        for (size_t t = begin; t < end; ++t) {
+            size_t y_end = std::min<size_t>(img.height, (t + 1) * step);
+            for (size_t y = t * step; y < y_end; ++y) {
+                for (int c = 0; c < 3; ++c) {
+                    const uint8_t* row = img.channel[c].row((int)y);
+                    if (img.planar()) accumulate_channel<1>(row, img.width, partials[t][c]);
+                    else accumulate_channel<3>(row, img.width, partials[t][c]);
+                }
+            }
+        }
+    });
+
+    const double n = (double)img.width * img.height;
+    for (int c = 0; c < 3; ++c) {
+        ChannelPartial total;
+        for (const auto& p : partials) {
+            for (const auto& h : p[c].histograms)
+                for (int v = 0; v < 256; ++v) total.histograms[0][v] += h[v];
+            total.sum += p[c].sum;
+            total.sum_sq += p[c].sum_sq;
+            total.ones += p[c].ones;
+            total.diff_sum += p[c].diff_sum;
+            total.diff_count += p[c].diff_count;
+        }
+        ChannelStats& s = stats[c];
+        s.mean = total.sum / n;
+        s.variance = total.sum_sq / n - s.mean * s.mean;
+        s.lsb_ones_ratio = total.ones / n;
+        s.chi_square_p = pairs_of_values_p(total.histograms[0]);
+        s.texture_mean = total.diff_count ? (double)total.diff_sum / total.diff_count : 0;
+    }
+    return stats;
+}
@@ -0,0 +1,38 @@
+// analysis.h
+// Cover statistics used for capacity planning and detectability estimates
+#pragma once
+#include "bmp.h"
+#include "planar.h"
+#include <array>
+#include <cstdint>
+
+struct CoverStats {
+    int width = 0;
+    int height = 0;
+    uint64_t channels = 0;         // width * height * 3
+    uint64_t lsb_capacity = 0;     // bytes, as reported by lsb_capacity()
+    double lsb_ones_ratio = 0;     // fraction of channels whose LSB is set
+    double chi_square_p = 0;       // pairs-of-values test; near 1 looks LSB-embedded
+    double texture_mean = 0;       // mean |horizontal neighbour difference| per channel
+    double textured_fraction = 0;  // channels with neighbour difference >= 2 (cheap to modify)
+    double detectability = 0;      // 0..1 baseline risk: share of flat, costly channels
+};
+
+// Per-channel figures. Embedding limited to some channels (a container
+// channel mask) only moves the numbers of those channels.
+struct ChannelStats {
+    double mean = 0;
+    double variance = 0;
+    double lsb_ones_ratio = 0;
+    double chi_square_p = 0;
+    double texture_mean = 0;  // mean |horizontal neighbour difference|
+};
+
+// Computes statistics over the whole cover, parallel across row bands.
+// The same figures come out of either layout.
+CoverStats analyze_cover(const ImageView& img, unsigned threads = 0);
+inline CoverStats analyze_cover(const BMPImage& img, unsigned threads = 0) { return analyze_cover(ImageView(img), threads); }
+
+// B, G and R statistics. Each channel is a contiguous run in a planar view
+// and a stride-3 gather in an interleaved one.
+std::array<ChannelStats, 3> analyze_channels(const ImageView& img, unsigned threads = 0);
@@ -0,0 +1,284 @@
+// async.cpp
+// Asynchronous encode/decode jobs: shared executor, cancellation, progress and backpressure
+#include "async.h"
+#include "bmp.h"
+#include "hamming.h"
+#include "lsb.h"
+#include "parallel.h"
+#include "png.h"
+
+namespace {
+
+struct Stage {
+    const char* name;
+    std::function<void()> run;
+};
+
+// A job in flight: its stages run one executor task at a time, and the
+// shared state they work on is captured by the stage functions.
+struct StagedJob {
+    JobExecutor* executor;
+    JobOptions options;
+    std::vector<Stage> stages;
+    std::function<void(std::exception_ptr)> finish;
+};
+
+void complete(const std::shared_ptr<StagedJob>& job, std::exception_ptr error) {
+    job->executor->finish_job();
+    auto finish = [job, error] { job->finish(error); };
+    if (job->options.resume_on) job->options.resume_on(finish);
+    else finish();
+}
+
+void run_stage(std::shared_ptr<StagedJob> job, size_t index) {
+    try {
+        if (job->options.cancel.cancelled()) throw JobCancelled();
+        job->stages[index].run();
+        if (job->options.progress)
+            job->options.progress({job->stages[index].name, (int)index + 1, (int)job->stages.size()});
+    } catch (...) {
+        complete(job, std::current_exception());
+        return;
+    }
+    if (index + 1 == job->stages.size()) {
+        complete(job, nullptr);
+        return;
+    }
+    // Back of the queue, so other jobs' stages get a turn in between
+    job->executor->post([job, index] { run_stage(job, index + 1); });
+}
+
+bool start(std::shared_ptr<StagedJob> job) {
+    if (!job->executor) job->executor = &default_executor();
+    job->options.executor = job->executor;
+    return job->executor->submit([job] { run_stage(job, 0); }, job->options.admission);
+}
+
+BMPImage decode_cover(const std::vector<uint8_t>& file) {
+    return is_png(file.data(), file.size()) ? decode_png(file.data(), file.size())
+                                            : decode_bmp(file.data(), file.size());
+}
+
+} // namespace
+
+JobExecutor::JobExecutor(unsigned threads, size_t max_in_flight, size_t max_queued) {
+    if (threads == 0) threads = default_thread_count();
+    max_in_flight_ = max_in_flight ? max_in_flight : size_t(4) * threads;
+    max_queued_ = max_queued ? max_queued : size_t(64) * threads;
+    for (unsigned i = 0; i < threads; ++i) workers_.emplace_back([this] { worker(); });
+}
+
+JobExecutor::~JobExecutor() {
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        idle_.wait(lock, [this] { return in_flight_ == 0 && admission_.empty() && waiters_.empty() && reserved_ == 0; });
+        stopping_ = true;
+    }
+    work_ready_.notify_all();
+    for (auto& t : workers_) t.join();
+}
+
+bool JobExecutor::submit(std::function<void()> job, Admission admission) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    // A Park submit without a reserve() first has no room of its own
+    if (admission == Admission::Park && reserved_ == 0) admission = Admission::Block;
+    bool parked = admission == Admission::Park;
+    if (parked) --reserved_;
+    if (admission == Admission::Block)
+        queue_space_.wait(lock, [this] { return in_flight_ < max_in_flight_ || has_room(); });
+    if (in_flight_ < max_in_flight_) {
+        ++in_flight_;
+        tasks_.push_back(std::move(job));
+        // Room reserved but not used goes to the next waiter
+        std::function<void()> wake = parked ? take_waiter() : nullptr;
+        lock.unlock();
+        work_ready_.notify_one();
+        if (wake) wake();
+        else if (parked) queue_space_.notify_one();
+        return true;
+    }
+    if (admission == Admission::Try && !has_room()) return false;
+    admission_.push_back(std::move(job));
+    return true;
+}
+
+bool JobExecutor::reserve(std::function<void()> wake) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (!has_room() && waiters_.size() < max_queued_) {
+        waiters_.push_back(std::move(wake));
+        return false;
+    }
+    queue_space_.wait(lock, [this] { return has_room(); });
+    ++reserved_;
+    return true;
+}
+
+std::function<void()> JobExecutor::take_waiter() {
+    if (waiters_.empty() || !has_room()) return nullptr;
+    std::function<void()> wake = std::move(waiters_.front());
+    waiters_.pop_front();
+    ++reserved_;
+    return wake;
+}
+
+void JobExecutor::finish_job() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (!admission_.empty()) {
+        // Hand the slot straight to the oldest waiting job; its queue entry
+        // goes to the oldest parked caller, if any
+        tasks_.push_back(std::move(admission_.front()));
+        admission_.pop_front();
+        std::function<void()> wake = take_waiter();
+        lock.unlock();
+        work_ready_.notify_one();
+        if (wake) wake();
+        else queue_space_.notify_one();
+        return;
+    }
+    if (--in_flight_ == 0) idle_.notify_all();
+    lock.unlock();
+    queue_space_.notify_one();
+}
+
+void JobExecutor::post(std::function<void()> task) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        tasks_.push_back(std::move(task));
+    }
+    work_ready_.notify_one();
+}
+
+size_t JobExecutor::in_flight() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return in_flight_;
+}
+
+size_t JobExecutor::queued() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return admission_.size();
+}
+
+void JobExecutor::worker() {
+    for (;;) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            work_ready_.wait(lock, [this] { return stopping_ || !tasks_.empty(); });
+            if (tasks_.empty()) return;
+            task = std::move(tasks_.front());
+            tasks_.pop_front();
+        }
+        task();
+    }
+}
+
+JobExecutor& default_executor() {
+    static JobExecutor executor;
+    return executor;
+}
+
+bool encode_job(EncodeJob job, JobOptions options, std::function<void(std::exception_ptr, EncodeJobResult)> done) {
+    struct State {
+        EncodeJob job;
+        BMPImage img;
+        EncodeJobResult result;
+    };
+    auto state = std::make_shared<State>();
+    state->job = std::move(job);
+    // Jobs already run side by side, so each PNG is compressed on its worker
+    PngOptions png;
+    png.threads = 1;
+
+    auto staged = std::make_shared<StagedJob>();
+    staged->executor = options.executor;
+    staged->options = std::move(options);
+    staged->stages = {
+        {"load",
+         [state] {
+             EncodeJob& job = state->job;
+             if (job.input_bytes.empty()) {
+                 state->img = load_cover(job.input);
+             } else {
+                 state->img = decode_cover(job.input_bytes);
+                 std::vector<uint8_t>().swap(job.input_bytes);
+             }
+         }},
+        {"embed",
+         [state] {
+             EncodeJob& job = state->job;
+             if (job.container) {
+                 container_encode(state->img, job.message, job.options);
+                 int unit_bits = job.options.params.ecc == EccType::Hamming74 ? 14 : 8;
+                 state->result.stored_bytes = (job.message.size() * unit_bits + 7) / 8;
+                 state->result.capacity = container_capacity(state->img, job.options.params) * unit_bits / 8;
+             } else {
+                 auto encoded = hamming74_encode(job.message);
+                 embed_legacy(state->img, encoded, job.options.passphrase, job.options.mode);
+                 state->result.stored_bytes = encoded.size();
+                 state->result.capacity = lsb_capacity(state->img);
+             }
+         }},
+        {"write",
+         [state, png] {
+             EncodeJob& job = state->job;
+             if (job.output.empty())
+                 state->result.file = job.png_output ? encode_png(state->img, png) : encode_bmp(state->img);
+             else
+                 write_cover(job.output, state->img, png);
+             state->img = BMPImage();
+         }},
+    };
+    staged->finish = [state, done = std::move(done)](std::exception_ptr error) {
+        done(error, error ? EncodeJobResult() : std::move(state->result));
+    };
+    return start(std::move(staged));
+}
+
+bool decode_job(DecodeJob job, JobOptions options, std::function<void(std::exception_ptr, DecodedMessage)> done) {
+    struct State {
+        DecodeJob job;
+        DecodedMessage result;
+    };
+    auto state = std::make_shared<State>();
+    state->job = std::move(job);
+
+    auto staged = std::make_shared<StagedJob>();
+    staged->executor = options.executor;
+    staged->options = std::move(options);
+    staged->stages = {
+        {"decode",
+         [state] {
+             DecodeJob& job = state->job;
+             state->result = job.input_bytes.empty()
+                                 ? decode_message_file(job.input, job.passphrase)
+                                 : decode_message_bytes(job.input_bytes.data(), job.input_bytes.size(),
+                                                        job.passphrase);
+         }},
+    };
+    staged->finish = [state, done = std::move(done)](std::exception_ptr error) {
+        done(error, error ? DecodedMessage() : std::move(state->result));
+    };
+    return start(std::move(staged));
+}
+
+std::future<EncodeJobResult> encode_future(EncodeJob job, JobOptions options) {
+    auto promise = std::make_shared<std::promise<EncodeJobResult>>();
+    auto future = promise->get_future();
+    options.admission = JobExecutor::Admission::Block;
+    encode_job(std::move(job), std::move(options), [promise](std::exception_ptr error, EncodeJobResult result) {
+        if (error) promise->set_exception(error);
+        else promise->set_value(std::move(result));
+    });
+    return future;
+}
+
+std::future<DecodedMessage> decode_future(DecodeJob job, JobOptions options) {
+    auto promise = std::make_shared<std::promise<DecodedMessage>>();
+    auto future = promise->get_future();
+    options.admission = JobExecutor::Admission::Block;
+    decode_job(std::move(job), std::move(options), [promise](std::exception_ptr error, DecodedMessage result) {
+        if (error) promise->set_exception(error);
+        else promise->set_value(std::move(result));
+    });
+    return future;
+}
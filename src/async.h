@@ -0,0 +1,215 @@
+// async.h
+// Asynchronous encode/decode jobs: shared executor, cancellation, progress and backpressure
+#pragma once
+#include "container.h"
+#include "stego.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+#include <coroutine>
+#define TF_HAS_COROUTINES 1
+#endif
+
+// Fixed pool running jobs as chains of short stage tasks (load, embed,
+// write), so thousands of jobs share a handful of threads and no job holds a
+// worker between its stages. At most `max_in_flight` jobs are started at
+// once; the rest wait in an admission queue of `max_queued` entries.
+// Suspended callers that find the queue full wait in a list of at most
+// `max_queued` wake-ups instead, without handing over their job.
+class JobExecutor {
+public:
+    enum class Admission {
+        Block,  // wait for room in the admission queue
+        Try,    // refuse when the admission queue is full
+        Park,   // use the room taken by reserve(); for suspended callers
+    };
+
+    // 0 picks default_thread_count() workers, 4 jobs in flight per worker and
+    // 64 queued per worker.
+    explicit JobExecutor(unsigned threads = 0, size_t max_in_flight = 0, size_t max_queued = 0);
+    ~JobExecutor();  // runs admitted and queued jobs to completion, then joins
+    JobExecutor(const JobExecutor&) = delete;
+    JobExecutor& operator=(const JobExecutor&) = delete;
+
+    // Starts `job` on a worker once a slot is free; the job calls
+    // finish_job() when its last stage is done. Returns false only for Try.
+    bool submit(std::function<void()> job, Admission admission);
+    void finish_job();
+
+    // Takes room in the admission queue for one Park submit and returns true.
+    // When the queue is full, keeps `wake` in the waiter list and returns
+    // false instead; `wake` runs, with the room taken, once a queued job is
+    // admitted. With the waiter list full too the caller blocks as for Block.
+    bool reserve(std::function<void()> wake);
+
+    // Queues a task for the workers, bypassing admission. Tasks must not throw.
+    void post(std::function<void()> task);
+
+    unsigned threads() const { return (unsigned)workers_.size(); }
+    size_t in_flight() const;
+    size_t queued() const;  // jobs waiting for admission, for load shedding
+
+private:
+    void worker();
+    bool has_room() const { return admission_.size() + reserved_ < max_queued_; }
+    std::function<void()> take_waiter();
+
+    std::vector<std::thread> workers_;
+    mutable std::mutex mutex_;
+    std::condition_variable work_ready_, queue_space_, idle_;
+    std::deque<std::function<void()>> tasks_;
+    std::deque<std::function<void()>> admission_;
+    std::deque<std::function<void()>> waiters_;  // Park callers waiting for room
+    size_t max_in_flight_ = 0, max_queued_ = 0;
+    size_t in_flight_ = 0;
+    size_t reserved_ = 0;  // room promised to Park submits not yet made
+    bool stopping_ = false;
+};
+
+// Process-wide executor for jobs that name none.
+JobExecutor& default_executor();
+
+class JobCancelled : public std::runtime_error {
+public:
+    JobCancelled() : std::runtime_error("Job cancelled") {}
+};
+
+// Cooperative cancellation: jobs check the token before each stage and fail
+// with JobCancelled once it is set. A default token is never cancelled.
+class CancellationToken {
+public:
+    CancellationToken() = default;
+    bool cancelled() const { return flag_ && flag_->load(std::memory_order_relaxed); }
+
+private:
+    friend class CancellationSource;
+    explicit CancellationToken(std::shared_ptr<std::atomic<bool>> flag) : flag_(std::move(flag)) {}
+    std::shared_ptr<std::atomic<bool>> flag_;
+};
+
+class CancellationSource {
+public:
+    CancellationSource() : flag_(std::make_shared<std::atomic<bool>>(false)) {}
+    CancellationToken token() const { return CancellationToken(flag_); }
+    void cancel() { flag_->store(true, std::memory_order_relaxed); }
+
+private:
+    std::shared_ptr<std::atomic<bool>> flag_;
+};
+
+struct JobProgress {
+    const char* stage;  // "load", "embed", "write" or "decode"
+    int done;           // stages finished, this one included
+    int total;
+};
+
+struct JobOptions {
+    JobExecutor* executor = nullptr;  // nullptr = default_executor()
+    JobExecutor::Admission admission = JobExecutor::Admission::Block;
+    CancellationToken cancel;
+    // Called on a worker after each stage.
+    std::function<void(const JobProgress&)> progress;
+    // Runs the completion, e.g. by posting it to the caller's event loop. By
+    // default the completion runs on the worker that finished the job.
+    std::function<void(std::function<void()>)> resume_on;
+};
+
+struct EncodeJob {
+    std::string input;                 // BMP or PNG cover, used when input_bytes is empty
+    std::vector<uint8_t> input_bytes;  // BMP or PNG file already in memory
+    std::string output;                // ".png" writes PNG, otherwise BMP; empty returns the file
+    bool png_output = false;           // format of a returned file
+    std::vector<uint8_t> message;
+    ContainerOptions options;
+    bool container = true;             // false = legacy layout (Hamming + lsb_encode)
+};
+
+struct EncodeJobResult {
+    std::vector<uint8_t> file;  // the encoded image when EncodeJob::output is empty
+    uint64_t stored_bytes = 0;  // bytes embedded, after ECC
+    uint64_t capacity = 0;      // in the same units as stored_bytes
+};
+
+struct DecodeJob {
+    std::string input;                 // BMP, PNG or JPEG, used when input_bytes is empty
+    std::vector<uint8_t> input_bytes;  // BMP or PNG file already in memory
+    std::string passphrase;
+};
+
+// Callback form the others build on. `done` gets the error (JobCancelled or
+// the codec's std::runtime_error) or the result, and must not throw. Returns
+// false, without calling `done`, when Try admission finds the queue full.
+bool encode_job(EncodeJob job, JobOptions options, std::function<void(std::exception_ptr, EncodeJobResult)> done);
+bool decode_job(DecodeJob job, JobOptions options, std::function<void(std::exception_ptr, DecodedMessage)> done);
+
+// Future form for thread-based callers. Submission blocks while the
+// admission queue is full, which throttles producers.
+std::future<EncodeJobResult> encode_future(EncodeJob job, JobOptions options = JobOptions());
+std::future<DecodedMessage> decode_future(DecodeJob job, JobOptions options = JobOptions());
+
+#ifdef TF_HAS_COROUTINES
+// Awaitable job for C++20 callers. The job starts when awaited and the
+// coroutine stays suspended while it waits for room in the admission queue
+// (as a waiter, so no thread blocks and the queue stays bounded) and while
+// the job runs; it resumes wherever options.resume_on says.
+template <typename Job, typename T>
+class JobAwaitable {
+public:
+    using Run = bool (*)(Job, JobOptions, std::function<void(std::exception_ptr, T)>);
+
+    JobAwaitable(Run run, Job job, JobOptions options)
+        : run_(run), job_(std::move(job)), options_(std::move(options)) {}
+
+    bool await_ready() const noexcept { return false; }
+
+    void await_suspend(std::coroutine_handle<> handle) {
+        handle_ = handle;
+        if (!options_.executor) options_.executor = &default_executor();
+        options_.admission = JobExecutor::Admission::Park;
+        // With the queue full the job stays in this awaiter until a wake-up
+        if (options_.executor->reserve([this] { start(); })) start();
+    }
+
+    T await_resume() {
+        if (error_) std::rethrow_exception(error_);
+        return std::move(value_);
+    }
+
+private:
+    void start() {
+        // The awaiter may be gone as soon as the coroutine resumes, so
+        // nothing here touches it after the job is handed over
+        run_(std::move(job_), std::move(options_), [this](std::exception_ptr error, T value) {
+            error_ = error;
+            value_ = std::move(value);
+            handle_.resume();
+        });
+    }
+
+    Run run_;
+    Job job_;
+    JobOptions options_;
+    std::coroutine_handle<> handle_;
+    std::exception_ptr error_;
+    T value_;
+};
+
+inline JobAwaitable<EncodeJob, EncodeJobResult> encode_async(EncodeJob job, JobOptions options = JobOptions()) {
+    return {encode_job, std::move(job), std::move(options)};
+}
+
+inline JobAwaitable<DecodeJob, DecodedMessage> decode_async(DecodeJob job, JobOptions options = JobOptions()) {
+    return {decode_job, std::move(job), std::move(options)};
+}
+#endif
@@ -1,9 +1,14 @@
 // bmp.cpp
 // Simple 24-bit uncompressed BMP loader/writer
 #include "bmp.h"
+#include "buffers.h"
+#include "stream_io.h"
 #include <fstream>
 #include <stdexcept>
 #include <cstring>
+#include <cstdlib>
+#include <cstdint>
+#include <unistd.h>
 
 #pragma pack(push, 1)
 struct BMPFileHeader {
@@ -29,51 +34,149 @@ struct BMPInfoHeader {
 };
 #pragma pack(pop)
 
-BMPImage load_bmp(const std::string& filename) {
-    std::ifstream file(filename, std::ios::binary);
-    if (!file) throw std::runtime_error("Cannot open BMP file: " + filename);
-
+BMPInfo parse_bmp_headers(const uint8_t* bytes, size_t size) {
     BMPFileHeader fileHeader;
     BMPInfoHeader infoHeader;
-    file.read(reinterpret_cast<char*>(&fileHeader), sizeof(fileHeader));
-    file.read(reinterpret_cast<char*>(&infoHeader), sizeof(infoHeader));
+    if (size < sizeof(fileHeader) + sizeof(infoHeader)) throw std::runtime_error("Truncated BMP header");
+    std::memcpy(&fileHeader, bytes, sizeof(fileHeader));
+    std::memcpy(&infoHeader, bytes + sizeof(fileHeader), sizeof(infoHeader));
 
     if (fileHeader.bfType != 0x4D42) throw std::runtime_error("Not a BMP file");
     if (infoHeader.biBitCount != 24 || infoHeader.biCompression != 0)
         throw std::runtime_error("Only 24-bit uncompressed BMP supported");
+    if (infoHeader.biWidth <= 0 || infoHeader.biHeight == 0 || infoHeader.biHeight == INT32_MIN)
+        throw std::runtime_error("Invalid BMP dimensions");
+    if (fileHeader.bfOffBits < sizeof(fileHeader) + sizeof(infoHeader))
+        throw std::runtime_error("Invalid BMP pixel offset");
 
-    int width = infoHeader.biWidth;
-    int height = std::abs(infoHeader.biHeight);
-    int row_padded = (width * 3 + 3) & (~3);
-    std::vector<uint8_t> data(width * height * 3);
+    BMPInfo info;
+    info.width = infoHeader.biWidth;
+    info.height = std::abs(infoHeader.biHeight);
+    info.top_down = infoHeader.biHeight < 0;
+    info.data_offset = fileHeader.bfOffBits;
+    info.row_stride = ((uint64_t)info.width * 3 + 3) & ~(uint64_t)3;
+    info.file_size = info.data_offset + info.row_stride * info.height;
+    return info;
+}
 
-    file.seekg(fileHeader.bfOffBits, std::ios::beg);
-    for (int y = 0; y < height; ++y) {
-        int row = infoHeader.biHeight > 0 ? height - 1 - y : y;
-        file.read(reinterpret_cast<char*>(&data[row * width * 3]), width * 3);
-        file.ignore(row_padded - width * 3);
+static BMPInfo read_bmp_headers(std::istream& file) {
+    uint8_t bytes[sizeof(BMPFileHeader) + sizeof(BMPInfoHeader)];
+    file.read(reinterpret_cast<char*>(bytes), sizeof(bytes));
+    if (!file) throw std::runtime_error("Truncated BMP header");
+    return parse_bmp_headers(bytes, sizeof(bytes));
+}
+
+// Converts stored rows (padded, bottom-up unless top_down) to BMPImage order.
+static BMPImage unpack_rows(const BMPInfo& info, const uint8_t* pixels) {
+    size_t row_bytes = (size_t)info.width * 3;
+    size_t height = (size_t)info.height;
+    std::vector<uint8_t> data;
+    resize_large(data, row_bytes * height);
+    for (size_t y = 0; y < height; ++y) {
+        size_t row = info.top_down ? y : height - 1 - y;
+        std::memcpy(&data[row * row_bytes], pixels + y * info.row_stride, row_bytes);
     }
-    return BMPImage{width, height, std::move(data)};
+    return BMPImage{info.width, info.height, std::move(data)};
 }
 
-void write_bmp(const std::string& filename, const BMPImage& image) {
-    int width = image.width;
-    int height = image.height;
-    int row_padded = (width * 3 + 3) & (~3);
-    int filesize = 54 + row_padded * height;
+// Reads exactly one BMP from stdin, leaving any following bytes unread.
+static BMPImage load_bmp_stdin() {
+    std::vector<uint8_t> header(sizeof(BMPFileHeader) + sizeof(BMPInfoHeader));
+    read_exact(STDIN_FILENO, header.data(), header.size());
+    BMPInfo info = parse_bmp_headers(header.data(), header.size());
+    std::vector<uint8_t> skip(info.data_offset - header.size());
+    read_exact(STDIN_FILENO, skip.data(), skip.size());
+    std::vector<uint8_t> pixels(info.row_stride * info.height);
+    read_exact(STDIN_FILENO, pixels.data(), pixels.size());
+    return unpack_rows(info, pixels.data());
+}
 
-    BMPFileHeader fileHeader = {0x4D42, (uint32_t)filesize, 0, 0, 54};
+BMPImage load_bmp(const std::string& filename) {
+    if (is_std_stream(filename)) return load_bmp_stdin();
+    std::ifstream file(filename, std::ios::binary);
+    if (!file) throw std::runtime_error("Cannot open BMP file: " + filename);
+
+    BMPInfo info = read_bmp_headers(file);
+    size_t row_bytes = (size_t)info.width * 3;
+    size_t height = (size_t)info.height;
+    std::vector<uint8_t> data;
+    resize_large(data, row_bytes * height);
+
+    file.seekg((std::streamoff)info.data_offset, std::ios::beg);
+    for (size_t y = 0; y < height; ++y) {
+        size_t row = info.top_down ? y : height - 1 - y;
+        file.read(reinterpret_cast<char*>(&data[row * row_bytes]), (std::streamsize)row_bytes);
+        file.ignore((std::streamsize)(info.row_stride - row_bytes));
+    }
+    return BMPImage{info.width, info.height, std::move(data)};
+}
+
+BMPImage decode_bmp(const uint8_t* bytes, size_t size) {
+    BMPInfo info = parse_bmp_headers(bytes, size);
+    if (size < info.file_size) throw std::runtime_error("Truncated BMP pixel data");
+    return unpack_rows(info, bytes + info.data_offset);
+}
+
+std::vector<uint8_t> bmp_headers(int width, int height) {
+    uint64_t row_padded = ((uint64_t)width * 3 + 3) & ~(uint64_t)3;
+    uint64_t image_size = row_padded * (uint64_t)height;
+    uint64_t filesize = kBmpHeaderBytes + image_size;
+    // Readers recompute both sizes from the dimensions, so 0 is the usual
+    // placeholder when they do not fit the 32-bit fields
+    uint32_t file_field = filesize <= UINT32_MAX ? (uint32_t)filesize : 0;
+
+    BMPFileHeader fileHeader = {0x4D42, file_field, 0, 0, (uint32_t)kBmpHeaderBytes};
     BMPInfoHeader infoHeader = {40, width, height, 1, 24, 0, 0, 0, 0, 0, 0};
+    std::vector<uint8_t> out(kBmpHeaderBytes);
+    std::memcpy(out.data(), &fileHeader, sizeof(fileHeader));
+    std::memcpy(out.data() + sizeof(fileHeader), &infoHeader, sizeof(infoHeader));
+    return out;
+}
+
+std::vector<uint8_t> encode_bmp(const BMPImage& image) {
+    size_t row_bytes = (size_t)image.width * 3;
+    size_t height = (size_t)image.height;
+    size_t row_padded = (row_bytes + 3) & ~(size_t)3;
+
+    std::vector<uint8_t> out = bmp_headers(image.width, image.height);
+    out.resize(kBmpHeaderBytes + row_padded * height, 0);
+    for (size_t y = 0; y < height; ++y) {
+        std::memcpy(&out[kBmpHeaderBytes + y * row_padded], &image.data[(height - 1 - y) * row_bytes], row_bytes);
+    }
+    return out;
+}
+
+void write_bmp(const std::string& filename, const BMPImage& image) {
+    if (is_std_stream(filename)) {
+        write_all(filename, encode_bmp(image));
+        return;
+    }
+    size_t row_bytes = (size_t)image.width * 3;
+    size_t height = (size_t)image.height;
+    size_t row_padded = (row_bytes + 3) & ~(size_t)3;
 
     std::ofstream file(filename, std::ios::binary);
     if (!file) throw std::runtime_error("Cannot write BMP file: " + filename);
-    file.write(reinterpret_cast<const char*>(&fileHeader), sizeof(fileHeader));
-    file.write(reinterpret_cast<const char*>(&infoHeader), sizeof(infoHeader));
-
-    std::vector<uint8_t> row(row_padded);
-    for (int y = 0; y < height; ++y) {
-        std::memcpy(row.data(), &image.data[(height - 1 - y) * width * 3], width * 3);
-        std::memset(row.data() + width * 3, 0, row_padded - width * 3);
-        file.write(reinterpret_cast<const char*>(row.data()), row_padded);
+    std::vector<uint8_t> headers = bmp_headers(image.width, image.height);
+    file.write(reinterpret_cast<const char*>(headers.data()), (std::streamsize)headers.size());
+
+    std::vector<uint8_t> row(row_padded, 0);
+    for (size_t y = 0; y < height; ++y) {
+        std::memcpy(row.data(), &image.data[(height - 1 - y) * row_bytes], row_bytes);
+        file.write(reinterpret_cast<const char*>(row.data()), (std::streamsize)row_padded);
     }
 }
+
+BMPInfo probe_bmp(const std::string& filename) {
+    std::ifstream file(filename, std::ios::binary);
+    if (!file) throw std::runtime_error("Cannot open BMP file: " + filename);
+    return read_bmp_headers(file);
+}
+
+uint64_t bmp_channel_offset(const BMPInfo& info, uint64_t index) {
+    uint64_t row_bytes = (uint64_t)info.width * 3;
+    uint64_t row = index / row_bytes;
+    uint64_t col = index % row_bytes;
+    uint64_t stored_row = info.top_down ? row : info.height - 1 - row;
+    return info.data_offset + stored_row * info.row_stride + col;
+}
@@ -3,6 +3,7 @@
 #pragma once
 #include <string>
 #include <vector>
+#include <cstddef>
 #include <cstdint>
 
 struct BMPImage {
@@ -11,8 +12,43 @@ struct BMPImage {
     std::vector<uint8_t> data; // BGRBGR...
 };
 
+// Header fields needed to address pixel bytes directly in a BMP file.
+struct BMPInfo {
+    int width = 0;
+    int height = 0;
+    bool top_down = false;     // true when biHeight < 0
+    uint64_t data_offset = 0;  // bfOffBits
+    uint64_t row_stride = 0;   // padded bytes per stored row
+    uint64_t file_size = 0;    // data_offset + row_stride * height
+};
+
 // Loads a 24-bit uncompressed BMP file. Throws std::runtime_error on error.
+// "-" reads exactly one BMP from stdin, leaving any following bytes unread.
 BMPImage load_bmp(const std::string& filename);
 
 // Writes a 24-bit uncompressed BMP file. Throws std::runtime_error on error.
+// "-" writes to stdout.
 void write_bmp(const std::string& filename, const BMPImage& image);
+
+// Parses a complete BMP file held in memory. Throws std::runtime_error on error.
+BMPImage decode_bmp(const uint8_t* bytes, size_t size);
+
+// Serializes an image to a complete bottom-up BMP file in memory.
+std::vector<uint8_t> encode_bmp(const BMPImage& image);
+
+// Size of the BITMAPFILEHEADER + BITMAPINFOHEADER prefix every BMP starts with.
+constexpr size_t kBmpHeaderBytes = 54;
+
+// Parses and validates the file/info headers from the first kBmpHeaderBytes
+// bytes. Throws std::runtime_error on error.
+BMPInfo parse_bmp_headers(const uint8_t* bytes, size_t size);
+
+// Serializes the kBmpHeaderBytes prefix of a bottom-up 24-bit BMP with pixel
+// data right after it. bfSize is written as 0 when the file exceeds 4 GiB.
+std::vector<uint8_t> bmp_headers(int width, int height);
+
+// Reads and validates only the BMP headers. Throws std::runtime_error on error.
+BMPInfo probe_bmp(const std::string& filename);
+
+// Returns the file offset of channel `index` in BMPImage::data order (top-down BGR).
+uint64_t bmp_channel_offset(const BMPInfo& info, uint64_t index);
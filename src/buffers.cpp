@@ -0,0 +1,167 @@
+// buffers.cpp
+// Placement of large buffers: huge pages and NUMA-local memory for pixel and permutation arrays
+#include "buffers.h"
+#include <cstdio>
+#include <fstream>
+#include <string>
+#ifdef __linux__
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+constexpr size_t kHugePageBytes = size_t(2) << 20;
+constexpr size_t kPageBytes = 4096;
+constexpr int kMpolPreferred = 1;  // from <linux/mempolicy.h>; no libnuma needed
+
+BufferPolicy g_policy;
+
+uintptr_t round_up(uintptr_t n, uintptr_t to) { return (n + to - 1) / to * to; }
+
+// Parses sysfs lists such as "0-3,8,10-11".
+std::vector<int> read_list(const std::string& path) {
+    std::vector<int> items;
+    std::ifstream file(path);
+    std::string text;
+    if (!std::getline(file, text)) return items;
+    size_t pos = 0;
+    while (pos < text.size()) {
+        size_t comma = text.find(',', pos);
+        if (comma == std::string::npos) comma = text.size();
+        std::string item = text.substr(pos, comma - pos);
+        int first = 0, last = 0;
+        if (std::sscanf(item.c_str(), "%d-%d", &first, &last) == 2) {
+            for (int i = first; i <= last; ++i) items.push_back(i);
+        } else if (std::sscanf(item.c_str(), "%d", &first) == 1) {
+            items.push_back(first);
+        }
+        pos = comma + 1;
+    }
+    return items;
+}
+
+#ifdef __linux__
+void advise_pages(void* p, size_t bytes) {
+    madvise(p, bytes, g_policy.huge_pages == HugePages::Off ? MADV_NOHUGEPAGE : MADV_HUGEPAGE);
+}
+#endif
+
+} // namespace
+
+const BufferPolicy& buffer_policy() { return g_policy; }
+
+void set_buffer_policy(const BufferPolicy& policy) { g_policy = policy; }
+
+void* large_allocate(size_t bytes) {
+#ifdef __linux__
+    if (bytes >= kLargeBufferBytes) {
+        size_t length = round_up(bytes, kHugePageBytes);
+        void* p = MAP_FAILED;
+        if (g_policy.huge_pages == HugePages::Explicit)
+            p = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (p == MAP_FAILED) {
+            // Over-map by one huge page and trim, so the range starts on a
+            // 2 MB boundary and every 2 MB of it can be a huge page
+            void* raw = mmap(nullptr, length + kHugePageBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS,
+                             -1, 0);
+            if (raw == MAP_FAILED) throw std::bad_alloc();
+            uintptr_t start = round_up((uintptr_t)raw, kHugePageBytes);
+            size_t head = start - (uintptr_t)raw;
+            if (head) munmap(raw, head);
+            munmap((void*)(start + length), kHugePageBytes - head);
+            p = (void*)start;
+            advise_pages(p, length);
+        }
+        if (g_policy.numa) bind_to_node(p, length, current_numa_node());
+        return p;
+    }
+#endif
+    return ::operator new(bytes);
+}
+
+void large_free(void* p, size_t bytes) {
+    if (!p) return;
+#ifdef __linux__
+    if (bytes >= kLargeBufferBytes) {
+        munmap(p, round_up(bytes, kHugePageBytes));
+        return;
+    }
+#endif
+    ::operator delete(p);
+}
+
+void advise_large(void* p, size_t bytes) {
+#ifdef __linux__
+    if (!p || bytes < kLargeBufferBytes) return;
+    uintptr_t begin = round_up((uintptr_t)p, kPageBytes);
+    uintptr_t end = ((uintptr_t)p + bytes) / kPageBytes * kPageBytes;
+    if (end <= begin) return;
+    advise_pages((void*)begin, end - begin);
+    if (g_policy.numa) bind_to_node((void*)begin, end - begin, current_numa_node());
+#else
+    (void)p;
+    (void)bytes;
+#endif
+}
+
+bool bind_to_node(void* p, size_t bytes, int node) {
+#ifdef __linux__
+    if (node < 0 || numa_node_count() <= 1) return false;
+    unsigned long mask[16] = {};
+    if ((size_t)node >= sizeof(mask) * 8) return false;
+    mask[node / (8 * sizeof(unsigned long))] |= 1ul << (node % (8 * sizeof(unsigned long)));
+    return syscall(SYS_mbind, p, bytes, kMpolPreferred, mask, sizeof(mask) * 8, 0) == 0;
+#else
+    (void)p;
+    (void)bytes;
+    (void)node;
+    return false;
+#endif
+}
+
+unsigned numa_node_count() {
+    static const unsigned count = [] {
+        size_t n = read_list("/sys/devices/system/node/online").size();
+        return n ? (unsigned)n : 1u;
+    }();
+    return count;
+}
+
+int current_numa_node() {
+#ifdef __linux__
+    unsigned cpu = 0, node = 0;
+    if (syscall(SYS_getcpu, &cpu, &node, nullptr) == 0) return (int)node;
+#endif
+    return 0;
+}
+
+NumaWorkerScope::NumaWorkerScope(size_t index, size_t count) {
+#ifdef __linux__
+    unsigned nodes = numa_node_count();
+    if (!g_policy.numa || nodes <= 1 || count == 0) return;
+    int node = (int)(index * nodes / count);
+
+    cpu_set_t saved, pinned;
+    if (sched_getaffinity(0, sizeof(saved), &saved) != 0) return;
+    // Stay inside the CPUs we were given (taskset, cgroups)
+    CPU_ZERO(&pinned);
+    for (int cpu : read_list("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist"))
+        if (cpu < CPU_SETSIZE && CPU_ISSET(cpu, &saved)) CPU_SET(cpu, &pinned);
+    if (CPU_COUNT(&pinned) == 0 || sched_setaffinity(0, sizeof(pinned), &pinned) != 0) return;
+
+    saved_.assign(reinterpret_cast<unsigned char*>(&saved), reinterpret_cast<unsigned char*>(&saved) + sizeof(saved));
+    node_ = node;
+#else
+    (void)index;
+    (void)count;
+#endif
+}
+
+NumaWorkerScope::~NumaWorkerScope() {
+#ifdef __linux__
+    if (saved_.size() == sizeof(cpu_set_t)) sched_setaffinity(0, sizeof(cpu_set_t), reinterpret_cast<cpu_set_t*>(saved_.data()));
+#endif
+}
@@ -0,0 +1,94 @@
+// buffers.h
+// Placement of large buffers: huge pages and NUMA-local memory for pixel and permutation arrays
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <vector>
+
+// Buffers at least this large get their own mapping and placement advice;
+// smaller ones come from the regular heap.
+constexpr size_t kLargeBufferBytes = size_t(2) << 20;
+
+enum class HugePages {
+    Off,          // 4 KB pages, even where THP is enabled system-wide
+    Transparent,  // 2 MB-aligned mappings advised with MADV_HUGEPAGE
+    Explicit,     // MAP_HUGETLB from the reserved pool, Transparent when it is empty
+};
+
+struct BufferPolicy {
+    HugePages huge_pages = HugePages::Transparent;
+    bool numa = true;  // bind large buffers to the allocating thread's node and pin batch workers
+};
+
+// Process-wide policy. Set it once at startup, before any worker starts.
+const BufferPolicy& buffer_policy();
+void set_buffer_policy(const BufferPolicy& policy);
+
+// Raw storage for large buffers, placed per the policy. Linux only; other
+// platforms (and small sizes) use operator new. `bytes` must match on free.
+void* large_allocate(size_t bytes);
+void large_free(void* p, size_t bytes);
+
+// Placement advice for storage allocated elsewhere but not yet touched, such
+// as a std::vector after reserve(): huge pages per the policy and the
+// caller's NUMA node. Only whole pages inside the range are advised.
+void advise_large(void* p, size_t bytes);
+
+// Prefers `node` for the pages of [p, p + bytes) that are not yet touched.
+// Returns false on single-node machines or when the kernel refuses.
+bool bind_to_node(void* p, size_t bytes, int node);
+
+// Allocator for containers that should always live in large-buffer storage.
+template <typename T>
+struct LargeAllocator {
+    using value_type = T;
+
+    LargeAllocator() = default;
+    template <typename U>
+    LargeAllocator(const LargeAllocator<U>&) {}
+
+    T* allocate(size_t n) {
+        if (n > SIZE_MAX / sizeof(T)) throw std::bad_array_new_length();
+        return static_cast<T*>(large_allocate(n * sizeof(T)));
+    }
+    void deallocate(T* p, size_t n) { large_free(p, n * sizeof(T)); }
+
+    template <typename U>
+    bool operator==(const LargeAllocator<U>&) const { return true; }
+    template <typename U>
+    bool operator!=(const LargeAllocator<U>&) const { return false; }
+};
+
+// Replaces `v` with n value-initialized elements whose storage was advised
+// before the initialization first touches it.
+template <typename T>
+void resize_large(std::vector<T>& v, size_t n) {
+    std::vector<T>().swap(v);
+    v.reserve(n);
+    advise_large(v.data(), n * sizeof(T));
+    v.resize(n);
+}
+
+// NUMA topology from sysfs; machines without it report a single node 0.
+unsigned numa_node_count();
+int current_numa_node();
+
+// Pins the calling thread to the CPUs of the node that worker `index` of
+// `count` maps to (contiguous blocks, so neighbouring work shares a node)
+// and restores the previous affinity when it goes out of scope. Buffers the
+// worker allocates afterwards land on that node. Does nothing on a
+// single-node machine or when the policy turns NUMA off.
+class NumaWorkerScope {
+public:
+    NumaWorkerScope(size_t index, size_t count);
+    ~NumaWorkerScope();
+    NumaWorkerScope(const NumaWorkerScope&) = delete;
+    NumaWorkerScope& operator=(const NumaWorkerScope&) = delete;
+
+    int node() const { return node_; }  // -1 when not pinned
+
+private:
+    int node_ = -1;
+    std::vector<unsigned char> saved_;  // previous affinity mask
+};
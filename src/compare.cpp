@@ -0,0 +1,159 @@
+// compare.cpp
+// Image-quality metrics between a cover and its stego output
+#include "compare.h"
+#include "bmp.h"
+#include "mapped_file.h"
+#include "parallel.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+struct Partial {
+    uint64_t sse = 0;
+    uint64_t changed_channels = 0;
+    uint64_t changed_pixels = 0;
+    int max_abs_diff = 0;
+    double ssim_sum = 0;
+    uint64_t ssim_windows = 0;
+};
+
+// Per-window sums for one row of SSIM windows, three channels each.
+struct WindowSums {
+    std::vector<uint64_t> x, y, xx, yy, xy;
+
+    explicit WindowSums(size_t n) : x(n), y(n), xx(n), yy(n), xy(n) {}
+    void clear() {
+        for (auto* v : {&x, &y, &xx, &yy, &xy}) std::fill(v->begin(), v->end(), 0);
+    }
+};
+
+double window_ssim(const WindowSums& s, size_t i, double n) {
+    constexpr double c1 = (0.01 * 255) * (0.01 * 255);
+    constexpr double c2 = (0.03 * 255) * (0.03 * 255);
+    double mx = s.x[i] / n, my = s.y[i] / n;
+    double vx = s.xx[i] / n - mx * mx, vy = s.yy[i] / n - my * my;
+    double cov = s.xy[i] / n - mx * my;
+    return ((2 * mx * my + c1) * (2 * cov + c2)) / ((mx * mx + my * my + c1) * (vx + vy + c2));
+}
+
+} // namespace
+
+CompareStats compare_bmp_files(const std::string& a, const std::string& b, const CompareOptions& options) {
+    auto start = std::chrono::steady_clock::now();
+    BMPInfo ia = probe_bmp(a), ib = probe_bmp(b);
+    if (ia.width != ib.width || ia.height != ib.height)
+        throw std::runtime_error("Images differ in size: " + std::to_string(ia.width) + "x" + std::to_string(ia.height) +
+                                 " vs " + std::to_string(ib.width) + "x" + std::to_string(ib.height));
+    if (options.window < 1 || options.window > 64) throw std::runtime_error("SSIM window must be 1..64 pixels");
+    MappedFile fa(a, MappedFile::Mode::ReadOnly), fb(b, MappedFile::Mode::ReadOnly);
+    if (fa.size() < ia.file_size || fb.size() < ib.file_size) throw std::runtime_error("Truncated BMP pixel data");
+
+    const int width = ia.width, height = ia.height;
+    const size_t row_bytes = (size_t)width * 3;
+    // Shrink the window for tiny images so there is at least one
+    const int win = std::max(1, std::min({options.window, width, height}));
+    const size_t windows_x = (size_t)(width / win), windows_y = (size_t)(height / win);
+    // Bands are whole window rows so no window straddles two threads
+    const int band_rows = win * std::max(1, 64 / win);
+    const size_t bands = ((size_t)height + band_rows - 1) / band_rows;
+
+    BMPImage map;
+    if (!options.change_map.empty()) {
+        map.width = width;
+        map.height = height;
+        map.data.resize(row_bytes * height);
+    }
+
+    Partial total;
+    std::mutex mutex;
+    parallel_for(bands, options.threads, [&](size_t band_begin, size_t band_end) {
+        Partial local;
+        WindowSums sums(windows_x * 3);
+        for (size_t band = band_begin; band < band_end; ++band) {
+            int y_end = std::min<int>(height, (int)(band + 1) * band_rows);
+            for (int y = (int)band * band_rows; y < y_end; ++y) {
+                const uint8_t* pa = fa.data() + bmp_channel_offset(ia, (uint64_t)y * row_bytes);
+                const uint8_t* pb = fb.data() + bmp_channel_offset(ib, (uint64_t)y * row_bytes);
+
+                // Plain contiguous loops so the compiler can vectorize them
+                uint64_t sse = 0;
+                uint32_t changed = 0;
+                int max_diff = 0;
+                for (size_t i = 0; i < row_bytes; ++i) {
+                    int d = (int)pa[i] - (int)pb[i];
+                    int ad = d < 0 ? -d : d;
+                    sse += (uint32_t)(d * d);
+                    changed += ad != 0;
+                    max_diff = ad > max_diff ? ad : max_diff;
+                }
+                local.sse += sse;
+                local.changed_channels += changed;
+                local.max_abs_diff = std::max(local.max_abs_diff, max_diff);
+                if (changed) {
+                    for (size_t i = 0; i < row_bytes; i += 3)
+                        local.changed_pixels += (pa[i] != pb[i]) | (pa[i + 1] != pb[i + 1]) | (pa[i + 2] != pb[i + 2]);
+                }
+                if (!map.data.empty()) {
+                    uint8_t* out = &map.data[(size_t)y * row_bytes];
+                    for (size_t i = 0; i < row_bytes; ++i) out[i] = pa[i] != pb[i] ? 255 : pa[i] >> 2;
+                }
+
+                if ((size_t)y >= windows_y * win) continue;
+                for (size_t wx = 0; wx < windows_x; ++wx) {
+                    const uint8_t* qa = pa + wx * win * 3;
+                    const uint8_t* qb = pb + wx * win * 3;
+                    for (int c = 0; c < 3; ++c) {
+                        uint64_t sx = 0, sy = 0, sxx = 0, syy = 0, sxy = 0;
+                        for (int k = c; k < win * 3; k += 3) {
+                            uint32_t x = qa[k], v = qb[k];
+                            sx += x;
+                            sy += v;
+                            sxx += x * x;
+                            syy += v * v;
+                            sxy += x * v;
+                        }
+                        size_t i = wx * 3 + c;
+                        sums.x[i] += sx;
+                        sums.y[i] += sy;
+                        sums.xx[i] += sxx;
+                        sums.yy[i] += syy;
+                        sums.xy[i] += sxy;
+                    }
+                }
+                if ((y + 1) % win == 0) {
+                    for (size_t i = 0; i < windows_x * 3; ++i) local.ssim_sum += window_ssim(sums, i, (double)win * win);
+                    local.ssim_windows += windows_x * 3;
+                    sums.clear();
+                }
+            }
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        total.sse += local.sse;
+        total.changed_channels += local.changed_channels;
+        total.changed_pixels += local.changed_pixels;
+        total.max_abs_diff = std::max(total.max_abs_diff, local.max_abs_diff);
+        total.ssim_sum += local.ssim_sum;
+        total.ssim_windows += local.ssim_windows;
+    });
+
+    if (!map.data.empty()) write_bmp(options.change_map, map);
+
+    CompareStats stats;
+    stats.width = width;
+    stats.height = height;
+    stats.channels = (uint64_t)row_bytes * height;
+    stats.changed_channels = total.changed_channels;
+    stats.changed_pixels = total.changed_pixels;
+    stats.max_abs_diff = total.max_abs_diff;
+    stats.mse = stats.channels ? (double)total.sse / stats.channels : 0;
+    stats.psnr = stats.mse > 0 ? 10 * std::log10(255.0 * 255.0 / stats.mse) : std::numeric_limits<double>::infinity();
+    stats.ssim = total.ssim_windows ? total.ssim_sum / total.ssim_windows : 1;
+    stats.elapsed_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return stats;
+}
@@ -0,0 +1,29 @@
+// compare.h
+// Image-quality metrics between a cover and its stego output
+#pragma once
+#include <cstdint>
+#include <string>
+
+struct CompareOptions {
+    unsigned threads = 0;
+    int window = 8;          // SSIM window side in pixels (non-overlapping)
+    std::string change_map;  // optional BMP output; empty to skip
+};
+
+struct CompareStats {
+    int width = 0;
+    int height = 0;
+    uint64_t channels = 0;
+    uint64_t changed_channels = 0;
+    uint64_t changed_pixels = 0;
+    int max_abs_diff = 0;
+    double mse = 0;
+    double psnr = 0;         // dB; infinity when the images are identical
+    double ssim = 1;         // mean over windows and B/G/R channels
+    double elapsed_ms = 0;
+};
+
+// Compares two BMP files of equal size through read-only mappings, in
+// parallel across row bands. The change map shows modified channels at full
+// intensity over a dimmed copy of `a`. Throws std::runtime_error on error.
+CompareStats compare_bmp_files(const std::string& a, const std::string& b, const CompareOptions& options = {});
@@ -0,0 +1,455 @@
+// container.cpp
+// Self-describing payload container: magic, kernel parameters, length, CRC
+#include "container.h"
+#include "mapped_file.h"
+#include "prng_permute.h"
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+
+namespace {
+
+constexpr uint32_t kMagic = 0x54464B31; // "TFK1"
+constexpr uint16_t kVersion = 2;
+constexpr uint16_t kVersionFixedLength = 1;
+
+using HeaderKernel = kernels::LsbKernel<1, 0x7, BitOrder::MsbFirst, EccType::None>;
+
+int log2_bits(int bits) { return bits == 4 ? 2 : bits == 2 ? 1 : 0; }
+
+uint16_t encode_flags(const KernelParams& p) {
+    return (uint16_t)(log2_bits(p.bits_per_channel) | (p.channel_mask << 2) | ((uint8_t)p.order << 5) |
+                      ((uint8_t)p.ecc << 6) | (kVersion << 12));
+}
+
+size_t varint_size(uint64_t v) {
+    size_t n = 1;
+    while (v >>= 7) ++n;
+    return n;
+}
+
+// Header bytes for a v2 header carrying `length`.
+size_t header_size(uint64_t length) { return 6 + varint_size(length) + 2; }
+
+// Payload channels start at the pixel after the header, so channel masks
+// line up with B/G/R.
+size_t payload_offset(size_t header_bytes) { return (header_bytes * 8 + 2) / 3 * 3; }
+
+size_t serialize_header(const ContainerHeader& h, uint8_t out[kContainerMaxHeaderBytes]) {
+    uint16_t flags = encode_flags(h.params);
+    size_t n = 0;
+    for (int shift = 24; shift >= 0; shift -= 8) out[n++] = (uint8_t)(kMagic >> shift);
+    out[n++] = (uint8_t)(flags >> 8);
+    out[n++] = (uint8_t)flags;
+    uint64_t v = h.length;
+    do {
+        out[n++] = (uint8_t)((v & 0x7F) | (v > 0x7F ? 0x80 : 0));
+        v >>= 7;
+    } while (v);
+    uint16_t crc = crc16_ccitt(out, n);
+    out[n++] = (uint8_t)(crc >> 8);
+    out[n++] = (uint8_t)crc;
+    return n;
+}
+
+// Keyed covers up to this many pixels are ordered by a prng_permutation
+// table, as older builds wrote them. Larger ones use KeyedBijection: the
+// table is 8 bytes per pixel (11.5 GB for 40000 x 36000) and would be built
+// just to probe a file for a header.
+constexpr uint64_t kKeyedTablePixels = 1ull << 26;
+
+// Keyed pixel order of a cover: q-th carrier pixel -> image pixel.
+struct PixelOrder {
+    Permutation table;
+    std::unique_ptr<KeyedBijection> bijection;
+
+    PixelOrder(uint64_t pixels, const std::string& passphrase) {
+        if (passphrase.empty()) return;
+        if (pixels <= kKeyedTablePixels) table = prng_permutation((size_t)pixels, passphrase);
+        else bijection = std::make_unique<KeyedBijection>(pixels, passphrase);
+    }
+
+    bool keyed() const { return !table.empty() || bijection; }
+    uint64_t operator[](uint64_t q) const { return bijection ? bijection->forward(q) : table[q]; }
+
+    CarrierMap map() const {
+        CarrierMap m;
+        if (!table.empty()) m.pixels = &table;
+        m.bijection = bijection.get();
+        return m;
+    }
+};
+
+// Carrier channel ranges of an in-memory image in keyed order, for covers
+// too large for a permutation table; same interface as FileCarrier.
+struct ImageCarrier {
+    const PixelOrder& order;
+
+    uint64_t channel(uint64_t i) const { return order[i / 3] * 3 + i % 3; }
+
+    std::vector<uint8_t> gather(const uint8_t* data, uint64_t begin, uint64_t end) const {
+        std::vector<uint8_t> out(end - begin);
+        for (uint64_t i = begin; i < end; ++i) out[i - begin] = data[channel(i)];
+        return out;
+    }
+
+    uint64_t scatter(uint8_t* data, uint64_t begin, const std::vector<uint8_t>& in) const {
+        for (uint64_t i = 0; i < in.size(); ++i) data[channel(begin + i)] = in[i];
+        return in.size();
+    }
+};
+
+// Carrier channel ranges of a mapped BMP file. Unkeyed carriers are the
+// file's rows in top-down order and move as row-sized runs; keyed carriers
+// follow the same pixel order as container_encode.
+struct FileCarrier {
+    const BMPInfo& info;
+    PixelOrder order;
+
+    FileCarrier(const BMPInfo& i, const std::string& passphrase)
+        : info(i), order((uint64_t)i.width * i.height, passphrase) {}
+
+    // Calls fn(file_offset, buffer_index, bytes) for each contiguous run of
+    // carrier channels [begin, end).
+    template <typename Fn>
+    void for_each_run(uint64_t begin, uint64_t end, Fn fn) const {
+        if (!order.keyed()) {
+            uint64_t row_bytes = (uint64_t)info.width * 3;
+            for (uint64_t i = begin; i < end;) {
+                uint64_t run = std::min(end, (i / row_bytes + 1) * row_bytes) - i;
+                fn(bmp_channel_offset(info, i), i - begin, run);
+                i += run;
+            }
+            return;
+        }
+        for (uint64_t i = begin; i < end;) {
+            uint64_t run = std::min<uint64_t>(end - i, 3 - i % 3);
+            fn(bmp_channel_offset(info, order[i / 3] * 3 + i % 3), i - begin, run);
+            i += run;
+        }
+    }
+
+    std::vector<uint8_t> gather(const uint8_t* file, uint64_t begin, uint64_t end) const {
+        std::vector<uint8_t> out(end - begin);
+        for_each_run(begin, end, [&](uint64_t off, uint64_t at, uint64_t n) { std::memcpy(&out[at], file + off, n); });
+        return out;
+    }
+
+    // Stores only the bytes that differ, so pages whose channels keep their
+    // value are never dirtied. Returns the number of bytes changed.
+    uint64_t scatter(uint8_t* file, uint64_t begin, const std::vector<uint8_t>& in) const {
+        uint64_t changed = 0;
+        for_each_run(begin, begin + in.size(), [&](uint64_t off, uint64_t at, uint64_t n) {
+            for (uint64_t k = 0; k < n; ++k) {
+                if (file[off + k] == in[at + k]) continue;
+                file[off + k] = in[at + k];
+                ++changed;
+            }
+        });
+        return changed;
+    }
+};
+
+// Header and payload embedding for the requested mode; matching directions
+// come from the passphrase, with separate streams for header and payload.
+struct Embedder {
+    const ContainerOptions& options;
+    const KernelOps& kernel;
+
+    explicit Embedder(const ContainerOptions& o) : options(o), kernel(select_kernel(o.params)) {
+        if (options.mode == EmbedMode::Match && !kernel.embed_matching)
+            throw std::runtime_error("LSB matching needs 1 bit per channel");
+    }
+
+    void header(uint8_t* channels, const uint8_t* bytes, size_t n) const {
+        if (options.mode == EmbedMode::Match)
+            HeaderKernel::embed_matching(channels, n * 8, bytes, n, keyed_hash(options.passphrase, 0));
+        else
+            HeaderKernel::embed(channels, n * 8, bytes, n);
+    }
+
+    void payload(uint8_t* channels, size_t n_channels, const std::vector<uint8_t>& message) const {
+        if (options.mode == EmbedMode::Match)
+            kernel.embed_matching(channels, n_channels, message.data(), message.size(),
+                                  keyed_hash(options.passphrase, 1));
+        else
+            kernel.embed(channels, n_channels, message.data(), message.size());
+    }
+};
+
+BMPInfo mapped_bmp_info(const MappedFile& file) {
+    BMPInfo info = parse_bmp_headers(file.data(), file.size());
+    if (file.size() < info.file_size) throw std::runtime_error("Truncated BMP pixel data");
+    return info;
+}
+
+template <typename Carrier>
+bool read_header(const uint8_t* data, const Carrier& carrier, uint64_t channels, ContainerHeader& header) {
+    if (channels < kContainerHeaderChannels) return false;
+    std::vector<uint8_t> prefix = carrier.gather(data, 0, std::min<uint64_t>(channels, kContainerMaxHeaderChannels));
+    return parse_container_header(prefix.data(), prefix.size(), header);
+}
+
+// Header and message over the carriers of `data`, gathering and scattering
+// only the span they need; returns the channel bytes changed.
+template <typename Carrier>
+uint64_t embed_span(uint8_t* data, const Carrier& carrier, uint64_t channels, const std::vector<uint8_t>& message,
+                    const ContainerOptions& options) {
+    Embedder embedder(options);
+    uint64_t cap = container_capacity(channels, options.params);
+    if (message.size() > cap)
+        throw std::runtime_error("Message too large for image (capacity: " + std::to_string(cap) + " bytes)");
+
+    ContainerHeader header{options.params, message.size()};
+    uint8_t header_bytes[kContainerMaxHeaderBytes];
+    size_t n = serialize_header(header, header_bytes);
+    size_t offset = payload_offset(n);
+
+    // Kernels keep the high bits of each channel, so the span is read first
+    std::vector<uint8_t> span = carrier.gather(data, 0, offset + embedder.kernel.span(message.size()));
+    embedder.header(span.data(), header_bytes, n);
+    embedder.payload(span.data() + offset, span.size() - offset, message);
+    return carrier.scatter(data, 0, span);
+}
+
+uint64_t embed_file(MappedFile& file, const FileCarrier& carrier, uint64_t channels,
+                    const std::vector<uint8_t>& message, const ContainerOptions& options) {
+    uint64_t changed = embed_span(file.data(), carrier, channels, message, options);
+    file.sync();
+    return changed;
+}
+
+} // namespace
+
+uint16_t crc16_ccitt(const uint8_t* data, size_t len) {
+    static const std::array<uint16_t, 256> table = [] {
+        std::array<uint16_t, 256> t{};
+        for (int n = 0; n < 256; ++n) {
+            uint16_t crc = (uint16_t)(n << 8);
+            for (int b = 0; b < 8; ++b) crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+            t[n] = crc;
+        }
+        return t;
+    }();
+    uint16_t crc = 0xFFFF;
+    for (size_t i = 0; i < len; ++i) crc = (uint16_t)((crc << 8) ^ table[(crc >> 8) ^ data[i]]);
+    return crc;
+}
+
+bool parse_container_header(const uint8_t* channels, size_t n_channels, ContainerHeader& header) {
+    uint8_t bytes[kContainerMaxHeaderBytes];
+    size_t n = 0;
+    auto next = [&](uint8_t& b) {
+        if ((n + 1) * 8 > n_channels) return false;
+        HeaderKernel::extract(channels + n * 8, 8, &b, 1);
+        bytes[n++] = b;
+        return true;
+    };
+    uint8_t b = 0;
+    uint32_t magic = 0;
+    for (int i = 0; i < 4; ++i) {
+        if (!next(b)) return false;
+        magic = (magic << 8) | b;
+    }
+    if (magic != kMagic) return false;
+    uint8_t hi = 0, lo = 0;
+    if (!next(hi) || !next(lo)) return false;
+    uint16_t flags = (uint16_t)((hi << 8) | lo);
+    uint16_t version = flags >> 12;
+    if ((version != kVersion && version != kVersionFixedLength) || (flags & 0x0E00)) return false;
+
+    uint64_t length = 0;
+    if (version == kVersionFixedLength) {
+        for (int i = 0; i < 4; ++i) {
+            if (!next(b)) return false;
+            length = (length << 8) | b;
+        }
+    } else {
+        for (int shift = 0;; shift += 7) {
+            if (shift > 63 || !next(b)) return false;
+            length |= (uint64_t)(b & 0x7F) << shift;
+            if (!(b & 0x80)) break;
+        }
+    }
+    size_t crc_at = n;
+    if (!next(hi) || !next(lo)) return false;
+    if (crc16_ccitt(bytes, crc_at) != (uint16_t)((hi << 8) | lo)) return false;
+
+    KernelParams p;
+    p.bits_per_channel = 1 << (flags & 0x3);
+    p.channel_mask = (uint8_t)((flags >> 2) & 0x7);
+    p.order = (BitOrder)((flags >> 5) & 0x1);
+    p.ecc = (EccType)((flags >> 6) & 0x7);
+    if (!kernel_params_valid(p)) return false;
+    header.params = p;
+    header.length = length;
+    header.header_bytes = n;
+    return true;
+}
+
+size_t container_payload_offset(const ContainerHeader& header) {
+    return payload_offset(header.header_bytes);
+}
+
+uint64_t container_capacity(uint64_t n_channels, const KernelParams& params) {
+    // The length never exceeds the channel count, so sizing the varint for
+    // n_channels is a safe (at most a few bytes pessimistic) bound
+    size_t offset = payload_offset(header_size(n_channels));
+    if (n_channels < offset) return 0;
+    return select_kernel(params).capacity(n_channels - offset);
+}
+
+size_t container_capacity(const BMPImage& img, const KernelParams& params) {
+    return container_capacity((uint64_t)img.data.size(), params);
+}
+
+uint64_t container_span(uint64_t length, const KernelParams& params) {
+    return payload_offset(header_size(length)) + select_kernel(params).span((size_t)length);
+}
+
+uint64_t container_span(const ContainerHeader& header) {
+    return container_payload_offset(header) + select_kernel(header.params).span((size_t)header.length);
+}
+
+void container_encode_channels(uint8_t* channels, size_t n_channels, const std::vector<uint8_t>& message,
+                               const ContainerOptions& options) {
+    Embedder embedder(options);
+    uint64_t cap = container_capacity((uint64_t)n_channels, options.params);
+    if (message.size() > cap)
+        throw std::runtime_error("Message too large for image (capacity: " + std::to_string(cap) + " bytes)");
+
+    ContainerHeader header{options.params, message.size()};
+    uint8_t header_bytes[kContainerMaxHeaderBytes];
+    size_t n = serialize_header(header, header_bytes);
+    size_t offset = payload_offset(n);
+    embedder.header(channels, header_bytes, n);
+    embedder.payload(channels + offset, n_channels - offset, message);
+}
+
+bool container_try_decode_channels(const uint8_t* channels, size_t n_channels, std::vector<uint8_t>& message,
+                                   ContainerDecodeInfo* info, const CarrierMap& map) {
+    ContainerHeader header;
+    if (!parse_container_header(channels, n_channels, header)) return false;
+    size_t offset = container_payload_offset(header);
+    const KernelOps& kernel = select_kernel(header.params);
+    if (offset > n_channels || header.length > kernel.capacity(n_channels - offset))
+        throw std::runtime_error("Message too large or corrupted");
+
+    message.assign(header.length, 0);
+    size_t corrected =
+        info && info->ecc
+            ? extract_with_stats(header.params, channels + offset, n_channels - offset, message.data(),
+                                 message.size(), offset, map, *info->ecc)
+            : kernel.extract(channels + offset, n_channels - offset, message.data(), message.size());
+    if (info) {
+        info->header = header;
+        info->corrected_codewords = corrected;
+    }
+    return true;
+}
+
+std::vector<uint64_t> container_keyed_pixels(uint64_t pixels, const std::string& passphrase, size_t count) {
+    PixelOrder order(pixels, passphrase);
+    std::vector<uint64_t> out((size_t)std::min<uint64_t>(count, pixels));
+    for (size_t q = 0; q < out.size(); ++q) out[q] = order[q];
+    return out;
+}
+
+void container_encode(BMPImage& img, const std::vector<uint8_t>& message, const ContainerOptions& options) {
+    // Fail before building the pixel order
+    size_t cap = container_capacity(img, options.params);
+    if (message.size() > cap)
+        throw std::runtime_error("Message too large for image (capacity: " + std::to_string(cap) + " bytes)");
+
+    PixelOrder order(img.data.size() / 3, options.passphrase);
+    if (order.bijection) {
+        embed_span(img.data.data(), ImageCarrier{order}, img.data.size(), message, options);
+        return;
+    }
+    std::vector<uint8_t> carrier = order.keyed() ? apply_pixel_permutation(img.data, order.table) : img.data;
+    container_encode_channels(carrier.data(), carrier.size(), message, options);
+    img.data = order.keyed() ? invert_pixel_permutation(carrier, order.table) : std::move(carrier);
+}
+
+bool container_try_decode(const BMPImage& img, const std::string& passphrase, std::vector<uint8_t>& message,
+                          ContainerDecodeInfo* info) {
+    if (img.data.size() < kContainerHeaderChannels) return false;
+    PixelOrder order(img.data.size() / 3, passphrase);
+    std::vector<uint8_t> carrier;
+    if (order.bijection) {
+        // Only the header and span are gathered, as for streamed PNGs
+        ImageCarrier keyed{order};
+        ContainerHeader header;
+        if (!read_header(img.data.data(), keyed, img.data.size(), header)) return false;
+        uint64_t span = container_span(header);
+        if (span > img.data.size()) throw std::runtime_error("Message too large or corrupted");
+        carrier = keyed.gather(img.data.data(), 0, span);
+    } else {
+        carrier = order.keyed() ? apply_pixel_permutation(img.data, order.table) : img.data;
+    }
+    if (info && info->ecc) info->ecc->reset(img.width, img.height);
+    return container_try_decode_channels(carrier.data(), carrier.size(), message, info, order.map());
+}
+
+void container_encode_file(const std::string& path, const std::vector<uint8_t>& message,
+                           const ContainerOptions& options) {
+    Embedder{options};  // rejects bad options before the file is touched
+    MappedFile file(path, MappedFile::Mode::ReadWrite);
+    BMPInfo info = mapped_bmp_info(file);
+    uint64_t channels = (uint64_t)info.width * info.height * 3;
+    // Fail before building the pixel order
+    uint64_t cap = container_capacity(channels, options.params);
+    if (message.size() > cap)
+        throw std::runtime_error("Message too large for image (capacity: " + std::to_string(cap) + " bytes)");
+    embed_file(file, FileCarrier(info, options.passphrase), channels, message, options);
+}
+
+bool container_update_file(const std::string& path, const std::vector<uint8_t>& message,
+                           const std::string& passphrase, ContainerHeader& old, uint64_t* bytes_written) {
+    MappedFile file(path, MappedFile::Mode::ReadWrite);
+    BMPInfo info = mapped_bmp_info(file);
+    uint64_t channels = (uint64_t)info.width * info.height * 3;
+    if (channels < kContainerHeaderChannels) return false;
+    FileCarrier carrier(info, passphrase);
+    if (!read_header(file.data(), carrier, channels, old)) return false;
+    ContainerOptions options;
+    options.params = old.params;
+    options.passphrase = passphrase;
+    uint64_t changed = embed_file(file, carrier, channels, message, options);
+    if (bytes_written) *bytes_written = changed;
+    return true;
+}
+
+bool container_try_decode_file(const std::string& path, const std::string& passphrase,
+                               std::vector<uint8_t>& message, ContainerDecodeInfo* info) {
+    MappedFile file(path, MappedFile::Mode::ReadOnly);
+    BMPInfo bmp = mapped_bmp_info(file);
+    uint64_t channels = (uint64_t)bmp.width * bmp.height * 3;
+    if (channels < kContainerHeaderChannels) return false;
+
+    FileCarrier carrier(bmp, passphrase);
+    ContainerHeader header;
+    if (!read_header(file.data(), carrier, channels, header)) return false;
+    size_t offset = container_payload_offset(header);
+    const KernelOps& kernel = select_kernel(header.params);
+    if (offset > channels || header.length > kernel.capacity(channels - offset))
+        throw std::runtime_error("Message too large or corrupted");
+
+    std::vector<uint8_t> span = carrier.gather(file.data(), offset, offset + kernel.span(header.length));
+    message.assign(header.length, 0);
+    size_t corrected;
+    if (info && info->ecc) {
+        info->ecc->reset(bmp.width, bmp.height);
+        corrected = extract_with_stats(header.params, span.data(), span.size(), message.data(), message.size(),
+                                       offset, carrier.order.map(), *info->ecc);
+    } else {
+        corrected = kernel.extract(span.data(), span.size(), message.data(), message.size());
+    }
+    if (info) {
+        info->header = header;
+        info->corrected_codewords = corrected;
+    }
+    return true;
+}
@@ -0,0 +1,101 @@
+// container.h
+// Self-describing payload container: magic, kernel parameters, length, CRC
+#pragma once
+#include "bmp.h"
+#include "ecc_stats.h"
+#include "kernels.h"
+#include <string>
+#include <vector>
+
+// The header occupies the first carrier channels, always at 1 bit per
+// channel, all channels, MSB first and without ECC, so it can be read before
+// the kernel is known:
+//   v2: magic "TFK1" (32) | flags (16) | length, LEB128 varint (8-80) | CRC-16/CCITT (16)
+//   v1: magic "TFK1" (32) | flags (16) | length, big-endian (32)      | CRC-16/CCITT (16)
+// flags: bits 0-1 log2(bits per channel), 2-4 channel mask, 5 bit order,
+// 6-8 ECC type, 12-15 format version. The payload follows at the first pixel
+// boundary after the header and is written by the kernel the flags select.
+// With a passphrase, whole pixels are visited in keyed order so channel
+// masks keep their B/G/R meaning: covers up to 2^26 pixels use the
+// prng_permutation table, larger ones KeyedBijection order, which needs no
+// table. Encoders write v2; v1 images still decode.
+constexpr size_t kContainerHeaderBytes = 12;     // v1 header size
+constexpr size_t kContainerMaxHeaderBytes = 18;  // v2 with a 10-byte varint
+constexpr size_t kContainerHeaderChannels = kContainerHeaderBytes * 8;
+constexpr size_t kContainerMaxHeaderChannels = kContainerMaxHeaderBytes * 8;
+
+struct ContainerOptions {
+    KernelParams params{1, 0x7, BitOrder::MsbFirst, EccType::Hamming74};
+    EmbedMode mode = EmbedMode::Replace; // not recorded; decoding is the same
+    std::string passphrase;
+};
+
+struct ContainerHeader {
+    KernelParams params;
+    uint64_t length = 0;     // message bytes before ECC
+    size_t header_bytes = 0; // serialized size, set by the parser
+};
+
+struct ContainerDecodeInfo {
+    ContainerHeader header;
+    size_t corrected_codewords = 0;
+    EccStats* ecc = nullptr;  // set by the caller to locate corrections in the image
+};
+
+// CRC-16/CCITT (poly 0x1021, init 0xFFFF) guarding headers and blocks.
+uint16_t crc16_ccitt(const uint8_t* data, size_t len);
+
+// Parses a header from the first channel bytes in carrier order; up to
+// kContainerMaxHeaderChannels are read. Returns false on a bad magic, CRC or
+// flags, or when `n_channels` ends inside the header.
+bool parse_container_header(const uint8_t* channels, size_t n_channels, ContainerHeader& header);
+
+// Channel index where the payload of a parsed header starts.
+size_t container_payload_offset(const ContainerHeader& header);
+
+// Message bytes that fit in `n_channels` (or the image) with the given kernel.
+uint64_t container_capacity(uint64_t n_channels, const KernelParams& params);
+size_t container_capacity(const BMPImage& img, const KernelParams& params);
+
+// Carrier channels, from channel 0, that a container of `length` message
+// bytes touches: header, padding to the payload and payload.
+uint64_t container_span(uint64_t length, const KernelParams& params);
+uint64_t container_span(const ContainerHeader& header);
+
+// Header and message over a carrier array already in carrier order, for
+// carriers other than BMP pixels (e.g. JPEG coefficient LSBs). No
+// permutation is applied; the passphrase only seeds LSB matching.
+void container_encode_channels(uint8_t* channels, size_t n_channels, const std::vector<uint8_t>& message,
+                               const ContainerOptions& options);
+// With info->ecc set, `map` places the carriers in an image of the size the
+// caller passed to EccStats::reset().
+bool container_try_decode_channels(const uint8_t* channels, size_t n_channels, std::vector<uint8_t>& message,
+                                   ContainerDecodeInfo* info = nullptr, const CarrierMap& map = CarrierMap());
+
+// First `count` image pixels of the keyed container order of a cover with
+// `pixels` pixels, e.g. to locate the header without touching the rest.
+std::vector<uint64_t> container_keyed_pixels(uint64_t pixels, const std::string& passphrase, size_t count);
+
+// Writes header and message. Throws std::runtime_error on overflow, bad params
+// or LSB matching with more than 1 bit per channel.
+void container_encode(BMPImage& img, const std::vector<uint8_t>& message, const ContainerOptions& options);
+
+// Decodes a container if the image holds one for this passphrase. Returns
+// false when no valid header is present (e.g. a legacy lsb_encode image).
+bool container_try_decode(const BMPImage& img, const std::string& passphrase, std::vector<uint8_t>& message,
+                          ContainerDecodeInfo* info = nullptr);
+
+// In-place variants working on a memory-mapped BMP file. Only the header and
+// payload channels are read or written, so the cost follows the message
+// size rather than the cover size and covers larger than RAM (or 4 GiB) are
+// fine. Keyed covers above 2^26 pixels need no permutation table either.
+void container_encode_file(const std::string& path, const std::vector<uint8_t>& message,
+                           const ContainerOptions& options);
+bool container_try_decode_file(const std::string& path, const std::string& passphrase,
+                               std::vector<uint8_t>& message, ContainerDecodeInfo* info = nullptr);
+// Replaces the message of the container already in a mapped BMP file,
+// keeping the kernel parameters of its header; only channel bytes that
+// change are written. Returns false and leaves the file alone when it holds
+// no container for this passphrase. `old` receives the header found.
+bool container_update_file(const std::string& path, const std::vector<uint8_t>& message,
+                           const std::string& passphrase, ContainerHeader& old, uint64_t* bytes_written = nullptr);
@@ -0,0 +1,304 @@
+// cover_index.cpp
+// Persistent index of cover statistics for picking covers out of a library
+#include "cover_index.h"
+#include "container.h"
+#include "lsb.h"
+#include "parallel.h"
+#include "png.h"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// File layout, little-endian: magic "TFCI", version (4), count (8), then per
+// cover mtime (8), size (8), width (4), height (4), lsb_ones_ratio,
+// chi_square_p, texture_mean, textured_fraction, detectability (8 each, IEEE
+// double), path length (4) and the path bytes.
+constexpr char kMagic[4] = {'T', 'F', 'C', 'I'};
+constexpr uint32_t kVersion = 1;
+constexpr size_t kRecordBytes = 8 + 8 + 4 + 4 + 5 * 8 + 4;
+
+void put(std::vector<uint8_t>& out, uint64_t v, int bytes) {
+    for (int i = 0; i < bytes; ++i) out.push_back((uint8_t)(v >> (8 * i)));
+}
+
+void put_double(std::vector<uint8_t>& out, double d) {
+    uint64_t v;
+    std::memcpy(&v, &d, 8);
+    put(out, v, 8);
+}
+
+uint64_t get(const uint8_t*& p, int bytes) {
+    uint64_t v = 0;
+    for (int i = 0; i < bytes; ++i) v |= (uint64_t)p[i] << (8 * i);
+    p += bytes;
+    return v;
+}
+
+double get_double(const uint8_t*& p) {
+    uint64_t v = get(p, 8);
+    double d;
+    std::memcpy(&d, &v, 8);
+    return d;
+}
+
+bool is_cover_name(const fs::path& path) {
+    std::string ext = path.extension().string();
+    for (char& c : ext) c = (char)std::tolower((unsigned char)c);
+    return ext == ".bmp" || ext == ".dib" || ext == ".png";
+}
+
+std::string normalized(const std::string& path) { return fs::absolute(path).lexically_normal().string(); }
+
+bool under(const std::string& path, const std::string& root) {
+    if (path.compare(0, root.size(), root) != 0) return false;
+    return path.size() == root.size() || root.back() == '/' || path[root.size()] == '/';
+}
+
+bool under_any(const std::string& path, const std::vector<std::string>& roots) {
+    for (const auto& root : roots)
+        if (under(path, root)) return true;
+    return false;
+}
+
+} // namespace
+
+CoverIndex::CoverIndex(std::string file) : file_(std::move(file)) {
+    std::ifstream in(file_, std::ios::binary);
+    if (!in) return;
+    std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    if (bytes.size() < 16 || std::memcmp(bytes.data(), kMagic, 4) != 0) return;
+    const uint8_t* p = bytes.data() + 4;
+    const uint8_t* end = bytes.data() + bytes.size();
+    if (get(p, 4) != kVersion) return;
+    uint64_t count = get(p, 8);
+    std::vector<CoverEntry> entries;
+    entries.reserve((size_t)std::min<uint64_t>(count, bytes.size() / kRecordBytes));
+    for (uint64_t i = 0; i < count; ++i) {
+        if ((size_t)(end - p) < kRecordBytes) return;  // truncated: start over
+        CoverEntry e;
+        e.mtime = (int64_t)get(p, 8);
+        e.size = get(p, 8);
+        CoverStats& s = e.stats;
+        s.width = (int)get(p, 4);
+        s.height = (int)get(p, 4);
+        s.lsb_ones_ratio = get_double(p);
+        s.chi_square_p = get_double(p);
+        s.texture_mean = get_double(p);
+        s.textured_fraction = get_double(p);
+        s.detectability = get_double(p);
+        uint32_t length = (uint32_t)get(p, 4);
+        if ((size_t)(end - p) < length) return;
+        e.path.assign(reinterpret_cast<const char*>(p), length);
+        p += length;
+        // Derived fields are not stored
+        BMPInfo info;
+        info.width = s.width;
+        info.height = s.height;
+        s.channels = (uint64_t)s.width * s.height * 3;
+        s.lsb_capacity = lsb_capacity(info);
+        entries.push_back(std::move(e));
+    }
+    entries_ = std::move(entries);
+}
+
+std::string CoverIndex::default_file() {
+    const char* xdg = std::getenv("XDG_CACHE_HOME");
+    const char* home = std::getenv("HOME");
+    fs::path dir;
+    if (xdg && *xdg) dir = fs::path(xdg) / "thousandflicks";
+    else if (home && *home) dir = fs::path(home) / ".cache" / "thousandflicks";
+    else dir = ".";
+    return (dir / "covers.idx").string();
+}
+
+IndexUpdateStats CoverIndex::update(const std::vector<std::string>& roots, unsigned threads) {
+    auto start = std::chrono::steady_clock::now();
+    IndexUpdateStats stats;
+    std::vector<std::string> abs_roots;
+    for (const auto& root : roots) abs_roots.push_back(normalized(root));
+
+    std::unordered_map<std::string, size_t> known;
+    known.reserve(entries_.size());
+    for (size_t i = 0; i < entries_.size(); ++i) known.emplace(entries_[i].path, i);
+    std::vector<bool> seen(entries_.size());
+
+    // Analysis is CPU bound, so one worker per core; the walk and the stat
+    // calls stay on this thread and feed them
+    if (threads == 0) threads = default_thread_count();
+    BoundedQueue<CoverEntry> pending(1024);
+    PipelineError error;
+    std::mutex results_mutex;
+    std::vector<CoverEntry> analyzed;
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < threads; ++t) {
+        workers.emplace_back([&] {
+            try {
+                CoverEntry e;
+                while (pending.pop(e)) {
+                    try {
+                        e.stats = analyze_cover(load_cover(e.path), 1);
+                    } catch (const std::exception&) {
+                        std::lock_guard<std::mutex> lock(results_mutex);
+                        ++stats.errors;
+                        continue;
+                    }
+                    std::lock_guard<std::mutex> lock(results_mutex);
+                    analyzed.push_back(std::move(e));
+                }
+            } catch (...) {
+                error.fail(pending);
+            }
+        });
+    }
+
+    // Walk failures are counted on this thread and folded in after the join
+    uint64_t walk_errors = 0;
+    auto visit = [&](const fs::path& file) {
+        std::error_code ec;
+        CoverEntry e;
+        e.path = fs::absolute(file).lexically_normal().string();
+        e.mtime = (int64_t)fs::last_write_time(file, ec).time_since_epoch().count();
+        if (!ec) e.size = (uint64_t)fs::file_size(file, ec);
+        ++stats.files_seen;
+        if (ec) {
+            ++walk_errors;
+            return true;
+        }
+        auto it = known.find(e.path);
+        if (it != known.end()) {
+            seen[it->second] = true;
+            if (entries_[it->second].mtime == e.mtime && entries_[it->second].size == e.size) return true;
+        }
+        return pending.push(std::move(e));
+    };
+    try {
+        for (const auto& root : roots) {
+            std::error_code ec;
+            if (fs::is_regular_file(root, ec)) {
+                visit(root);
+                continue;
+            }
+            fs::recursive_directory_iterator it(root, fs::directory_options::skip_permission_denied, ec), end;
+            if (ec) {
+                ++walk_errors;
+                continue;
+            }
+            for (; it != end; it.increment(ec)) {
+                if (ec) {
+                    ++walk_errors;
+                    break;
+                }
+                if (!it->is_regular_file(ec) || !is_cover_name(it->path())) continue;
+                if (!visit(it->path())) break;
+            }
+        }
+    } catch (...) {
+        error.fail(pending);
+    }
+    pending.close();
+    for (auto& w : workers) w.join();
+    error.rethrow();
+    stats.errors += walk_errors;
+
+    // Unchanged entries, entries outside the roots and fresh analyses;
+    // modified files drop their old entry for the new one
+    std::unordered_map<std::string, bool> replaced;
+    for (const auto& e : analyzed) replaced.emplace(e.path, true);
+    std::vector<CoverEntry> merged;
+    merged.reserve(entries_.size() + analyzed.size());
+    for (size_t i = 0; i < entries_.size(); ++i) {
+        if (replaced.count(entries_[i].path)) continue;
+        if (!seen[i] && under_any(entries_[i].path, abs_roots)) {
+            ++stats.removed;
+            continue;
+        }
+        merged.push_back(std::move(entries_[i]));
+    }
+    stats.analyzed = analyzed.size();
+    for (auto& e : analyzed) merged.push_back(std::move(e));
+    std::sort(merged.begin(), merged.end(), [](const CoverEntry& a, const CoverEntry& b) { return a.path < b.path; });
+    entries_ = std::move(merged);
+    stats.elapsed_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return stats;
+}
+
+void CoverIndex::save() const {
+    std::vector<uint8_t> out(kMagic, kMagic + 4);
+    put(out, kVersion, 4);
+    put(out, entries_.size(), 8);
+    for (const auto& e : entries_) {
+        const CoverStats& s = e.stats;
+        put(out, (uint64_t)e.mtime, 8);
+        put(out, e.size, 8);
+        put(out, (uint32_t)s.width, 4);
+        put(out, (uint32_t)s.height, 4);
+        put_double(out, s.lsb_ones_ratio);
+        put_double(out, s.chi_square_p);
+        put_double(out, s.texture_mean);
+        put_double(out, s.textured_fraction);
+        put_double(out, s.detectability);
+        put(out, e.path.size(), 4);
+        out.insert(out.end(), e.path.begin(), e.path.end());
+    }
+
+    fs::path file(file_);
+    std::error_code ec;
+    if (file.has_parent_path()) fs::create_directories(file.parent_path(), ec);
+    // Write-then-rename so a concurrent select never reads a partial index
+    fs::path tmp = file;
+    tmp += ".tmp";
+    {
+        std::ofstream f(tmp, std::ios::binary | std::ios::trunc);
+        if (!f.write(reinterpret_cast<const char*>(out.data()), (std::streamsize)out.size()))
+            throw std::runtime_error("Cannot write cover index: " + tmp.string());
+    }
+    fs::rename(tmp, file, ec);
+    if (ec) throw std::runtime_error("Cannot write cover index: " + file_);
+}
+
+double cover_risk(const CoverStats& stats, uint64_t payload_bytes, const KernelParams& params, double* rate) {
+    int per_pixel = kernels::mask_popcount(params.channel_mask);
+    uint64_t carriers = (uint64_t)stats.width * stats.height * per_pixel;
+    int unit_bits = params.ecc == EccType::Hamming74 ? 14 : 8;
+    double r = carriers ? (double)payload_bytes * unit_bits / carriers : 0;
+    if (rate) *rate = r;
+    if (stats.chi_square_p > 0.5) return 1.0;
+    return r * (0.25 + 0.75 * stats.detectability);
+}
+
+std::vector<CoverChoice> select_covers(const CoverIndex& index, const SelectOptions& options) {
+    std::vector<std::string> roots;
+    for (const auto& root : options.roots) roots.push_back(normalized(root));
+    std::vector<CoverChoice> choices;
+    for (const auto& e : index.entries()) {
+        if (!roots.empty() && !under_any(e.path, roots)) continue;
+        CoverChoice c;
+        c.entry = &e;
+        c.capacity = container_capacity(e.stats.channels, options.params);
+        if (c.capacity < options.payload_bytes) continue;
+        c.risk = cover_risk(e.stats, options.payload_bytes, options.params, &c.rate);
+        if (c.risk > options.max_risk) continue;
+        choices.push_back(c);
+    }
+    auto better = [](const CoverChoice& a, const CoverChoice& b) {
+        if (a.risk != b.risk) return a.risk < b.risk;
+        if (a.entry->stats.channels != b.entry->stats.channels) return a.entry->stats.channels < b.entry->stats.channels;
+        return a.entry->path < b.entry->path;
+    };
+    size_t keep = std::min(options.top, choices.size());
+    std::partial_sort(choices.begin(), choices.begin() + keep, choices.end(), better);
+    choices.resize(keep);
+    return choices;
+}
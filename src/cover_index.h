@@ -0,0 +1,79 @@
+// cover_index.h
+// Persistent index of cover statistics for picking covers out of a library
+#pragma once
+#include "analysis.h"
+#include "kernels.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct CoverEntry {
+    std::string path;  // absolute, normalized
+    int64_t mtime = 0;
+    uint64_t size = 0;
+    CoverStats stats;  // analyze_cover() of the decoded pixels
+};
+
+struct IndexUpdateStats {
+    uint64_t files_seen = 0;  // BMP and PNG files under the roots
+    uint64_t analyzed = 0;    // new or changed since the last update
+    uint64_t removed = 0;     // entries whose file is gone
+    uint64_t errors = 0;      // unreadable or undecodable files, left out
+    double elapsed_ms = 0;
+};
+
+// Cover features for a whole library in one compact binary file: a fixed
+// 68-byte record per cover plus its path, so 100k covers load in a few
+// milliseconds. Entries are keyed by (path, mtime, size) like StatsCache;
+// capacities are not stored since they follow from the dimensions for any
+// kernel.
+class CoverIndex {
+public:
+    // Loads `file` when it exists; a missing file or one in another format
+    // gives an empty index, which update() then rebuilds.
+    explicit CoverIndex(std::string file);
+
+    // $XDG_CACHE_HOME/thousandflicks/covers.idx (or under ~/.cache).
+    static std::string default_file();
+
+    // Walks files and directories under `roots` (*.bmp, *.dib, *.png) and
+    // analyzes new or modified covers on `threads` workers (0 = one per
+    // core). Entries under the roots whose files are gone are dropped;
+    // entries elsewhere are kept.
+    IndexUpdateStats update(const std::vector<std::string>& roots, unsigned threads = 0);
+
+    // Writes the index (write-then-rename). Throws std::runtime_error on error.
+    void save() const;
+
+    const std::string& file() const { return file_; }
+    const std::vector<CoverEntry>& entries() const { return entries_; }
+
+private:
+    std::string file_;
+    std::vector<CoverEntry> entries_;  // sorted by path
+};
+
+struct SelectOptions {
+    uint64_t payload_bytes = 0;
+    KernelParams params{1, 0x7, BitOrder::MsbFirst, EccType::Hamming74};
+    double max_risk = 0.1;           // see cover_risk()
+    size_t top = 10;
+    std::vector<std::string> roots;  // only covers under these; empty = all
+};
+
+struct CoverChoice {
+    const CoverEntry* entry = nullptr;
+    uint64_t capacity = 0;  // message bytes that fit with SelectOptions::params
+    double rate = 0;        // stored bits per carrier channel
+    double risk = 0;
+};
+
+// Detection risk estimate for embedding `payload_bytes`: the embedding rate
+// in stored bits per carrier channel, weighted by how flat the cover is
+// (0.25 + 0.75 x detectability), so textured covers absorb more. Covers
+// whose LSBs already look embedded (chi-square p > 0.5) score 1.
+double cover_risk(const CoverStats& stats, uint64_t payload_bytes, const KernelParams& params, double* rate = nullptr);
+
+// Covers that hold the payload within the risk budget, lowest risk first;
+// equal risks prefer the smaller cover.
+std::vector<CoverChoice> select_covers(const CoverIndex& index, const SelectOptions& options);
@@ -0,0 +1,272 @@
+// ecc_stats.cpp
+// Where ECC decoding corrected bits: per row band counters and a heatmap
+#include "ecc_stats.h"
+#include "hamming.h"
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+#include <stdexcept>
+
+namespace {
+
+// Payload bytes decoded per kernel call; only chunks with corrections are
+// re-embedded to locate them, so small chunks keep that work near the errors.
+constexpr size_t kChunkBytes = 32;
+
+// Channel offset of carrier c within a run that starts on a pixel.
+size_t carrier_channel(uint8_t mask, size_t c) {
+    if (mask == 0x7) return c;
+    int per_pixel = kernels::mask_popcount(mask);
+    int nth = (int)(c % per_pixel);
+    for (int ch = 0; ch < 3; ++ch)
+        if ((mask & (1 << ch)) && nth-- == 0) return c / per_pixel * 3 + ch;
+    return 0;
+}
+
+// Channels in [begin, end) whose B/G/R position is in the mask.
+uint64_t masked_channels(uint64_t begin, uint64_t end, uint8_t mask) {
+    if (mask == 0x7) return end - begin;
+    uint64_t n = 0;
+    for (uint64_t ch = 0; ch < 3; ++ch)
+        if (mask & (1 << ch)) n += (end + 2 - ch) / 3 - (begin + 2 - ch) / 3;
+    return n;
+}
+
+uint64_t band_damage(const EccBandStats& band) { return band.corrected + band.uncorrectable; }
+
+// x / d for a divisor fixed per decode: a multiply by the rounded-down
+// reciprocal is exact or one short, and one compare fixes that up
+struct Divider {
+    uint64_t d, m;
+    explicit Divider(uint64_t divisor) : d(divisor), m(UINT64_MAX / divisor) {}
+    uint64_t operator()(uint64_t x) const {
+        uint64_t q = (uint64_t)(((unsigned __int128)x * m) >> 64);
+        return q + ((q + 1) * d <= x);
+    }
+};
+
+} // namespace
+
+void EccStats::reset(int w, int h) {
+    if (band_rows < 1) throw std::runtime_error("ECC band rows must be at least 1");
+    width = w;
+    height = h;
+    bands.assign(h > 0 ? ((size_t)h + band_rows - 1) / band_rows : 0, EccBandStats());
+    corrected_at.clear();
+    uncorrectable_at.clear();
+}
+
+uint64_t EccStats::channels() const {
+    uint64_t n = 0;
+    for (const auto& b : bands) n += b.channels;
+    return n;
+}
+
+uint64_t EccStats::corrected() const {
+    uint64_t n = 0;
+    for (const auto& b : bands) n += b.corrected;
+    return n;
+}
+
+uint64_t EccStats::uncorrectable() const {
+    uint64_t n = 0;
+    for (const auto& b : bands) n += b.uncorrectable;
+    return n;
+}
+
+size_t extract_with_stats(const KernelParams& params, const uint8_t* channels, size_t n_channels, uint8_t* payload,
+                          size_t bytes, uint64_t first, const CarrierMap& map, EccStats& stats) {
+    const KernelOps& ops = select_kernel(params);
+    const uint8_t mask = params.channel_mask;
+    const int bits = params.bits_per_channel;
+    const int unit_bits = params.ecc == EccType::Hamming74 ? 14 : 8;
+    const int per_pixel = kernels::mask_popcount(mask);
+
+    // Payload channels per band: whole ranges when carriers are in image
+    // order, one lookup per pixel for the pixel-granular keyed orders and
+    // one per carrier for the channel-granular one
+    uint64_t span = std::min<uint64_t>(ops.span(bytes), n_channels);
+    const uint64_t band_bytes = (uint64_t)stats.width * 3 * stats.band_rows;
+    if (map.identity()) {
+        for (uint64_t at = first; at < first + span;) {
+            uint64_t end = std::min(first + span, (at / band_bytes + 1) * band_bytes);
+            stats.bands[stats.band_of(at)].channels += masked_channels(at, end, mask);
+            at = end;
+        }
+    } else if (map.channels) {
+        Divider band_of(band_bytes);
+        for (uint64_t c = 0; c < span; ++c)
+            if (mask & (1 << ((first + c) % 3))) ++stats.bands[band_of(map(first + c))].channels;
+    } else if (span) {
+        Divider band_of(band_bytes / 3);
+        // Four sets of counters so neighbouring pixels in one band do not
+        // wait on each other's increment
+        const size_t n_bands = stats.bands.size();
+        std::vector<uint64_t> pixels(4 * n_bands);
+        const uint64_t end = first + span, last = (end - 1) / 3;
+        uint64_t p = first / 3;
+        if (map.pixels) {
+            const size_t* order = map.pixels->data();
+            for (; p + 4 <= last + 1; p += 4)
+                for (int k = 0; k < 4; ++k) ++pixels[k * n_bands + band_of(order[p + k])];
+            for (; p <= last; ++p) ++pixels[band_of(order[p])];
+        } else {
+            for (; p <= last; ++p) ++pixels[band_of(map.bijection->forward(p))];
+        }
+        for (size_t b = 0; b < n_bands; ++b)
+            for (int k = 0; k < 4; ++k) stats.bands[b].channels += pixels[k * n_bands + b] * per_pixel;
+        // The first and last pixels may be cut by the span
+        auto trim = [&](uint64_t p, uint64_t begin, uint64_t stop) {
+            uint64_t missing = per_pixel - masked_channels(begin, stop, mask);
+            stats.bands[stats.band_of(map(p * 3))].channels -= missing;
+        };
+        if (last == first / 3) {
+            trim(last, first, end);
+        } else {
+            trim(first / 3, first, first / 3 * 3 + 3);
+            trim(last, last * 3, end);
+        }
+    }
+
+    // Chunks start on a whole channel, and a whole pixel for partial masks
+    const int step_bits = bits * (mask == 0x7 ? 1 : per_pixel);
+    const size_t granule = (size_t)(step_bits / std::gcd(unit_bits, step_bits));
+    const size_t chunk = (kChunkBytes + granule - 1) / granule * granule;
+    const uint8_t low_mask = (uint8_t)((1u << bits) - 1);
+    size_t corrected = 0;
+    std::vector<uint8_t> again;
+    for (size_t k = 0; k < bytes; k += chunk) {
+        size_t len = std::min(chunk, bytes - k);
+        size_t carriers = k * unit_bits / bits;
+        size_t offset = mask == 0x7 ? carriers : carriers / per_pixel * 3;
+        size_t fixed = ops.extract(channels + offset, n_channels - offset, payload + k, len);
+        corrected += fixed;
+        if (!fixed) continue;
+
+        // Writing the decoded bytes back shows which bits the decoder changed
+        size_t chunk_span = ops.span(len);
+        again.assign(channels + offset, channels + offset + chunk_span);
+        ops.embed(again.data(), chunk_span, payload + k, len);
+        // Padding bits in the last carrier are not payload
+        size_t used_bits = len * unit_bits;
+        size_t last = carrier_channel(mask, (used_bits + bits - 1) / bits - 1);
+        int pad = (int)((bits - used_bits % bits) % bits);
+        uint8_t last_mask = params.order == BitOrder::MsbFirst ? (uint8_t)(low_mask & ~((1u << pad) - 1))
+                                                               : (uint8_t)(low_mask >> pad);
+        const uint8_t* read = channels + offset;
+        for (size_t i = 0; i < chunk_span; ++i) {
+            // Eight channels at a time past the unchanged stretches
+            uint64_t a, b;
+            if (i + 8 <= chunk_span && i % 8 == 0) {
+                std::memcpy(&a, &again[i], 8);
+                std::memcpy(&b, read + i, 8);
+                if (!((a ^ b) & (kernels::kByteOnes * low_mask))) {
+                    i += 7;
+                    continue;
+                }
+            }
+            uint8_t diff = (uint8_t)((again[i] ^ read[i]) & (i == last ? last_mask : low_mask));
+            if (!diff) continue;
+            uint64_t at = map(first + offset + i);
+            stats.corrected_at.push_back(at);
+            stats.bands[stats.band_of(at)].corrected += (uint64_t)__builtin_popcount(diff);
+        }
+    }
+    return corrected;
+}
+
+std::vector<uint8_t> hamming74_decode_with_stats(const std::vector<uint8_t>& codewords, bool& had_error,
+                                                 uint64_t first, const CarrierMap& map, EccStats& stats) {
+    if (codewords.size() % 2 != 0) throw std::runtime_error("Hamming74: codeword length must be even");
+    std::vector<uint8_t> out(codewords.size() / 2);
+    had_error = false;
+    for (size_t j = 0; j < codewords.size(); ++j) {
+        uint8_t stored = codewords[j];
+        uint64_t base = first + 8 * j;  // carrier of bit 7, then bits 6..0
+        for (int b = 0; b < 8; ++b) ++stats.bands[stats.band_of(map(base + b))].channels;
+
+        bool err = false;
+        uint8_t nibble = hamming74_decode_codeword(stored, err);
+        out[j / 2] = (uint8_t)(j % 2 ? out[j / 2] | nibble : nibble << 4);
+        had_error |= err;
+        if (err) {
+            uint8_t diff = (uint8_t)((hamming74_encode_nibble(nibble) ^ stored) & 0x7F);
+            uint64_t at = map(base + 7 - __builtin_ctz(diff));
+            stats.corrected_at.push_back(at);
+            ++stats.bands[stats.band_of(at)].corrected;
+        }
+        if (stored & 0x80) {
+            // The spare bit is set: alone it is a harmless flip, with a
+            // nonzero syndrome the codeword took at least two hits
+            uint64_t at = map(base);
+            if (err) {
+                stats.uncorrectable_at.push_back(at);
+                ++stats.bands[stats.band_of(at)].uncorrectable;
+            } else {
+                stats.corrected_at.push_back(at);
+                ++stats.bands[stats.band_of(at)].corrected;
+            }
+        }
+    }
+    return out;
+}
+
+std::string ecc_diagnosis(const EccStats& stats) {
+    uint64_t total = stats.corrected() + stats.uncorrectable();
+    if (!total) return "clean: no bit errors";
+
+    // Shortest run of bands holding at least 80% of the damage
+    const size_t n = stats.bands.size();
+    size_t best_begin = 0, best_end = n;
+    uint64_t sum = 0;
+    for (size_t begin = 0, end = 0; end < n; ++end) {
+        sum += band_damage(stats.bands[end]);
+        while (begin < end && (sum - band_damage(stats.bands[begin])) * 5 >= total * 4)
+            sum -= band_damage(stats.bands[begin++]);
+        if (sum * 5 >= total * 4 && end + 1 - begin < best_end - best_begin) {
+            best_begin = begin;
+            best_end = end + 1;
+        }
+    }
+    size_t payload_bands = (size_t)std::count_if(stats.bands.begin(), stats.bands.end(),
+                                                 [](const EccBandStats& b) { return b.channels > 0; });
+    if (payload_bands < 4 || (best_end - best_begin) * 4 > payload_bands)
+        return "spread across the image, like random channel noise";
+
+    int row_begin = (int)best_begin * stats.band_rows;
+    int row_end = std::min(stats.height, (int)best_end * stats.band_rows) - 1;
+    std::string rows = "rows " + std::to_string(row_begin) + "-" + std::to_string(row_end);
+    if (best_begin == 0 || best_end == n)
+        return "concentrated in " + rows + " at the image edge, like a truncated or overwritten file end";
+    return "concentrated in " + rows + ", like a local edit or a damaged block of the file";
+}
+
+BMPImage ecc_heatmap(const BMPImage& cover, const EccStats& stats) {
+    if (cover.width != stats.width || cover.height != stats.height)
+        throw std::runtime_error("ECC heatmap: cover size does not match the decode");
+    uint64_t worst = 0;
+    for (const auto& band : stats.bands) worst = std::max(worst, band_damage(band));
+
+    BMPImage map{cover.width, cover.height, std::vector<uint8_t>(cover.data.size())};
+    const size_t row_bytes = (size_t)cover.width * 3;
+    for (size_t y = 0; y < (size_t)cover.height; ++y) {
+        uint64_t damage = band_damage(stats.bands[y / stats.band_rows]);
+        int tint = damage ? (int)(192 * damage / worst) : 0;
+        const uint8_t* in = &cover.data[y * row_bytes];
+        uint8_t* out = &map.data[y * row_bytes];
+        for (size_t i = 0; i < row_bytes; i += 3) {
+            out[i] = in[i] >> 2;
+            out[i + 1] = in[i + 1] >> 2;
+            out[i + 2] = (uint8_t)std::min(255, (in[i + 2] >> 2) + tint);
+        }
+    }
+    auto paint = [&](uint64_t channel, uint8_t g) {
+        uint8_t* px = &map.data[channel / 3 * 3];
+        px[0] = 0;
+        px[1] = g;
+        px[2] = 255;
+    };
+    for (uint64_t at : stats.corrected_at) paint(at, 0);
+    for (uint64_t at : stats.uncorrectable_at) paint(at, 255);
+    return map;
+}
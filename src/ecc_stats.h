@@ -0,0 +1,76 @@
+// ecc_stats.h
+// Where ECC decoding corrected bits: per row band counters and a heatmap
+#pragma once
+#include "bmp.h"
+#include "kernels.h"
+#include "prng_permute.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct EccBandStats {
+    uint64_t channels = 0;       // payload carrier channels in the band
+    uint64_t corrected = 0;      // bits the decoder flipped back
+    uint64_t uncorrectable = 0;  // codewords known to hold more errors than it can fix
+};
+
+// Corrections mapped back to image coordinates. Hamming(7,4) repairs one bit
+// per codeword and silently miscorrects two, so a codeword only counts as
+// uncorrectable when the layout leaves a spare bit to notice it: the legacy
+// layout stores each codeword in a byte whose top bit is always 0. Container
+// units are packed back to back and have none.
+struct EccStats {
+    int width = 0;
+    int height = 0;
+    int band_rows = 32;  // set before decoding
+    std::vector<EccBandStats> bands;
+    std::vector<uint64_t> corrected_at;      // channel (BMPImage order) of each corrected bit
+    std::vector<uint64_t> uncorrectable_at;  // first channel of each uncorrectable codeword
+
+    // Called by the decoder once the image size is known; clears everything.
+    void reset(int w, int h);
+
+    size_t band_of(uint64_t channel) const { return (size_t)(channel / ((uint64_t)width * 3) / band_rows); }
+    uint64_t channels() const;
+    uint64_t corrected() const;
+    uint64_t uncorrectable() const;
+};
+
+// Where carrier index i of a decode lives in BMPImage data. At most one of
+// the keyed orders is set; with none, carriers are the channels in order.
+struct CarrierMap {
+    const Permutation* pixels = nullptr;        // pixel-granular order (containers)
+    const Permutation* channels = nullptr;      // channel-granular order (legacy layout)
+    const KeyedBijection* bijection = nullptr;  // streamed PNG order
+
+    uint64_t operator()(uint64_t i) const {
+        if (pixels) return (*pixels)[i / 3] * 3 + i % 3;
+        if (channels) return (*channels)[i];
+        if (bijection) return bijection->forward(i / 3) * 3 + i % 3;
+        return i;
+    }
+    bool identity() const { return !pixels && !channels && !bijection; }
+};
+
+// select_kernel(params).extract over carriers [first, first + n_channels)
+// that also fills `stats`. The payload is decoded in chunks; a chunk that
+// needed corrections is re-embedded and compared with what was read, which
+// pins down every corrected bit, so clean chunks cost nothing extra. Counting
+// payload channels per band takes one carrier map lookup per pixel under a
+// keyed order.
+size_t extract_with_stats(const KernelParams& params, const uint8_t* channels, size_t n_channels, uint8_t* payload,
+                          size_t bytes, uint64_t first, const CarrierMap& map, EccStats& stats);
+
+// hamming74_decode over legacy-layout codeword bytes read from carriers
+// starting at `first` (one bit per channel, MSB first), filling `stats`.
+std::vector<uint8_t> hamming74_decode_with_stats(const std::vector<uint8_t>& codewords, bool& had_error,
+                                                 uint64_t first, const CarrierMap& map, EccStats& stats);
+
+// One-line reading of the band counters: clean, spread out like channel
+// noise, or concentrated in a run of rows (and whether that run sits at an
+// edge, as a truncated or overwritten file end would).
+std::string ecc_diagnosis(const EccStats& stats);
+
+// Dimmed copy of the cover with each row band tinted red by its share of the
+// corrections, corrected pixels in full red and uncorrectable ones in yellow.
+BMPImage ecc_heatmap(const BMPImage& cover, const EccStats& stats);
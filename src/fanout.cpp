@@ -0,0 +1,159 @@
+// fanout.cpp
+// One cover, many payloads: per-recipient outputs patched from a shared cover
+#include "fanout.h"
+#include "bmp.h"
+#include "buffers.h"
+#include "file_io.h"
+#include "hamming.h"
+#include "lsb.h"
+#include "mapped_file.h"
+#include "parallel.h"
+#include "prng_permute.h"
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <set>
+#include <stdexcept>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// Patches closer than this are written together from memory; longer
+// unchanged spans are copied file-to-file.
+constexpr uint64_t kMinCopySpan = 64 * 1024;
+
+struct Patch {
+    uint64_t offset;
+    uint8_t value;
+    bool operator<(const Patch& o) const { return offset < o.offset; }
+};
+
+std::string safe_name(const std::string& text) {
+    std::string name;
+    for (char c : text) name += (std::isalnum((unsigned char)c) || c == '-' || c == '_' || c == '.') ? c : '_';
+    if (name.empty() || name[0] == '.') name = "_" + name;
+    return name;
+}
+
+} // namespace
+
+FanoutStats fanout_encode(const std::string& cover, const std::vector<FanoutJob>& jobs,
+                          const FanoutOptions& options) {
+    auto start = std::chrono::steady_clock::now();
+    BMPInfo info = probe_bmp(cover);
+    MappedFile mapped(cover, MappedFile::Mode::ReadOnly);
+    if (mapped.size() < info.file_size) throw std::runtime_error("Truncated BMP pixel data");
+    FileDescriptor cover_fd = open_for_read(cover);
+    const uint8_t* base = mapped.data();
+    const uint64_t file_size = mapped.size();
+
+    // An output resolving to the cover would truncate it under the mapping
+    std::set<std::string> outputs;
+    for (const auto& job : jobs) {
+        if (!outputs.insert(job.output).second) throw std::runtime_error("Duplicate output path: " + job.output);
+        std::error_code ec;
+        if (fs::equivalent(job.output, cover, ec)) throw std::runtime_error("Output path is the cover: " + job.output);
+    }
+
+    // Hamming-code every payload first to size the shared position table
+    std::vector<std::vector<uint8_t>> encoded(jobs.size());
+    size_t cap = lsb_capacity(info), longest = 0;
+    for (size_t j = 0; j < jobs.size(); ++j) {
+        encoded[j] = hamming74_encode(jobs[j].message);
+        if (encoded[j].size() > cap)
+            throw std::runtime_error("Message too large for image (capacity: " + std::to_string(cap) +
+                                     " bytes): " + jobs[j].output);
+        longest = std::max(longest, encoded[j].size());
+    }
+
+    // File offset of every stream bit any job needs, computed once
+    size_t channels = (size_t)info.width * info.height * 3;
+    size_t bits = 32 + longest * 8;
+    std::vector<uint64_t> offsets(bits);
+    {
+        Permutation perm;
+        if (!options.passphrase.empty()) perm = prng_permutation(channels, options.passphrase);
+        for (size_t i = 0; i < bits; ++i) offsets[i] = bmp_channel_offset(info, perm.empty() ? i : perm[i]);
+    }
+
+    std::atomic<uint64_t> patched{0}, written{0}, copied{0};
+    parallel_for(jobs.size(), options.threads, [&](size_t begin, size_t end) {
+        NumaWorkerScope numa(begin, jobs.size());
+        std::vector<Patch> patches;
+        std::vector<uint8_t> region;
+        for (size_t j = begin; j < end; ++j) {
+            patches.clear();
+            size_t n_bits = 32 + encoded[j].size() * 8;
+            for (size_t i = 0; i < n_bits; ++i) {
+                uint64_t off = offsets[i];
+                uint8_t value = (uint8_t)((base[off] & 0xFE) | lsb_stream_bit(encoded[j], i));
+                if (value != base[off]) patches.push_back({off, value});
+            }
+            std::sort(patches.begin(), patches.end());
+
+            FileDescriptor out = open_for_write(jobs[j].output);
+            uint64_t pos = 0;
+            for (size_t k = 0; k < patches.size();) {
+                // Dirty region: patches separated by less than kMinCopySpan
+                size_t last = k;
+                while (last + 1 < patches.size() && patches[last + 1].offset - patches[last].offset < kMinCopySpan)
+                    ++last;
+                uint64_t r_begin = patches[k].offset, r_end = patches[last].offset + 1;
+                if (r_begin > pos) {
+                    copy_file_span(cover_fd.get(), out.get(), pos, r_begin - pos);
+                    copied += r_begin - pos;
+                }
+                region.assign(base + r_begin, base + r_end);
+                for (; k <= last; ++k) region[patches[k].offset - r_begin] = patches[k].value;
+                pwrite_full(out.get(), region.data(), region.size(), r_begin);
+                written += region.size();
+                pos = r_end;
+            }
+            if (pos < file_size) {
+                copy_file_span(cover_fd.get(), out.get(), pos, file_size - pos);
+                copied += file_size - pos;
+            }
+            patched += patches.size();
+        }
+    });
+
+    FanoutStats stats;
+    stats.outputs = jobs.size();
+    stats.bytes_patched = patched;
+    stats.bytes_written = written;
+    stats.bytes_copied = copied;
+    stats.elapsed_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return stats;
+}
+
+std::vector<FanoutJob> fanout_jobs(const std::string& payloads, const std::string& output_dir) {
+    std::vector<FanoutJob> jobs;
+    fs::create_directories(output_dir);
+    if (fs::is_directory(payloads)) {
+        std::vector<fs::path> files;
+        for (const auto& entry : fs::directory_iterator(payloads))
+            if (entry.is_regular_file()) files.push_back(entry.path());
+        std::sort(files.begin(), files.end());
+        for (const auto& path : files) {
+            std::ifstream in(path, std::ios::binary);
+            if (!in) throw std::runtime_error("Cannot open payload file: " + path.string());
+            std::vector<uint8_t> message((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+            jobs.push_back({(fs::path(output_dir) / (path.stem().string() + ".bmp")).string(), std::move(message)});
+        }
+        return jobs;
+    }
+    std::ifstream in(payloads);
+    if (!in) throw std::runtime_error("Cannot open payload list: " + payloads);
+    std::string line;
+    while (std::getline(in, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (line.empty()) continue;
+        jobs.push_back({(fs::path(output_dir) / (safe_name(line) + ".bmp")).string(),
+                        std::vector<uint8_t>(line.begin(), line.end())});
+    }
+    return jobs;
+}
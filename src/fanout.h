@@ -0,0 +1,40 @@
+// fanout.h
+// One cover, many payloads: per-recipient outputs patched from a shared cover
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct FanoutJob {
+    std::string output;
+    std::vector<uint8_t> message; // raw message; Hamming-coded like `encode`
+};
+
+struct FanoutOptions {
+    std::string passphrase;
+    unsigned threads = 0;
+};
+
+struct FanoutStats {
+    size_t outputs = 0;
+    uint64_t bytes_patched = 0;  // channel bytes whose LSB changed
+    uint64_t bytes_written = 0;  // written from memory (dirty regions)
+    uint64_t bytes_copied = 0;   // copied file-to-file (copy_file_range)
+    double elapsed_ms = 0;
+
+    double outputs_per_second() const { return elapsed_ms > 0 ? outputs * 1000.0 / elapsed_ms : 0; }
+};
+
+// Embeds each job's message into the same cover with the legacy layout
+// (the same bits `encode` would write). The cover is mapped once and the
+// keyed channel positions are computed once. Each output is the cover file
+// with only the changed bytes rewritten: unchanged spans are copied with
+// copy_file_range, which shares extents on reflink-capable filesystems.
+// Outputs are produced in parallel. Throws std::runtime_error on error.
+FanoutStats fanout_encode(const std::string& cover, const std::vector<FanoutJob>& jobs,
+                          const FanoutOptions& options = {});
+
+// Builds jobs from a directory of payload files (one output per file, named
+// after it) or from a text file with one payload per line (e.g. recipient
+// IDs; outputs are named after the line).
+std::vector<FanoutJob> fanout_jobs(const std::string& payloads, const std::string& output_dir);
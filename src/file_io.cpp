@@ -0,0 +1,82 @@
+// file_io.cpp
+// Positioned file I/O helpers (POSIX pread/pwrite)
+#include "file_io.h"
+#include <algorithm>
+#include <cerrno>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+
+FileDescriptor::~FileDescriptor() {
+    if (fd_ >= 0) ::close(fd_);
+}
+
+FileDescriptor::FileDescriptor(FileDescriptor&& other) noexcept : fd_(std::exchange(other.fd_, -1)) {}
+
+FileDescriptor& FileDescriptor::operator=(FileDescriptor&& other) noexcept {
+    if (this != &other) {
+        if (fd_ >= 0) ::close(fd_);
+        fd_ = std::exchange(other.fd_, -1);
+    }
+    return *this;
+}
+
+FileDescriptor open_for_read(const std::string& filename) {
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) throw std::runtime_error("Cannot open file: " + filename);
+    return FileDescriptor(fd);
+}
+
+FileDescriptor open_for_write(const std::string& filename) {
+    int fd = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) throw std::runtime_error("Cannot write file: " + filename);
+    return FileDescriptor(fd);
+}
+
+void pread_full(int fd, void* buf, size_t len, uint64_t offset) {
+    auto* p = static_cast<uint8_t*>(buf);
+    while (len) {
+        ssize_t n = ::pread(fd, p, len, (off_t)offset);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) throw std::runtime_error("Short read from file");
+        p += n;
+        len -= (size_t)n;
+        offset += (uint64_t)n;
+    }
+}
+
+void pwrite_full(int fd, const void* buf, size_t len, uint64_t offset) {
+    auto* p = static_cast<const uint8_t*>(buf);
+    while (len) {
+        ssize_t n = ::pwrite(fd, p, len, (off_t)offset);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) throw std::runtime_error("Write to file failed");
+        p += n;
+        len -= (size_t)n;
+        offset += (uint64_t)n;
+    }
+}
+
+void copy_file_span(int in_fd, int out_fd, uint64_t offset, uint64_t len) {
+#ifdef __linux__
+    loff_t in_off = (loff_t)offset, out_off = (loff_t)offset;
+    while (len) {
+        ssize_t n = ::copy_file_range(in_fd, &in_off, out_fd, &out_off, len, 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break; // unsupported or cross-device: fall back below
+        len -= (uint64_t)n;
+    }
+    offset = (uint64_t)in_off;
+#endif
+    if (!len) return;
+    std::vector<uint8_t> buf((size_t)std::min<uint64_t>(len, 1 << 20));
+    while (len) {
+        size_t chunk = len < buf.size() ? (size_t)len : buf.size();
+        pread_full(in_fd, buf.data(), chunk, offset);
+        pwrite_full(out_fd, buf.data(), chunk, offset);
+        offset += chunk;
+        len -= chunk;
+    }
+}
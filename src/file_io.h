@@ -0,0 +1,41 @@
+// file_io.h
+// Positioned file I/O helpers (POSIX pread/pwrite)
+#pragma once
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+// Owning wrapper around a POSIX file descriptor.
+class FileDescriptor {
+public:
+    FileDescriptor() = default;
+    explicit FileDescriptor(int fd) : fd_(fd) {}
+    ~FileDescriptor();
+
+    FileDescriptor(const FileDescriptor&) = delete;
+    FileDescriptor& operator=(const FileDescriptor&) = delete;
+    FileDescriptor(FileDescriptor&& other) noexcept;
+    FileDescriptor& operator=(FileDescriptor&& other) noexcept;
+
+    int get() const { return fd_; }
+    explicit operator bool() const { return fd_ >= 0; }
+
+private:
+    int fd_ = -1;
+};
+
+// Opens an existing file for reading. Throws std::runtime_error on error.
+FileDescriptor open_for_read(const std::string& filename);
+
+// Creates or truncates a file for writing. Throws std::runtime_error on error.
+FileDescriptor open_for_write(const std::string& filename);
+
+// Reads exactly `len` bytes at `offset`. Throws std::runtime_error on short read.
+void pread_full(int fd, void* buf, size_t len, uint64_t offset);
+
+// Writes exactly `len` bytes at `offset`. Throws std::runtime_error on error.
+void pwrite_full(int fd, const void* buf, size_t len, uint64_t offset);
+
+// Copies `len` bytes between files at the same offset, using copy_file_range
+// where the kernel supports it and a pread/pwrite loop otherwise.
+void copy_file_span(int in_fd, int out_fd, uint64_t offset, uint64_t len);
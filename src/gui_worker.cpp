@@ -0,0 +1,164 @@
+// gui_worker.cpp
+// Background job runner for the ImGui front-end: progress, cancel, previews
+#include "gui_worker.h"
+#include "bmp.h"
+#include "stego.h"
+#include <algorithm>
+
+namespace {
+constexpr int kPreviewBandRows = 8;
+}
+
+void SharedPreview::reset(int width, int height) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    image_.width = width;
+    image_.height = height;
+    image_.rgba.assign((size_t)width * height * 4, 0);
+    rows_ = 0;
+    ++generation_;
+}
+
+void SharedPreview::publish(const PreviewImage& source, int row_begin, int row_end) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_t stride = (size_t)source.width * 4;
+    std::copy(source.rgba.begin() + row_begin * stride, source.rgba.begin() + row_end * stride,
+              image_.rgba.begin() + row_begin * stride);
+    rows_ = std::max(rows_, row_end);
+}
+
+GuiWorker::GuiWorker() : thread_([this] { run(); }) {}
+
+GuiWorker::~GuiWorker() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+        cancel_ = true;
+    }
+    wake_.notify_one();
+    thread_.join();
+}
+
+bool GuiWorker::submit(GuiJob job) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (busy_) return false;
+    job_ = std::move(job);
+    has_job_ = true;
+    has_result_ = false;
+    busy_ = true;
+    cancel_ = false;
+    stage_ = "Queued";
+    progress_ = 0;
+    wake_.notify_one();
+    return true;
+}
+
+float GuiWorker::progress(std::string& stage) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stage = stage_;
+    return progress_;
+}
+
+bool GuiWorker::take_result(GuiJobResult& result) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!has_result_) return false;
+    result = std::move(result_);
+    has_result_ = false;
+    return true;
+}
+
+void GuiWorker::set_stage(const char* stage, float progress) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stage_ = stage;
+    progress_ = progress;
+}
+
+void GuiWorker::check_cancel() const {
+    if (cancel_) throw Cancelled{};
+}
+
+void GuiWorker::run() {
+    for (;;) {
+        GuiJob job;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            wake_.wait(lock, [this] { return stop_ || has_job_; });
+            if (stop_) return;
+            job = std::move(job_);
+            has_job_ = false;
+        }
+        GuiJobResult result;
+        try {
+            result = execute(job);
+        } catch (const Cancelled&) {
+            result.cancelled = true;
+            result.status = "[CANCELLED] Stopped before completion";
+        } catch (const std::exception& e) {
+            result.status = std::string("[ERR] ") + e.what();
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        result_ = std::move(result);
+        has_result_ = true;
+        stage_ = result_.cancelled ? "Cancelled" : "Done";
+        progress_ = 1;
+        busy_ = false;
+    }
+}
+
+template <typename Fill>
+void GuiWorker::build_preview(SharedPreview& shared, PreviewImage& image, Fill fill, float from, float to) {
+    shared.reset(image.width, image.height);
+    for (int row = 0; row < image.height; row += kPreviewBandRows) {
+        check_cancel();
+        int end = std::min(image.height, row + kPreviewBandRows);
+        fill(image, row, end);
+        shared.publish(image, row, end);
+        progress_ = from + (to - from) * end / image.height;
+    }
+}
+
+GuiJobResult GuiWorker::execute(const GuiJob& job) {
+    GuiJobResult result;
+    set_stage("Loading image", 0.0f);
+    BMPImage img = load_bmp(job.input_path);
+    check_cancel();
+
+    set_stage("Building preview", 0.1f);
+    PreviewImage cover = make_preview(img.width, img.height, job.preview_side);
+    build_preview(cover_, cover, [&](PreviewImage& p, int b, int e) { downsample_rows(img, p, b, e); }, 0.1f, 0.4f);
+    PreviewImage lsb = make_preview(img.width, img.height, job.preview_side);
+
+    if (job.kind == GuiJob::Kind::Encode) {
+        auto original = pack_lsbs(img);
+        check_cancel();
+        set_stage("Embedding", 0.45f);
+        encode_legacy_message(img, std::vector<uint8_t>(job.message.begin(), job.message.end()), job.passphrase);
+        check_cancel();
+        set_stage("Writing", 0.6f);
+        write_bmp(job.output_path, img);
+        result.ok = true;
+        result.status = "[OK] Encoded and saved: " + job.output_path;
+
+        // The file is complete; cancelling now only stops the diff view
+        set_stage("LSB diff", 0.7f);
+        try {
+            build_preview(lsb_, lsb, [&](PreviewImage& p, int b, int e) { lsb_plane_rows(img, &original, p, b, e); },
+                          0.7f, 1.0f);
+        } catch (const Cancelled&) {
+        }
+        return result;
+    }
+
+    set_stage("Decoding", 0.45f);
+    DecodedMessage decoded = decode_message(img, job.passphrase);
+    check_cancel();
+    result.ok = true;
+    result.message.assign(decoded.data.begin(), decoded.data.end());
+    result.status = decoded.had_error ? "[OK] Decoded; Hamming ECC corrected bit errors" : "[OK] Decoded message.";
+    set_stage("LSB plane", 0.7f);
+    try {
+        build_preview(lsb_, lsb, [&](PreviewImage& p, int b, int e) { lsb_plane_rows(img, nullptr, p, b, e); },
+                      0.7f, 1.0f);
+    } catch (const Cancelled&) {
+    }
+    return result;
+}
@@ -0,0 +1,109 @@
+// gui_worker.h
+// Background job runner for the ImGui front-end: progress, cancel, previews
+#pragma once
+#include "preview.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// Preview written band by band by the worker and uploaded by the render
+// loop. Readers keep a cursor and only receive rows they have not seen.
+class SharedPreview {
+public:
+    struct Cursor {
+        uint64_t generation = 0;
+        int rows = 0;
+    };
+
+    void reset(int width, int height);
+    void publish(const PreviewImage& source, int row_begin, int row_end);
+
+    // Calls fn(width, height, rgba, row_begin, row_end, resized) for new rows.
+    // `resized` is true the first time a new image is seen.
+    template <typename Fn>
+    void consume(Cursor& cursor, Fn&& fn) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        bool resized = cursor.generation != generation_;
+        if (resized) cursor = Cursor{generation_, 0};
+        if (resized || cursor.rows < rows_) {
+            fn(image_.width, image_.height, image_.rgba.data(), cursor.rows, rows_, resized);
+            cursor.rows = rows_;
+        }
+    }
+
+private:
+    std::mutex mutex_;
+    PreviewImage image_;
+    int rows_ = 0;
+    uint64_t generation_ = 0;
+};
+
+struct GuiJob {
+    enum class Kind { Encode, Decode };
+    Kind kind = Kind::Encode;
+    std::string input_path;
+    std::string output_path;
+    std::string passphrase;
+    std::string message;
+    int preview_side = 512;
+};
+
+struct GuiJobResult {
+    bool ok = false;
+    bool cancelled = false;
+    std::string status;
+    std::string message; // decoded text
+};
+
+// Runs one job at a time on its own thread. All methods are called from the
+// UI thread and return immediately.
+class GuiWorker {
+public:
+    GuiWorker();
+    ~GuiWorker();
+    GuiWorker(const GuiWorker&) = delete;
+    GuiWorker& operator=(const GuiWorker&) = delete;
+
+    // Returns false while a job is still running.
+    bool submit(GuiJob job);
+    void cancel() { cancel_ = true; }
+    bool busy() const { return busy_; }
+
+    // Current stage label and overall completion in [0, 1].
+    float progress(std::string& stage) const;
+
+    // Moves the finished job's result out, once.
+    bool take_result(GuiJobResult& result);
+
+    SharedPreview& cover_preview() { return cover_; }
+    SharedPreview& lsb_preview() { return lsb_; }
+
+private:
+    struct Cancelled {};
+
+    void run();
+    GuiJobResult execute(const GuiJob& job);
+    void set_stage(const char* stage, float progress);
+    void check_cancel() const;
+    // Fills `shared` in bands, mapping its progress onto [from, to].
+    template <typename Fill>
+    void build_preview(SharedPreview& shared, PreviewImage& image, Fill fill, float from, float to);
+
+    std::thread thread_;
+    mutable std::mutex mutex_;
+    std::condition_variable wake_;
+    bool stop_ = false;
+    bool has_job_ = false;
+    bool has_result_ = false;
+    GuiJob job_;
+    GuiJobResult result_;
+    std::string stage_;
+    std::atomic<float> progress_{0};
+    std::atomic<bool> busy_{false};
+    std::atomic<bool> cancel_{false};
+    SharedPreview cover_;
+    SharedPreview lsb_;
+};
@@ -4,7 +4,7 @@
 #include <stdexcept>
 
 // Helper: encode a single 4-bit nibble to 7 bits
-static uint8_t hamming74_encode_nibble(uint8_t nibble) {
+uint8_t hamming74_encode_nibble(uint8_t nibble) {
     // Data bits: d3 d2 d1 d0 (high to low)
     uint8_t d0 = (nibble >> 0) & 1;
     uint8_t d1 = (nibble >> 1) & 1;
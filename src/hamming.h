@@ -6,6 +6,9 @@
 // Encodes 4-bit nibbles into 7-bit Hamming codewords
 std::vector<uint8_t> hamming74_encode(const std::vector<uint8_t>& data);
 
+// Encodes a single 4-bit nibble into a 7-bit codeword
+uint8_t hamming74_encode_nibble(uint8_t nibble);
+
 // Decodes 7-bit Hamming codewords into 4-bit nibbles, corrects single-bit errors
 std::vector<uint8_t> hamming74_decode(const std::vector<uint8_t>& codewords, bool& had_error);
 
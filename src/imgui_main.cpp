@@ -1,6 +1,7 @@
 // imgui_main.cpp
 // Minimal ImGui GUI for Thousand Flicks
 #include "imgui.h"
+#include "imgui_stdlib.h"
 #include "imgui_impl_sdl.h"
 #include "imgui_impl_opengl3.h"
 #include <SDL.h>
@@ -8,35 +9,64 @@
 #include <stdio.h>
 #include <string>
 #include <vector>
-#include <fstream>
-#include "bmp.h"
-#include "lsb.h"
+#include "gui_worker.h"
 
 static std::string status;
 static std::string message;
-static std::string input_path, output_path;
+static std::string input_path, output_path, passphrase;
 
-void encode_image() {
-    try {
-        BMPImage img = load_bmp(input_path);
-        std::vector<uint8_t> msg(message.begin(), message.end());
-        lsb_encode(img, msg);
-        write_bmp(output_path, img);
-        status = "[OK] Encoded and saved: " + output_path;
-    } catch (const std::exception& e) {
-        status = std::string("[ERR] ") + e.what();
+// Texture fed incrementally from a SharedPreview; only new rows are uploaded
+// each frame so large covers never stall the render loop.
+struct PreviewTexture {
+    GLuint id = 0;
+    int width = 0;
+    int height = 0;
+    SharedPreview::Cursor cursor;
+
+    void update(SharedPreview& preview) {
+        preview.consume(cursor, [this](int w, int h, const uint8_t* rgba, int row_begin, int row_end, bool resized) {
+            if (!id) glGenTextures(1, &id);
+            glBindTexture(GL_TEXTURE_2D, id);
+            if (resized) {
+                width = w;
+                height = h;
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+                glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+                glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+            }
+            if (row_end > row_begin) {
+                glTexSubImage2D(GL_TEXTURE_2D, 0, 0, row_begin, w, row_end - row_begin, GL_RGBA, GL_UNSIGNED_BYTE,
+                                rgba + (size_t)row_begin * w * 4);
+            }
+        });
     }
-}
 
-void decode_image() {
-    try {
-        BMPImage img = load_bmp(input_path);
-        auto msg = lsb_decode(img, 8192);
-        message = std::string(msg.begin(), msg.end());
-        status = "[OK] Decoded message.";
-    } catch (const std::exception& e) {
-        status = std::string("[ERR] ") + e.what();
+    void draw(const char* label) const {
+        ImGui::BeginGroup();
+        ImGui::TextUnformatted(label);
+        if (id) {
+            float scale = 256.0f / (width > height ? width : height);
+            ImGui::Image((ImTextureID)(intptr_t)id, ImVec2(width * scale, height * scale));
+        } else {
+            ImGui::Dummy(ImVec2(256, 256));
+        }
+        ImGui::EndGroup();
     }
+
+    ~PreviewTexture() {
+        if (id) glDeleteTextures(1, &id);
+    }
+};
+
+static void submit(GuiWorker& worker, GuiJob::Kind kind) {
+    GuiJob job;
+    job.kind = kind;
+    job.input_path = input_path;
+    job.output_path = output_path;
+    job.passphrase = passphrase;
+    if (kind == GuiJob::Kind::Encode) job.message = message;
+    if (!worker.submit(std::move(job))) status = "[BUSY] A job is already running";
 }
 
 int main(int, char**) {
@@ -44,7 +74,7 @@ int main(int, char**) {
         printf("Error: %s\n", SDL_GetError());
         return -1;
     }
-    SDL_Window* window = SDL_CreateWindow("Thousand Flicks (ImGui)", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, 600, 400, SDL_WINDOW_OPENGL|SDL_WINDOW_RESIZABLE);
+    SDL_Window* window = SDL_CreateWindow("Thousand Flicks (ImGui)", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, 800, 640, SDL_WINDOW_OPENGL|SDL_WINDOW_RESIZABLE);
     SDL_GLContext gl_context = SDL_GL_CreateContext(window);
     SDL_GL_MakeCurrent(window, gl_context);
     SDL_GL_SetSwapInterval(1);
@@ -54,31 +84,58 @@ int main(int, char**) {
     ImGui::StyleColorsDark();
     ImGui_ImplSDL2_InitForOpenGL(window, gl_context);
     ImGui_ImplOpenGL3_Init("#version 150");
-    bool show = true;
-    while (show) {
-        SDL_Event event;
-        while (SDL_PollEvent(&event)) {
-            ImGui_ImplSDL2_ProcessEvent(&event);
-            if (event.type == SDL_QUIT) show = false;
+    {
+        GuiWorker worker;
+        PreviewTexture cover_tex, lsb_tex;
+        bool show = true;
+        while (show) {
+            SDL_Event event;
+            while (SDL_PollEvent(&event)) {
+                ImGui_ImplSDL2_ProcessEvent(&event);
+                if (event.type == SDL_QUIT) show = false;
+            }
+            GuiJobResult result;
+            if (worker.take_result(result)) {
+                status = result.status;
+                if (result.ok && !result.message.empty()) message = result.message;
+            }
+            cover_tex.update(worker.cover_preview());
+            lsb_tex.update(worker.lsb_preview());
+
+            ImGui_ImplOpenGL3_NewFrame();
+            ImGui_ImplSDL2_NewFrame(window);
+            ImGui::NewFrame();
+            ImGui::Begin("Thousand Flicks");
+            ImGui::InputText("Input BMP", &input_path);
+            ImGui::InputText("Output BMP", &output_path);
+            ImGui::InputText("Passphrase", &passphrase, ImGuiInputTextFlags_Password);
+            ImGui::InputTextMultiline("Message", &message);
+            bool busy = worker.busy();
+            if (busy) ImGui::BeginDisabled();
+            if (ImGui::Button("Encode")) submit(worker, GuiJob::Kind::Encode);
+            ImGui::SameLine();
+            if (ImGui::Button("Decode")) submit(worker, GuiJob::Kind::Decode);
+            if (busy) ImGui::EndDisabled();
+            if (busy) {
+                ImGui::SameLine();
+                if (ImGui::Button("Cancel")) worker.cancel();
+                std::string stage;
+                float fraction = worker.progress(stage);
+                ImGui::ProgressBar(fraction, ImVec2(-1, 0), stage.c_str());
+            }
+            ImGui::TextWrapped("%s", status.c_str());
+            cover_tex.draw("Cover");
+            ImGui::SameLine();
+            lsb_tex.draw("LSB plane / changes (amplified)");
+            ImGui::End();
+            ImGui::Render();
+            glViewport(0, 0, (int)io.DisplaySize.x, (int)io.DisplaySize.y);
+            glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT);
+            ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+            SDL_GL_SwapWindow(window);
         }
-        ImGui_ImplOpenGL3_NewFrame();
-        ImGui_ImplSDL2_NewFrame(window);
-        ImGui::NewFrame();
-        ImGui::Begin("Thousand Flicks");
-        ImGui::InputText("Input BMP", &input_path);
-        ImGui::InputText("Output BMP", &output_path);
-        ImGui::InputTextMultiline("Message", &message);
-        if (ImGui::Button("Encode")) encode_image();
-        ImGui::SameLine();
-        if (ImGui::Button("Decode")) decode_image();
-        ImGui::TextWrapped("%s", status.c_str());
-        ImGui::End();
-        ImGui::Render();
-        glViewport(0, 0, (int)io.DisplaySize.x, (int)io.DisplaySize.y);
-        glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT);
-        ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
-        SDL_GL_SwapWindow(window);
+        // The worker joins and the textures are released while the GL context is alive
     }
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplSDL2_Shutdown();
@@ -0,0 +1,509 @@
+// jpeg.cpp
+// Baseline JPEG covers: entropy-coded DCT coefficients as carriers, no pixel decode
+#include "jpeg.h"
+#include "prng_permute.h"
+#include "stream_io.h"
+#include <algorithm>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+namespace {
+
+constexpr int kLookaheadBits = 9;
+
+uint16_t get16(const uint8_t* p) { return (uint16_t)((p[0] << 8) | p[1]); }
+
+[[noreturn]] void corrupt(const char* what) {
+    throw std::runtime_error(std::string("Corrupt JPEG: ") + what);
+}
+
+// Table-driven decoding: codes of up to kLookaheadBits (nearly all symbols
+// in practice) resolve with one lookup on the next bits; longer codes fall
+// back to the per-length maxcode walk of ITU T.81 F.2.2.3.
+struct HuffmanDecoder {
+    uint16_t lookup[1 << kLookaheadBits] = {}; // (length << 8) | symbol, 0 = longer code
+    int32_t maxcode[17];                       // largest code of each length, -1 if none
+    int32_t valoffset[17];                     // symbol index minus code, per length
+    std::vector<uint8_t> symbols;
+
+    explicit HuffmanDecoder(const JpegHuffmanSpec& spec) : symbols(spec.symbols) {
+        int32_t code = 0;
+        size_t k = 0;
+        for (int len = 1; len <= 16; ++len) {
+            valoffset[len] = (int32_t)k - code;
+            if (code + spec.counts[len - 1] > (1 << len)) corrupt("bad Huffman table");
+            for (int i = 0; i < spec.counts[len - 1]; ++i, ++k, ++code) {
+                if (len > kLookaheadBits) continue;
+                int shift = kLookaheadBits - len;
+                for (int j = 0; j < (1 << shift); ++j)
+                    lookup[(code << shift) | j] = (uint16_t)((len << 8) | symbols[k]);
+            }
+            maxcode[len] = spec.counts[len - 1] ? code - 1 : -1;
+            code <<= 1;
+        }
+    }
+};
+
+struct HuffmanEncoder {
+    uint16_t code[256] = {};
+    uint8_t size[256] = {}; // 0 = symbol not in the table
+
+    explicit HuffmanEncoder(const JpegHuffmanSpec& spec) {
+        uint16_t next = 0;
+        size_t k = 0;
+        for (int len = 1; len <= 16; ++len, next <<= 1) {
+            for (int i = 0; i < spec.counts[len - 1]; ++i, ++k, ++next) {
+                code[spec.symbols[k]] = next;
+                size[spec.symbols[k]] = (uint8_t)len;
+            }
+        }
+    }
+};
+
+// MSB-first reader over entropy-coded data. 0xFF00 stuffing is removed as
+// bytes enter the 64-bit accumulator; at a marker (or the end of the file)
+// zeros are fed instead, as libjpeg does.
+class BitReader {
+public:
+    BitReader(const uint8_t* data, size_t pos, size_t end) : data_(data), pos_(pos), end_(end) {}
+
+    int decode(const HuffmanDecoder& table) {
+        if (count_ < 16) fill();
+        uint32_t peek = (uint32_t)(acc_ >> (count_ - kLookaheadBits)) & ((1u << kLookaheadBits) - 1);
+        if (uint16_t entry = table.lookup[peek]) {
+            count_ -= entry >> 8;
+            return entry & 0xFF;
+        }
+        int32_t code = (int32_t)(acc_ >> (count_ - 16)) & 0xFFFF;
+        for (int len = kLookaheadBits + 1; len <= 16; ++len) {
+            int32_t prefix = code >> (16 - len);
+            if (prefix <= table.maxcode[len]) {
+                count_ -= len;
+                return table.symbols[prefix + table.valoffset[len]];
+            }
+        }
+        corrupt("invalid Huffman code");
+    }
+
+    // Reads `s` magnitude bits and sign-extends them (T.81 F.2.2.1 EXTEND).
+    int receive_extend(int s) {
+        if (!s) return 0;
+        if (count_ < s) fill();
+        int v = (int)(acc_ >> (count_ - s)) & ((1 << s) - 1);
+        count_ -= s;
+        return v < (1 << (s - 1)) ? v - (1 << s) + 1 : v;
+    }
+
+    // Drops the byte padding and steps over marker RSTn.
+    void restart(unsigned n) {
+        acc_ = 0;
+        count_ = 0;
+        at_marker_ = false;
+        pos_ = next_marker();
+        while (pos_ + 1 < end_ && data_[pos_ + 1] == 0xFF) ++pos_;
+        if (pos_ + 1 >= end_ || data_[pos_ + 1] != 0xD0 + (n & 7)) corrupt("missing restart marker");
+        pos_ += 2;
+    }
+
+    // The marker ending the scan, skipping bytes the decoder did not need.
+    size_t next_marker() const {
+        size_t p = pos_;
+        while (p + 1 < end_ && !(data_[p] == 0xFF && data_[p + 1] != 0)) ++p;
+        return std::min(p, end_);
+    }
+
+private:
+    void fill() {
+        while (count_ <= 56) {
+            uint8_t byte = 0;
+            if (!at_marker_ && pos_ < end_) {
+                byte = data_[pos_];
+                if (byte != 0xFF) {
+                    ++pos_;
+                } else if (pos_ + 1 < end_ && data_[pos_ + 1] == 0) {
+                    pos_ += 2;
+                } else {
+                    at_marker_ = true;
+                    byte = 0;
+                }
+            }
+            acc_ = (acc_ << 8) | byte;
+            count_ += 8;
+        }
+    }
+
+    const uint8_t* data_;
+    size_t pos_, end_;
+    uint64_t acc_ = 0;
+    int count_ = 0;
+    bool at_marker_ = false;
+};
+
+class BitWriter {
+public:
+    explicit BitWriter(std::vector<uint8_t>& out) : out_(out) {}
+
+    void put(uint32_t bits, int n) {
+        acc_ = (acc_ << n) | (bits & ((1u << n) - 1));
+        count_ += n;
+        if (count_ < 32) return;
+        // Four bytes at a time; only a word holding 0xFF needs stuffing
+        uint32_t word = (uint32_t)(acc_ >> (count_ - 32));
+        count_ -= 32;
+        if (((~word - 0x01010101u) & word & 0x80808080u) == 0) {
+            uint8_t bytes[4] = {(uint8_t)(word >> 24), (uint8_t)(word >> 16), (uint8_t)(word >> 8), (uint8_t)word};
+            out_.insert(out_.end(), bytes, bytes + 4);
+        } else {
+            for (int shift = 24; shift >= 0; shift -= 8) emit((uint8_t)(word >> shift));
+        }
+    }
+
+    // Pads the last byte with one bits, as T.81 requires before a marker.
+    void flush() {
+        if (int pad = (8 - count_ % 8) % 8) {
+            acc_ = (acc_ << pad) | ((1u << pad) - 1);
+            count_ += pad;
+        }
+        for (; count_; count_ -= 8) emit((uint8_t)(acc_ >> (count_ - 8)));
+    }
+
+private:
+    void emit(uint8_t byte) {
+        out_.push_back(byte);
+        if (byte == 0xFF) out_.push_back(0);
+    }
+
+    std::vector<uint8_t>& out_;
+    uint64_t acc_ = 0;
+    int count_ = 0;
+};
+
+int category(int v) {
+    unsigned m = (unsigned)std::abs(v);
+    return m ? 32 - __builtin_clz(m) : 0;
+}
+
+void encode_symbol(BitWriter& writer, const HuffmanEncoder& table, int symbol, int value, int s) {
+    if (!table.size[symbol]) throw std::runtime_error("JPEG Huffman table has no code for a needed symbol");
+    // Code and magnitude bits go out together (at most 16 + 15 bits)
+    uint32_t extra = (uint32_t)(value < 0 ? value - 1 : value) & ((1u << s) - 1);
+    writer.put(((uint32_t)table.code[symbol] << s) | extra, table.size[symbol] + s);
+}
+
+int max_sampling(const JpegImage& image, bool vertical) {
+    int m = 1;
+    for (const JpegComponent& c : image.components) m = std::max<int>(m, vertical ? c.v : c.h);
+    return m;
+}
+
+// Visits the blocks of a scan in coding order. `block(k, c, index)` gets the
+// scan component, image component and block index; `restart(n)` runs before
+// the MCU following the n-th restart interval.
+template <typename BlockFn, typename RestartFn>
+void for_each_block(const JpegImage& image, const JpegScan& scan, BlockFn block, RestartFn restart) {
+    const int hmax = max_sampling(image, false), vmax = max_sampling(image, true);
+    size_t mcus_wide, mcus_high;
+    if (scan.components.size() == 1) {
+        // A non-interleaved scan codes only the blocks covering the
+        // component itself, one block per MCU
+        const JpegComponent& c = image.components[scan.components[0]];
+        size_t width = ((size_t)image.width * c.h + hmax - 1) / hmax;
+        size_t height = ((size_t)image.height * c.v + vmax - 1) / vmax;
+        mcus_wide = (width + 7) / 8;
+        mcus_high = (height + 7) / 8;
+    } else {
+        mcus_wide = ((size_t)image.width + 8 * hmax - 1) / (8 * hmax);
+        mcus_high = ((size_t)image.height + 8 * vmax - 1) / (8 * vmax);
+    }
+
+    size_t mcu = 0;
+    unsigned restarts = 0;
+    for (size_t my = 0; my < mcus_high; ++my) {
+        for (size_t mx = 0; mx < mcus_wide; ++mx, ++mcu) {
+            if (scan.restart_interval && mcu && mcu % scan.restart_interval == 0) restart(restarts++);
+            if (scan.components.size() == 1) {
+                const JpegComponent& c = image.components[scan.components[0]];
+                block(0, scan.components[0], my * c.blocks_wide + mx);
+                continue;
+            }
+            for (size_t k = 0; k < scan.components.size(); ++k) {
+                const JpegComponent& c = image.components[scan.components[k]];
+                for (size_t y = 0; y < c.v; ++y)
+                    for (size_t x = 0; x < c.h; ++x)
+                        block(k, scan.components[k], (my * c.v + y) * c.blocks_wide + mx * c.h + x);
+            }
+        }
+    }
+}
+
+void decode_scan(JpegImage& image, JpegScan& scan) {
+    std::vector<HuffmanDecoder> dc, ac;
+    for (size_t k = 0; k < scan.components.size(); ++k) {
+        dc.emplace_back(scan.dc_tables[k]);
+        ac.emplace_back(scan.ac_tables[k]);
+    }
+    BitReader reader(image.bytes.data(), scan.data_begin, image.bytes.size());
+    int pred[4] = {};
+    for_each_block(
+        image, scan,
+        [&](size_t k, size_t c, size_t index) {
+            int16_t* coef = &image.components[c].coefficients[index * 64];
+            int s = reader.decode(dc[k]);
+            if (s > 15) corrupt("bad DC magnitude");
+            pred[k] += reader.receive_extend(s);
+            coef[0] = (int16_t)pred[k];
+            for (int i = 1; i < 64;) {
+                int rs = reader.decode(ac[k]);
+                int r = rs >> 4;
+                s = rs & 15;
+                if (!s) {
+                    if (r != 15) break; // EOB
+                    i += 16;            // ZRL
+                    continue;
+                }
+                i += r;
+                if (i > 63) corrupt("coefficient index out of range");
+                coef[i++] = (int16_t)reader.receive_extend(s);
+            }
+        },
+        [&](unsigned n) {
+            reader.restart(n);
+            std::fill(pred, pred + 4, 0);
+        });
+    scan.data_end = reader.next_marker();
+}
+
+void encode_scan(const JpegImage& image, const JpegScan& scan, std::vector<uint8_t>& out) {
+    std::vector<HuffmanEncoder> dc, ac;
+    for (size_t k = 0; k < scan.components.size(); ++k) {
+        dc.emplace_back(scan.dc_tables[k]);
+        ac.emplace_back(scan.ac_tables[k]);
+    }
+    BitWriter writer(out);
+    int pred[4] = {};
+    for_each_block(
+        image, scan,
+        [&](size_t k, size_t c, size_t index) {
+            const int16_t* coef = &image.components[c].coefficients[index * 64];
+            int diff = coef[0] - pred[k];
+            pred[k] = coef[0];
+            int s = category(diff);
+            encode_symbol(writer, dc[k], s, diff, s);
+            // Most AC terms are zero: walk a bitmap of the others instead
+            uint64_t nonzero = 0;
+            for (int i = 1; i < 64; ++i) nonzero |= (uint64_t)(coef[i] != 0) << i;
+            int last = 0;
+            for (; nonzero; nonzero &= nonzero - 1) {
+                int i = __builtin_ctzll(nonzero);
+                int run = i - last - 1;
+                for (; run > 15; run -= 16) encode_symbol(writer, ac[k], 0xF0, 0, 0);
+                s = category(coef[i]);
+                encode_symbol(writer, ac[k], (run << 4) | s, coef[i], s);
+                last = i;
+            }
+            if (last != 63) encode_symbol(writer, ac[k], 0x00, 0, 0);
+        },
+        [&](unsigned n) {
+            writer.flush();
+            out.push_back(0xFF);
+            out.push_back((uint8_t)(0xD0 + (n & 7)));
+            std::fill(pred, pred + 4, 0);
+        });
+    writer.flush();
+}
+
+void parse_frame(JpegImage& image, const uint8_t* seg, size_t len) {
+    if (!image.components.empty()) corrupt("more than one frame");
+    if (len < 6) corrupt("short SOF segment");
+    if (seg[0] != 8) throw std::runtime_error("Only 8-bit JPEGs are supported");
+    image.height = get16(seg + 1);
+    image.width = get16(seg + 3);
+    size_t nf = seg[5];
+    if (!image.height) throw std::runtime_error("JPEGs with a DNL height are not supported");
+    if (!image.width || nf < 1 || nf > 4 || len < 6 + 3 * nf) corrupt("bad SOF segment");
+    for (size_t i = 0; i < nf; ++i) {
+        JpegComponent c;
+        c.id = seg[6 + 3 * i];
+        c.h = seg[7 + 3 * i] >> 4;
+        c.v = seg[7 + 3 * i] & 15;
+        if (c.h < 1 || c.h > 4 || c.v < 1 || c.v > 4) corrupt("bad sampling factors");
+        image.components.push_back(c);
+    }
+    // Interleaved scans code whole MCUs, so every grid is padded to them
+    const int hmax = max_sampling(image, false), vmax = max_sampling(image, true);
+    size_t mcus_wide = ((size_t)image.width + 8 * hmax - 1) / (8 * hmax);
+    size_t mcus_high = ((size_t)image.height + 8 * vmax - 1) / (8 * vmax);
+    for (JpegComponent& c : image.components) {
+        c.blocks_wide = mcus_wide * c.h;
+        c.blocks_high = mcus_high * c.v;
+        c.coefficients.assign(c.blocks_wide * c.blocks_high * 64, 0);
+    }
+}
+
+void parse_tables(const uint8_t* seg, size_t len, JpegHuffmanSpec dc[4], JpegHuffmanSpec ac[4]) {
+    for (size_t p = 0; p < len;) {
+        if (p + 17 > len) corrupt("short DHT segment");
+        int tc = seg[p] >> 4, th = seg[p] & 15;
+        if (tc > 1 || th > 3) corrupt("bad DHT table id");
+        JpegHuffmanSpec& spec = tc ? ac[th] : dc[th];
+        size_t total = 0;
+        for (int i = 0; i < 16; ++i) total += spec.counts[i] = seg[p + 1 + i];
+        if (total > 256 || p + 17 + total > len) corrupt("bad DHT segment");
+        spec.symbols.assign(seg + p + 17, seg + p + 17 + total);
+        p += 17 + total;
+    }
+}
+
+JpegScan parse_scan(const JpegImage& image, const uint8_t* seg, size_t len, const JpegHuffmanSpec dc[4],
+                    const JpegHuffmanSpec ac[4]) {
+    if (image.components.empty()) corrupt("scan before frame");
+    size_t ns = len ? seg[0] : 0;
+    if (ns < 1 || ns > 4 || len < 4 + 2 * ns) corrupt("bad SOS segment");
+    JpegScan scan;
+    for (size_t i = 0; i < ns; ++i) {
+        uint8_t id = seg[1 + 2 * i];
+        auto it = std::find_if(image.components.begin(), image.components.end(),
+                               [id](const JpegComponent& c) { return c.id == id; });
+        if (it == image.components.end()) corrupt("scan names an unknown component");
+        int td = seg[2 + 2 * i] >> 4, ta = seg[2 + 2 * i] & 15;
+        if (td > 3 || ta > 3 || dc[td].symbols.empty() || ac[ta].symbols.empty()) corrupt("missing Huffman table");
+        scan.components.push_back((size_t)(it - image.components.begin()));
+        scan.dc_tables.push_back(dc[td]);
+        scan.ac_tables.push_back(ac[ta]);
+    }
+    const uint8_t* tail = seg + 1 + 2 * ns;
+    if (tail[0] != 0 || tail[1] != 63 || tail[2] != 0)
+        throw std::runtime_error("Only sequential JPEG scans are supported");
+    return scan;
+}
+
+// Visits the carriers in a fixed order: components, blocks, zigzag position
+template <typename Image, typename Fn>
+void for_each_carrier(Image& image, Fn fn) {
+    for (auto& c : image.components)
+        for (size_t i = 0; i < c.coefficients.size(); ++i)
+            if (i % 64 && std::abs(c.coefficients[i]) >= 2) fn(c.coefficients[i]);
+}
+
+// Magnitude LSBs of the carriers, in keyed order when `perm` is non-empty
+std::vector<uint8_t> carrier_bits(const JpegImage& image, const Permutation& perm) {
+    std::vector<uint8_t> bits;
+    for_each_carrier(image, [&](int16_t v) { bits.push_back((uint8_t)(std::abs(v) & 1)); });
+    return perm.empty() ? bits : apply_permutation(bits, perm);
+}
+
+} // namespace
+
+bool is_jpeg(const uint8_t* bytes, size_t size) {
+    return size >= 3 && bytes[0] == 0xFF && bytes[1] == 0xD8 && bytes[2] == 0xFF;
+}
+
+bool is_jpeg_file(const std::string& path) {
+    // Sniffing a pipe would eat the bytes the real reader needs
+    std::error_code error;
+    if (is_std_stream(path) || !std::filesystem::is_regular_file(path, error)) return false;
+    std::ifstream file(path, std::ios::binary);
+    uint8_t magic[3] = {};
+    file.read(reinterpret_cast<char*>(magic), 3);
+    return file.gcount() == 3 && is_jpeg(magic, 3);
+}
+
+JpegImage jpeg_parse(std::vector<uint8_t> bytes) {
+    JpegImage image;
+    image.bytes = std::move(bytes);
+    const uint8_t* b = image.bytes.data();
+    const size_t n = image.bytes.size();
+    if (!is_jpeg(b, n)) throw std::runtime_error("Not a JPEG file");
+
+    JpegHuffmanSpec dc[4], ac[4];
+    unsigned restart_interval = 0;
+    for (size_t pos = 2; pos < n;) {
+        if (b[pos] != 0xFF) corrupt("expected a marker");
+        while (pos < n && b[pos] == 0xFF) ++pos;
+        if (pos >= n) break;
+        uint8_t marker = b[pos++];
+        if (marker == 0xD9) break; // EOI
+        if (marker == 0x01 || (marker >= 0xD0 && marker <= 0xD8)) continue;
+        if (pos + 2 > n || get16(b + pos) < 2 || pos + get16(b + pos) > n) corrupt("truncated segment");
+        const uint8_t* seg = b + pos + 2;
+        size_t len = get16(b + pos) - 2;
+        pos += len + 2;
+
+        if (marker == 0xC0 || marker == 0xC1) {
+            parse_frame(image, seg, len);
+        } else if (marker >= 0xC2 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8) {
+            throw std::runtime_error("Progressive, lossless and arithmetic-coded JPEGs are not supported");
+        } else if (marker == 0xC4) {
+            parse_tables(seg, len, dc, ac);
+        } else if (marker == 0xDD) {
+            if (len < 2) corrupt("short DRI segment");
+            restart_interval = get16(seg);
+        } else if (marker == 0xDA) {
+            JpegScan scan = parse_scan(image, seg, len, dc, ac);
+            scan.data_begin = pos;
+            scan.restart_interval = restart_interval;
+            decode_scan(image, scan);
+            pos = scan.data_end;
+            image.scans.push_back(std::move(scan));
+        }
+    }
+    if (image.scans.empty()) throw std::runtime_error("JPEG has no baseline image data");
+    return image;
+}
+
+std::vector<uint8_t> jpeg_write(const JpegImage& image) {
+    std::vector<uint8_t> out;
+    out.reserve(image.bytes.size() + image.bytes.size() / 64);
+    size_t copied = 0;
+    for (const JpegScan& scan : image.scans) {
+        out.insert(out.end(), image.bytes.begin() + copied, image.bytes.begin() + scan.data_begin);
+        encode_scan(image, scan, out);
+        copied = scan.data_end;
+    }
+    out.insert(out.end(), image.bytes.begin() + copied, image.bytes.end());
+    return out;
+}
+
+size_t jpeg_carriers(const JpegImage& image) {
+    size_t n = 0;
+    for_each_carrier(image, [&](int16_t) { ++n; });
+    return n;
+}
+
+uint64_t jpeg_capacity(const JpegImage& image, const KernelParams& params) {
+    return container_capacity((uint64_t)jpeg_carriers(image), params);
+}
+
+void jpeg_embed(JpegImage& image, const std::vector<uint8_t>& message, const ContainerOptions& options) {
+    if (options.params.bits_per_channel != 1 || options.params.channel_mask != 0x7)
+        throw std::runtime_error("JPEG covers carry 1 bit per coefficient on all channels");
+    if (options.mode != EmbedMode::Replace) throw std::runtime_error("LSB matching is not available for JPEG covers");
+    size_t n = jpeg_carriers(image);
+    uint64_t cap = container_capacity((uint64_t)n, options.params);
+    if (message.size() > cap)
+        throw std::runtime_error("Message too large for JPEG (capacity: " + std::to_string(cap) + " bytes)");
+
+    Permutation perm;
+    if (!options.passphrase.empty()) perm = prng_permutation(n, options.passphrase);
+    std::vector<uint8_t> bits = carrier_bits(image, perm);
+    container_encode_channels(bits.data(), bits.size(), message, options);
+    if (!perm.empty()) bits = invert_permutation(bits, perm);
+    // |c| >= 2 keeps its bit length, so the carrier set and categories stay put
+    size_t i = 0;
+    for_each_carrier(image, [&](int16_t& v) {
+        int16_t magnitude = (int16_t)((std::abs(v) & ~1) | (bits[i++] & 1));
+        v = v < 0 ? (int16_t)-magnitude : magnitude;
+    });
+}
+
+bool jpeg_try_extract(const JpegImage& image, const std::string& passphrase, std::vector<uint8_t>& message,
+                      ContainerDecodeInfo* info) {
+    size_t n = jpeg_carriers(image);
+    if (n < kContainerHeaderChannels) return false;
+    Permutation perm;
+    if (!passphrase.empty()) perm = prng_permutation(n, passphrase);
+    std::vector<uint8_t> bits = carrier_bits(image, perm);
+    return container_try_decode_channels(bits.data(), bits.size(), message, info);
+}
@@ -0,0 +1,69 @@
+// jpeg.h
+// Baseline JPEG covers: entropy-coded DCT coefficients as carriers, no pixel decode
+#pragma once
+#include "container.h"
+#include <string>
+#include <vector>
+
+// Huffman table as stored in a DHT segment: code counts per length 1..16,
+// then the symbols in code order.
+struct JpegHuffmanSpec {
+    uint8_t counts[16] = {};
+    std::vector<uint8_t> symbols;
+};
+
+struct JpegComponent {
+    uint8_t id = 0;
+    uint8_t h = 1, v = 1;        // sampling factors
+    size_t blocks_wide = 0;      // block grid, padded to whole MCUs
+    size_t blocks_high = 0;
+    std::vector<int16_t> coefficients; // 64 per block, zigzag order, row-major blocks
+};
+
+// One sequential scan: where its entropy-coded data sits in the file and the
+// tables it was coded with, so it can be re-encoded bit for bit.
+struct JpegScan {
+    size_t data_begin = 0;       // first byte after the SOS segment
+    size_t data_end = 0;         // the marker that ends the scan
+    std::vector<size_t> components; // indices into JpegImage::components
+    std::vector<JpegHuffmanSpec> dc_tables, ac_tables; // per scan component
+    unsigned restart_interval = 0;  // MCUs per restart interval, 0 = none
+};
+
+struct JpegImage {
+    int width = 0;
+    int height = 0;
+    std::vector<JpegComponent> components;
+    std::vector<JpegScan> scans;
+    std::vector<uint8_t> bytes; // the original file; markers are copied verbatim
+};
+
+// True when the bytes start with a JPEG SOI marker. The file variant only
+// sniffs regular files, so stdin and pipes are left unread.
+bool is_jpeg(const uint8_t* bytes, size_t size);
+bool is_jpeg_file(const std::string& path);
+
+// Entropy-decodes a baseline (SOF0/SOF1, 8-bit, Huffman) JPEG down to its
+// quantized coefficients. Progressive, lossless and arithmetic-coded files
+// throw std::runtime_error, as do corrupt ones.
+JpegImage jpeg_parse(std::vector<uint8_t> bytes);
+
+// Re-encodes the coefficients with each scan's own Huffman tables and
+// restart markers, and splices the result between the original segments.
+std::vector<uint8_t> jpeg_write(const JpegImage& image);
+
+// Carriers are the AC coefficients with magnitude 2 or more; the low bit of
+// the magnitude holds one bit and the sign is kept. Zeros, ±1 and DC terms
+// are never touched, so the set of carriers, every Huffman symbol and every
+// code length survive embedding and the file size barely moves (only 0xFF
+// byte stuffing can differ).
+size_t jpeg_carriers(const JpegImage& image);
+uint64_t jpeg_capacity(const JpegImage& image, const KernelParams& params);
+
+// Container over the carriers, visited in keyed order when a passphrase is
+// set. Only 1 bit per channel without LSB matching fits the carriers: the
+// kernel must read a single bit, and a ±1 step could turn 2 into 1 and drop
+// a carrier. Throws std::runtime_error otherwise or on overflow.
+void jpeg_embed(JpegImage& image, const std::vector<uint8_t>& message, const ContainerOptions& options);
+bool jpeg_try_extract(const JpegImage& image, const std::string& passphrase, std::vector<uint8_t>& message,
+                      ContainerDecodeInfo* info = nullptr);
@@ -0,0 +1,182 @@
+// kernels.cpp
+// Compile-time specialized LSB embed/extract kernels and a runtime dispatcher
+#include "kernels.h"
+#include "hamming.h"
+#include <stdexcept>
+
+namespace kernels {
+
+const std::array<uint8_t, 16>& hamming_encode_table() {
+    static const std::array<uint8_t, 16> table = [] {
+        std::array<uint8_t, 16> t{};
+        for (int n = 0; n < 16; ++n) t[n] = hamming74_encode_nibble((uint8_t)n);
+        return t;
+    }();
+    return table;
+}
+
+const std::array<uint8_t, 128>& hamming_decode_table() {
+    static const std::array<uint8_t, 128> table = [] {
+        std::array<uint8_t, 128> t{};
+        for (int cw = 0; cw < 128; ++cw) {
+            bool corrected = false;
+            uint8_t nibble = hamming74_decode_codeword((uint8_t)cw, corrected);
+            t[cw] = (uint8_t)(nibble | (corrected ? 0x10 : 0));
+        }
+        return t;
+    }();
+    return table;
+}
+
+} // namespace kernels
+
+namespace {
+
+constexpr int kBitsChoices[] = {1, 2, 4};
+constexpr int kOrders = 2;
+constexpr int kEccs = 2;
+constexpr int kMasks = 7; // masks 1..7
+
+size_t table_index(int bits_idx, int mask, int order, int ecc) {
+    return (((size_t)bits_idx * kMasks + (mask - 1)) * kOrders + order) * kEccs + ecc;
+}
+
+template <size_t I>
+constexpr KernelOps make_ops() {
+    constexpr int ecc = I % kEccs;
+    constexpr int order = (I / kEccs) % kOrders;
+    constexpr int mask = (I / (kEccs * kOrders)) % kMasks + 1;
+    constexpr int bits = kBitsChoices[I / (kEccs * kOrders * kMasks)];
+    using K = kernels::LsbKernel<bits, (uint8_t)mask, (BitOrder)order, (EccType)ecc>;
+    if constexpr (bits == 1) return KernelOps{&K::embed, &K::extract, &K::capacity, &K::span, &K::embed_matching};
+    else return KernelOps{&K::embed, &K::extract, &K::capacity, &K::span, nullptr};
+}
+
+template <size_t... I>
+constexpr std::array<KernelOps, sizeof...(I)> make_table(std::index_sequence<I...>) {
+    return {make_ops<I>()...};
+}
+
+const auto kKernelTable = make_table(std::make_index_sequence<3 * kMasks * kOrders * kEccs>());
+
+int bits_index(int bits) {
+    switch (bits) {
+        case 1: return 0;
+        case 2: return 1;
+        case 4: return 2;
+        default: return -1;
+    }
+}
+
+} // namespace
+
+bool operator==(const KernelParams& a, const KernelParams& b) {
+    return a.bits_per_channel == b.bits_per_channel && a.channel_mask == b.channel_mask &&
+           a.order == b.order && a.ecc == b.ecc;
+}
+
+bool kernel_params_valid(const KernelParams& params) {
+    return bits_index(params.bits_per_channel) >= 0 && params.channel_mask >= 1 && params.channel_mask <= 7 &&
+           (uint8_t)params.order < kOrders && (uint8_t)params.ecc < kEccs;
+}
+
+const KernelOps& select_kernel(const KernelParams& params) {
+    if (!kernel_params_valid(params)) throw std::runtime_error("Unsupported embedding parameters");
+    return kKernelTable[table_index(bits_index(params.bits_per_channel), params.channel_mask,
+                                    (int)params.order, (int)params.ecc)];
+}
+
+// Per-bit reference: every option is re-checked inside the innermost loop.
+void embed_generic(const KernelParams& params, uint8_t* channels, size_t n_channels,
+                   const uint8_t* payload, size_t bytes) {
+    size_t carrier = 0;  // carrier channel index
+    int bit_in_channel = 0;
+    auto channel_at = [&](size_t c) -> uint8_t& {
+        if (params.channel_mask == 0x7) return channels[c];
+        int per_pixel = kernels::mask_popcount(params.channel_mask);
+        size_t pixel = c / per_pixel;
+        int nth = (int)(c % per_pixel);
+        for (int ch = 0; ch < 3; ++ch) {
+            if (params.channel_mask & (1 << ch)) {
+                if (nth == 0) return channels[pixel * 3 + ch];
+                --nth;
+            }
+        }
+        return channels[0]; // unreachable for valid masks
+    };
+    auto put_bit = [&](int bit) {
+        uint8_t& ch = channel_at(carrier);
+        int pos = params.order == BitOrder::MsbFirst ? params.bits_per_channel - 1 - bit_in_channel : bit_in_channel;
+        ch = (uint8_t)((ch & ~(1 << pos)) | (bit << pos));
+        if (++bit_in_channel == params.bits_per_channel) {
+            bit_in_channel = 0;
+            ++carrier;
+        }
+    };
+    for (size_t i = 0; i < bytes; ++i) {
+        uint32_t unit;
+        int unit_bits;
+        if (params.ecc == EccType::Hamming74) {
+            const auto& enc = kernels::hamming_encode_table();
+            unit = ((uint32_t)enc[payload[i] >> 4] << 7) | enc[payload[i] & 0xF];
+            unit_bits = 14;
+        } else {
+            unit = payload[i];
+            unit_bits = 8;
+        }
+        for (int b = 0; b < unit_bits; ++b) {
+            int bit = params.order == BitOrder::MsbFirst ? (unit >> (unit_bits - 1 - b)) & 1 : (unit >> b) & 1;
+            put_bit(bit);
+        }
+    }
+    while (bit_in_channel != 0) put_bit(0);
+    (void)n_channels;
+}
+
+size_t extract_generic(const KernelParams& params, const uint8_t* channels, size_t n_channels,
+                       uint8_t* payload, size_t bytes) {
+    size_t carrier = 0;
+    int bit_in_channel = 0;
+    size_t corrected = 0;
+    auto channel_at = [&](size_t c) -> uint8_t {
+        if (params.channel_mask == 0x7) return channels[c];
+        int per_pixel = kernels::mask_popcount(params.channel_mask);
+        size_t pixel = c / per_pixel;
+        int nth = (int)(c % per_pixel);
+        for (int ch = 0; ch < 3; ++ch) {
+            if (params.channel_mask & (1 << ch)) {
+                if (nth == 0) return channels[pixel * 3 + ch];
+                --nth;
+            }
+        }
+        return 0;
+    };
+    auto get_bit = [&]() {
+        uint8_t ch = channel_at(carrier);
+        int pos = params.order == BitOrder::MsbFirst ? params.bits_per_channel - 1 - bit_in_channel : bit_in_channel;
+        if (++bit_in_channel == params.bits_per_channel) {
+            bit_in_channel = 0;
+            ++carrier;
+        }
+        return (ch >> pos) & 1;
+    };
+    for (size_t i = 0; i < bytes; ++i) {
+        int unit_bits = params.ecc == EccType::Hamming74 ? 14 : 8;
+        uint32_t unit = 0;
+        for (int b = 0; b < unit_bits; ++b) {
+            uint32_t bit = get_bit();
+            if (params.order == BitOrder::MsbFirst) unit |= bit << (unit_bits - 1 - b);
+            else unit |= bit << b;
+        }
+        if (params.ecc == EccType::Hamming74) {
+            const auto& dec = kernels::hamming_decode_table();
+            uint8_t hi = dec[(unit >> 7) & 0x7F], lo = dec[unit & 0x7F];
+            corrected += (hi >> 4) + (lo >> 4);
+            payload[i] = (uint8_t)(((hi & 0xF) << 4) | (lo & 0xF));
+        } else {
+            payload[i] = (uint8_t)unit;
+        }
+    }
+    (void)n_channels;
+    return corrected;
+}
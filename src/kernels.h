@@ -0,0 +1,414 @@
+// kernels.h
+// Compile-time specialized LSB embed/extract kernels and a runtime dispatcher
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+
+// Order in which payload bits are packed into the carrier.
+enum class BitOrder : uint8_t { MsbFirst = 0, LsbFirst = 1 };
+
+// Error-correcting code applied to each payload byte inside the kernel.
+enum class EccType : uint8_t { None = 0, Hamming74 = 1 };
+
+// How a payload bit reaches a channel whose low bit differs. Replace
+// overwrites the bit, which evens out each 2k/2k+1 value pair and leaves the
+// histogram artifact chi-square steganalysis detects. Match steps the channel
+// by +1 or -1 in a keyed-random direction (inward at 0 and 255) instead.
+// Extraction is the same for both; Match needs 1 bit per channel.
+enum class EmbedMode : uint8_t { Replace = 0, Match = 1 };
+
+// Runtime description of a kernel; every valid combination has a
+// pre-instantiated specialization reachable through select_kernel().
+struct KernelParams {
+    int bits_per_channel = 1;   // 1, 2 or 4 low bits replaced per channel
+    uint8_t channel_mask = 0x7; // bit 0 = B, bit 1 = G, bit 2 = R
+    BitOrder order = BitOrder::MsbFirst;
+    EccType ecc = EccType::None;
+};
+
+bool operator==(const KernelParams& a, const KernelParams& b);
+
+// Returns false for combinations with no instantiated kernel.
+bool kernel_params_valid(const KernelParams& params);
+
+// Kernels walk `channels` bytes starting at a pixel boundary. With the full
+// channel mask every byte is a carrier; otherwise only the masked channels of
+// each whole pixel are. `extract` returns the number of corrected codewords.
+struct KernelOps {
+    void (*embed)(uint8_t* channels, size_t n_channels, const uint8_t* payload, size_t bytes);
+    size_t (*extract)(const uint8_t* channels, size_t n_channels, uint8_t* payload, size_t bytes);
+    size_t (*capacity)(size_t n_channels); // payload bytes that fit
+    size_t (*span)(size_t bytes);          // channels touched by `bytes` payload bytes
+    // EmbedMode::Match with direction signs drawn from `seed`; nullptr unless
+    // the kernel writes 1 bit per channel.
+    void (*embed_matching)(uint8_t* channels, size_t n_channels, const uint8_t* payload, size_t bytes,
+                           uint64_t seed);
+};
+
+// Picks the specialized kernel for `params`. Throws std::runtime_error if invalid.
+const KernelOps& select_kernel(const KernelParams& params);
+
+// Runtime-parameterized reference with the same output as the specialized
+// kernels; it branches per bit and exists for benchmarking and testing.
+void embed_generic(const KernelParams& params, uint8_t* channels, size_t n_channels,
+                   const uint8_t* payload, size_t bytes);
+size_t extract_generic(const KernelParams& params, const uint8_t* channels, size_t n_channels,
+                       uint8_t* payload, size_t bytes);
+
+namespace kernels {
+
+// 7-bit codeword for each nibble, and the decoded nibble (bits 0-3) plus a
+// corrected flag (bit 4) for each 7-bit codeword. Built once from hamming.cpp.
+const std::array<uint8_t, 16>& hamming_encode_table();
+const std::array<uint8_t, 128>& hamming_decode_table();
+
+template <EccType Ecc>
+struct Codec;
+
+template <>
+struct Codec<EccType::None> {
+    static constexpr int unit_bits = 8;
+    static uint32_t encode(uint8_t byte) { return byte; }
+    static uint8_t decode(uint32_t unit, size_t&) { return (uint8_t)unit; }
+};
+
+// Two 7-bit codewords per byte, high nibble first (14 bits per byte)
+template <>
+struct Codec<EccType::Hamming74> {
+    static constexpr int unit_bits = 14;
+    static uint32_t encode(uint8_t byte) {
+        const auto& enc = hamming_encode_table();
+        return ((uint32_t)enc[byte >> 4] << 7) | enc[byte & 0xF];
+    }
+    static uint8_t decode(uint32_t unit, size_t& corrected) {
+        const auto& dec = hamming_decode_table();
+        uint8_t hi = dec[(unit >> 7) & 0x7F], lo = dec[unit & 0x7F];
+        corrected += (hi >> 4) + (lo >> 4);
+        return (uint8_t)(((hi & 0xF) << 4) | (lo & 0xF));
+    }
+};
+
+constexpr uint64_t kByteOnes = 0x0101010101010101ull;
+
+// One LSB-matching step: `sign` 1 steps down, except at 0; 255 always steps
+// down. Comparisons compile to setcc, so there is no data-dependent branch.
+inline uint8_t match_channel(uint8_t ch, uint8_t bit, uint8_t sign) {
+    uint8_t diff = (ch ^ bit) & 1;
+    uint8_t down = diff & ((sign & (ch != 0)) | (ch == 255));
+    return (uint8_t)(ch + diff - 2 * down);
+}
+
+// match_channel on eight channels in one 64-bit word; each byte of `bits`
+// and `signs` is 0 or 1, and only channels with a 1 byte in `lanes` move.
+// No step leaves [0, 255], so no carry or borrow crosses a byte.
+inline uint64_t match_word(uint64_t ch, uint64_t bits, uint64_t signs, uint64_t lanes = kByteOnes) {
+    constexpr uint64_t low7 = 0x7F7F7F7F7F7F7F7Full;
+    auto zero_bytes = [](uint64_t x) { return (~(((x & low7) + low7) | x) >> 7) & kByteOnes; };
+    uint64_t diff = (ch ^ bits) & lanes;
+    uint64_t down = diff & ((signs & ~zero_bytes(ch)) | zero_bytes(~ch));
+    return ch + (diff ^ down) - down;
+}
+
+// Byte b spread to one 0/1 byte per bit, in the order the channels take them
+// (memory order on little-endian hosts).
+template <BitOrder Order>
+constexpr std::array<uint64_t, 256> make_spread_table() {
+    std::array<uint64_t, 256> t{};
+    for (int b = 0; b < 256; ++b)
+        for (int j = 0; j < 8; ++j) {
+            int bit = Order == BitOrder::MsbFirst ? (b >> (7 - j)) & 1 : (b >> j) & 1;
+            t[b] |= (uint64_t)bit << (8 * j);
+        }
+    return t;
+}
+template <BitOrder Order>
+inline constexpr std::array<uint64_t, 256> kSpreadTable = make_spread_table<Order>();
+
+// Bit j set for each 1 byte j of a word of 0/1 bytes. The multiplier moves
+// byte j to bit 56 + j with no two partial products meeting.
+inline uint8_t lane_bits(uint64_t x) { return (uint8_t)((x * 0x0102040810204080ull) >> 56); }
+
+// Keyed step directions: each splitmix64 draw supplies the signs of 64
+// channels, handed out as 0/1 bytes eight channels at a time.
+class SignStream {
+public:
+    explicit SignStream(uint64_t seed) : state_(seed) {}
+
+    uint64_t next8() {
+        if (lane_ == 8) {
+            uint64_t z = (state_ += 0x9E3779B97F4A7C15ull);
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+            draw_ = z ^ (z >> 31);
+            lane_ = 0;
+        }
+        return (draw_ >> lane_++) & kByteOnes;
+    }
+
+private:
+    uint64_t state_;
+    uint64_t draw_ = 0;
+    int lane_ = 8;
+};
+
+constexpr int mask_popcount(uint8_t mask) { return (mask & 1) + ((mask >> 1) & 1) + ((mask >> 2) & 1); }
+
+// Visits carrier channels in order; for the full mask this is a plain index.
+template <uint8_t Mask>
+struct ChannelCursor {
+    static constexpr int per_pixel = mask_popcount(Mask);
+    static constexpr std::array<uint8_t, 3> offsets = {
+        (uint8_t)((Mask & 1) ? 0 : (Mask & 2) ? 1 : 2),
+        (uint8_t)((Mask & 1) ? ((Mask & 2) ? 1 : 2) : 2),
+        (uint8_t)2};
+
+    size_t pixel = 0;
+    int sub = 0;
+
+    size_t next() {
+        if constexpr (Mask == 0x7) {
+            return pixel++;
+        } else {
+            size_t index = pixel * 3 + offsets[sub];
+            if (++sub == per_pixel) {
+                sub = 0;
+                ++pixel;
+            }
+            return index;
+        }
+    }
+
+    static size_t carriers(size_t n_channels) {
+        if constexpr (Mask == 0x7) return n_channels;
+        else return (n_channels / 3) * per_pixel;
+    }
+
+    // Inverse of carriers(), rounded up to whole pixels for partial masks
+    static size_t channels(size_t n_carriers) {
+        if constexpr (Mask == 0x7) return n_carriers;
+        else return (n_carriers + per_pixel - 1) / per_pixel * 3;
+    }
+};
+
+// Eight pixels (three words) under a partial mask hold 8 * per_pixel
+// carriers. table[k * 256 + v] has a 1 byte in the lane of each carrier
+// 8k + j whose bit of v is set, bit j counted in `Order`, so eight payload
+// bits land on their strided channels in one lookup; `lanes` marks every
+// carrier.
+template <uint8_t Mask, BitOrder Order>
+struct PixelGroup {
+    static constexpr int per_pixel = mask_popcount(Mask);
+    using Words = std::array<uint64_t, 3>;
+
+    static constexpr size_t position(int c) {
+        return (size_t)(c / per_pixel * 3 + ChannelCursor<Mask>::offsets[c % per_pixel]);
+    }
+
+    static constexpr std::array<Words, 256 * per_pixel> make_table() {
+        std::array<Words, 256 * per_pixel> t{};
+        for (int k = 0; k < per_pixel; ++k)
+            for (int v = 0; v < 256; ++v)
+                for (int j = 0; j < 8; ++j)
+                    if ((Order == BitOrder::MsbFirst ? v >> (7 - j) : v >> j) & 1) {
+                        size_t at = position(8 * k + j);
+                        t[k * 256 + v][at / 8] |= 1ull << (8 * (at % 8));
+                    }
+        return t;
+    }
+
+    static constexpr Words make_lanes() {
+        Words lanes{};
+        for (int c = 0; c < 8 * per_pixel; ++c) lanes[position(c) / 8] |= 1ull << (8 * (position(c) % 8));
+        return lanes;
+    }
+
+    static constexpr std::array<Words, 256 * per_pixel> table = make_table();
+    static constexpr Words lanes = make_lanes();
+};
+
+template <int Bits, uint8_t Mask, BitOrder Order, EccType Ecc>
+struct LsbKernel {
+    static_assert(Bits == 1 || Bits == 2 || Bits == 4, "bits per channel must be 1, 2 or 4");
+    static_assert(Mask != 0 && Mask <= 0x7, "channel mask must select at least one of B, G, R");
+    using Code = Codec<Ecc>;
+    static constexpr uint8_t low_mask = (uint8_t)((1u << Bits) - 1);
+
+    static size_t capacity(size_t n_channels) {
+        return ChannelCursor<Mask>::carriers(n_channels) * Bits / Code::unit_bits;
+    }
+
+    static size_t span(size_t bytes) {
+        return ChannelCursor<Mask>::channels((bytes * Code::unit_bits + Bits - 1) / Bits);
+    }
+
+    static void embed(uint8_t* channels, size_t, const uint8_t* payload, size_t bytes) {
+        ChannelCursor<Mask> cursor;
+        uint64_t acc = 0;
+        int count = 0;
+        auto put = [&](uint8_t v) {
+            uint8_t& ch = channels[cursor.next()];
+            ch = (uint8_t)((ch & ~low_mask) | v);
+        };
+        for (size_t i = 0; i < bytes; ++i) {
+            uint32_t unit = Code::encode(payload[i]);
+            if constexpr (Order == BitOrder::MsbFirst) {
+                acc = (acc << Code::unit_bits) | unit;
+                count += Code::unit_bits;
+                while (count >= Bits) {
+                    count -= Bits;
+                    put((uint8_t)((acc >> count) & low_mask));
+                }
+            } else {
+                acc |= (uint64_t)unit << count;
+                count += Code::unit_bits;
+                while (count >= Bits) {
+                    put((uint8_t)(acc & low_mask));
+                    acc >>= Bits;
+                    count -= Bits;
+                }
+            }
+        }
+        // Zero-pad the final partial channel
+        if (count > 0) {
+            if constexpr (Order == BitOrder::MsbFirst) put((uint8_t)((acc << (Bits - count)) & low_mask));
+            else put((uint8_t)(acc & low_mask));
+        }
+    }
+
+    // With the full channel mask each payload-bit byte updates eight
+    // contiguous channels through match_word. Partial masks collect
+    // per_pixel bytes, the carriers of eight pixels, and step those three
+    // words the same way; only a trailing partial group goes per channel.
+    static void embed_matching(uint8_t* channels, size_t, const uint8_t* payload, size_t bytes, uint64_t seed) {
+        static_assert(Bits == 1, "LSB matching writes one bit per channel");
+        ChannelCursor<Mask> cursor;
+        SignStream signs(seed);
+        uint64_t pending = 0;
+        int available = 0;
+        auto put = [&](uint8_t bit) {
+            if (!available) {
+                pending = signs.next8();
+                available = 8;
+            }
+            uint8_t& ch = channels[cursor.next()];
+            ch = match_channel(ch, bit, (uint8_t)(pending & 1));
+            pending >>= 8;
+            --available;
+        };
+        auto put_byte = [&](uint8_t byte) {
+            uint64_t bits = kSpreadTable<Order>[byte];
+            if constexpr (Mask == 0x7) {
+                uint64_t word;
+                uint8_t* at = channels + cursor.pixel;
+                std::memcpy(&word, at, 8);
+                word = match_word(word, bits, signs.next8());
+                std::memcpy(at, &word, 8);
+                cursor.pixel += 8;
+            } else {
+                // A trailing byte short of a whole group: gather the eight
+                // strided carriers into a word and back
+                size_t index[8];
+                uint64_t word = 0;
+                for (int b = 0; b < 8; ++b) {
+                    index[b] = cursor.next();
+                    word |= (uint64_t)channels[index[b]] << (8 * b);
+                }
+                word = match_word(word, bits, signs.next8());
+                for (int b = 0; b < 8; ++b) channels[index[b]] = (uint8_t)(word >> (8 * b));
+            }
+        };
+        using Group = PixelGroup<Mask, Order>;
+        // Sign lanes come in memory order, which is LSB-first bit order
+        using SignGroup = PixelGroup<Mask, BitOrder::LsbFirst>;
+        uint8_t group[2];
+        int held = 0;
+        auto put_group_byte = [&](uint8_t byte) {
+            if constexpr (Mask == 0x7) {
+                put_byte(byte);
+            } else {
+                group[held++] = byte;
+                if (held < Group::per_pixel) return;
+                held = 0;
+                // Signs are drawn per eight carriers in order, as put_byte
+                // does. The three words are spelled out so they stay in
+                // registers.
+                const auto& b = Group::table[group[0]];
+                const auto& s = SignGroup::table[lane_bits(signs.next8())];
+                uint64_t b0 = b[0], b1 = b[1], b2 = b[2], s0 = s[0], s1 = s[1], s2 = s[2];
+                if constexpr (Group::per_pixel == 2) {
+                    const auto& b_hi = Group::table[256 + group[1]];
+                    const auto& s_hi = SignGroup::table[256 + lane_bits(signs.next8())];
+                    b0 |= b_hi[0], b1 |= b_hi[1], b2 |= b_hi[2];
+                    s0 |= s_hi[0], s1 |= s_hi[1], s2 |= s_hi[2];
+                }
+                uint8_t* at = channels + cursor.pixel * 3;
+                auto step = [&](int w, uint64_t bits, uint64_t sign_lanes) {
+                    uint64_t word;
+                    std::memcpy(&word, at + 8 * w, 8);
+                    word = match_word(word, bits, sign_lanes, Group::lanes[w]);
+                    std::memcpy(at + 8 * w, &word, 8);
+                };
+                step(0, b0, s0);
+                step(1, b1, s1);
+                step(2, b2, s2);
+                cursor.pixel += 8;
+            }
+        };
+        uint64_t acc = 0;
+        int count = 0;
+        for (size_t i = 0; i < bytes; ++i) {
+            uint32_t unit = Code::encode(payload[i]);
+            if constexpr (Order == BitOrder::MsbFirst) {
+                acc = (acc << Code::unit_bits) | unit;
+                count += Code::unit_bits;
+                while (count >= 8) {
+                    count -= 8;
+                    put_group_byte((uint8_t)(acc >> count));
+                }
+            } else {
+                acc |= (uint64_t)unit << count;
+                count += Code::unit_bits;
+                while (count >= 8) {
+                    put_group_byte((uint8_t)acc);
+                    acc >>= 8;
+                    count -= 8;
+                }
+            }
+        }
+        for (int k = 0; k < held; ++k) put_byte(group[k]);
+        for (int b = 0; b < count; ++b)
+            put((uint8_t)(Order == BitOrder::MsbFirst ? (acc >> (count - 1 - b)) & 1 : (acc >> b) & 1));
+    }
+
+    static size_t extract(const uint8_t* channels, size_t, uint8_t* payload, size_t bytes) {
+        ChannelCursor<Mask> cursor;
+        uint64_t acc = 0;
+        int count = 0;
+        size_t corrected = 0;
+        constexpr uint64_t unit_mask = (1ull << Code::unit_bits) - 1;
+        for (size_t i = 0; i < bytes; ++i) {
+            while (count < Code::unit_bits) {
+                uint8_t v = channels[cursor.next()] & low_mask;
+                if constexpr (Order == BitOrder::MsbFirst) acc = (acc << Bits) | v;
+                else acc |= (uint64_t)v << count;
+                count += Bits;
+            }
+            uint32_t unit;
+            if constexpr (Order == BitOrder::MsbFirst) {
+                count -= Code::unit_bits;
+                unit = (uint32_t)((acc >> count) & unit_mask);
+            } else {
+                unit = (uint32_t)(acc & unit_mask);
+                acc >>= Code::unit_bits;
+                count -= Code::unit_bits;
+            }
+            payload[i] = Code::decode(unit, corrected);
+        }
+        return corrected;
+    }
+};
+
+} // namespace kernels
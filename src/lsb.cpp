@@ -3,43 +3,55 @@
 #include "lsb.h"
 #include <stdexcept>
 #include <cstring>
+#include <algorithm>
+
+static size_t capacity_of(uint64_t channels) {
+    if (channels < 32) return 0;
+    return (size_t)std::min<uint64_t>((channels - 32) / 8, kLegacyMaxMessage);
+}
 
 size_t lsb_capacity(const BMPImage& img) {
-    if (img.data.size() < 32) return 0;
-    return (img.data.size() - 32) / 8;
+    return capacity_of(img.data.size());
+}
+
+size_t lsb_capacity(const BMPInfo& info) {
+    return capacity_of((uint64_t)info.width * info.height * 3);
 }
 
-void lsb_encode(BMPImage& img, const std::vector<uint8_t>& message) {
+// The legacy layout is the 1-bit, all-channel, MSB-first kernel without ECC
+// (callers apply Hamming themselves): a 4-byte big-endian length, then the message.
+using LegacyKernel = kernels::LsbKernel<1, 0x7, BitOrder::MsbFirst, EccType::None>;
+
+void lsb_encode(BMPImage& img, const std::vector<uint8_t>& message, EmbedMode mode, uint64_t seed) {
     size_t cap = lsb_capacity(img);
+    if (img.data.size() < 32) throw std::runtime_error("Image too small for the 32-bit length header");
+    if (message.size() > kLegacyMaxMessage)
+        throw std::runtime_error("Message exceeds the 4 GiB limit of the legacy layout; use --container");
     if (message.size() > cap)
         throw std::runtime_error("Message too large for image (capacity: " + std::to_string(cap) + " bytes)");
     // Write message length (in bytes) as first 32 bits (big-endian)
-    for (int i = 0; i < 32; ++i) {
-        img.data[i] = (img.data[i] & 0xFE) | ((message.size() >> (31 - i)) & 1);
+    uint32_t len = (uint32_t)message.size();
+    uint8_t header[4] = {(uint8_t)(len >> 24), (uint8_t)(len >> 16), (uint8_t)(len >> 8), (uint8_t)len};
+    if (mode == EmbedMode::Match) {
+        LegacyKernel::embed_matching(img.data.data(), 32, header, 4, seed);
+        LegacyKernel::embed_matching(img.data.data() + 32, img.data.size() - 32, message.data(), message.size(),
+                                     seed + 1);
+        return;
     }
+    LegacyKernel::embed(img.data.data(), 32, header, 4);
     // Write message bits
-    for (size_t i = 0; i < message.size(); ++i) {
-        for (int b = 0; b < 8; ++b) {
-            img.data[32 + i * 8 + b] = (img.data[32 + i * 8 + b] & 0xFE) | ((message[i] >> (7 - b)) & 1);
-        }
-    }
+    LegacyKernel::embed(img.data.data() + 32, img.data.size() - 32, message.data(), message.size());
 }
 
 std::vector<uint8_t> lsb_decode(const BMPImage& img, size_t max_bytes) {
+    if (img.data.size() < 32) throw std::runtime_error("Image too small or corrupted");
     // Read message length (first 32 bits, big-endian)
-    size_t msg_len = 0;
-    for (int i = 0; i < 32; ++i) {
-        msg_len = (msg_len << 1) | (img.data[i] & 1);
-    }
+    uint8_t header[4];
+    LegacyKernel::extract(img.data.data(), 32, header, 4);
+    size_t msg_len = ((size_t)header[0] << 24) | ((size_t)header[1] << 16) | ((size_t)header[2] << 8) | header[3];
     if (msg_len > max_bytes) throw std::runtime_error("Message too large or corrupted");
     if (32 + msg_len * 8 > img.data.size()) throw std::runtime_error("Image too small or corrupted");
     std::vector<uint8_t> message(msg_len);
-    for (size_t i = 0; i < msg_len; ++i) {
-        uint8_t byte = 0;
-        for (int b = 0; b < 8; ++b) {
-            byte = (byte << 1) | (img.data[32 + i * 8 + b] & 1);
-        }
-        message[i] = byte;
-    }
+    LegacyKernel::extract(img.data.data() + 32, img.data.size() - 32, message.data(), msg_len);
     return message;
 }
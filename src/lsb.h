@@ -2,14 +2,33 @@
 // Raw LSB encoding/decoding for BMP
 #pragma once
 #include "bmp.h"
+#include "kernels.h"
 #include <string>
 
+// The legacy layout stores the message length in 32 bits, so every writer of
+// that layout (lsb, update, tiled, sequence) caps payloads here. Larger
+// payloads need the container format.
+constexpr uint64_t kLegacyMaxMessage = 0xFFFFFFFFull;
 
-// Returns the maximum number of bytes that can be encoded in the image using LSB (including 32 bits for length)
+// Returns the maximum number of bytes that can be encoded in the image using LSB (including 32 bits for length),
+// capped at kLegacyMaxMessage
 size_t lsb_capacity(const BMPImage& img);
 
+// Same capacity computed from the header alone, without loading pixel data.
+size_t lsb_capacity(const BMPInfo& info);
+
 // Encodes the message (as bytes) into the image using LSB. Throws on overflow.
-void lsb_encode(BMPImage& img, const std::vector<uint8_t>& message);
+// EmbedMode::Match uses ±1 steps with directions drawn from `seed`.
+void lsb_encode(BMPImage& img, const std::vector<uint8_t>& message, EmbedMode mode = EmbedMode::Replace,
+                uint64_t seed = 0);
+
+// Returns bit i of the stream lsb_encode writes: the 32-bit big-endian length,
+// then the message bits MSB first.
+inline uint8_t lsb_stream_bit(const std::vector<uint8_t>& message, size_t i) {
+    if (i < 32) return (uint8_t)((message.size() >> (31 - i)) & 1);
+    size_t k = i - 32;
+    return (message[k / 8] >> (7 - k % 8)) & 1;
+}
 
 // Decodes a message of up to max_bytes from the image using LSB.
 std::vector<uint8_t> lsb_decode(const BMPImage& img, size_t max_bytes);
@@ -0,0 +1,66 @@
+// mapped_file.cpp
+// RAII wrapper around a memory-mapped file (POSIX mmap)
+#include "mapped_file.h"
+#include <stdexcept>
+#include <utility>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MappedFile::MappedFile(const std::string& filename, Mode mode) {
+    bool writable = mode == Mode::ReadWrite;
+    fd_ = ::open(filename.c_str(), writable ? O_RDWR : O_RDONLY);
+    if (fd_ < 0) throw std::runtime_error("Cannot open file: " + filename);
+
+    struct stat st;
+    if (::fstat(fd_, &st) != 0) {
+        release();
+        throw std::runtime_error("Cannot stat file: " + filename);
+    }
+    size_ = (size_t)st.st_size;
+    if (size_ == 0) return;
+
+    void* p = ::mmap(nullptr, size_, writable ? (PROT_READ | PROT_WRITE) : PROT_READ,
+                     MAP_SHARED, fd_, 0);
+    if (p == MAP_FAILED) {
+        release();
+        throw std::runtime_error("Cannot map file: " + filename);
+    }
+    data_ = static_cast<uint8_t*>(p);
+}
+
+MappedFile::~MappedFile() { release(); }
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+    : fd_(std::exchange(other.fd_, -1)),
+      data_(std::exchange(other.data_, nullptr)),
+      size_(std::exchange(other.size_, 0)) {}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+    if (this != &other) {
+        release();
+        fd_ = std::exchange(other.fd_, -1);
+        data_ = std::exchange(other.data_, nullptr);
+        size_ = std::exchange(other.size_, 0);
+    }
+    return *this;
+}
+
+void MappedFile::sync() {
+    if (data_ && ::msync(data_, size_, MS_SYNC) != 0)
+        throw std::runtime_error("msync failed");
+}
+
+void MappedFile::release() {
+    if (data_) ::munmap(data_, size_);
+    if (fd_ >= 0) ::close(fd_);
+    data_ = nullptr;
+    fd_ = -1;
+    size_ = 0;
+}
+
+size_t system_page_size() {
+    static const size_t page = (size_t)::sysconf(_SC_PAGESIZE);
+    return page;
+}
@@ -0,0 +1,37 @@
+// mapped_file.h
+// RAII wrapper around a memory-mapped file (POSIX mmap)
+#pragma once
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+class MappedFile {
+public:
+    enum class Mode { ReadOnly, ReadWrite };
+
+    // Maps the whole file. Throws std::runtime_error on error.
+    MappedFile(const std::string& filename, Mode mode);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+
+    uint8_t* data() { return data_; }
+    const uint8_t* data() const { return data_; }
+    size_t size() const { return size_; }
+
+    // Flushes dirty pages of a read-write mapping back to the file.
+    void sync();
+
+private:
+    void release();
+
+    int fd_ = -1;
+    uint8_t* data_ = nullptr;
+    size_t size_ = 0;
+};
+
+// Returns the virtual memory page size.
+size_t system_page_size();
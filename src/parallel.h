@@ -0,0 +1,107 @@
+// parallel.h
+// Small threading helpers: bounded MPMC queue and a blocking parallel_for
+#pragma once
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed-capacity queue; push blocks while full, pop blocks while empty.
+// After close(), push is rejected and pop drains the remaining items.
+template <typename T>
+class BoundedQueue {
+public:
+    explicit BoundedQueue(size_t capacity) : capacity_(capacity ? capacity : 1) {}
+
+    bool push(T item) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        not_full_.wait(lock, [&] { return closed_ || items_.size() < capacity_; });
+        if (closed_) return false;
+        items_.push_back(std::move(item));
+        not_empty_.notify_one();
+        return true;
+    }
+
+    // Returns false once the queue is closed and empty.
+    bool pop(T& item) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        not_empty_.wait(lock, [&] { return closed_ || !items_.empty(); });
+        if (items_.empty()) return false;
+        item = std::move(items_.front());
+        items_.pop_front();
+        not_full_.notify_one();
+        return true;
+    }
+
+    void close() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closed_ = true;
+        not_empty_.notify_all();
+        not_full_.notify_all();
+    }
+
+private:
+    size_t capacity_;
+    bool closed_ = false;
+    std::deque<T> items_;
+    std::mutex mutex_;
+    std::condition_variable not_full_, not_empty_;
+};
+
+// Records the first exception raised by any stage of a thread pipeline.
+// fail() must be called from a catch block; it also closes the given
+// queues so blocked producers and consumers wake up and exit.
+class PipelineError {
+public:
+    template <typename... Queues>
+    void fail(Queues&... queues) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!error_) error_ = std::current_exception();
+        }
+        (queues.close(), ...);
+    }
+
+    bool failed() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return error_ != nullptr;
+    }
+
+    void rethrow() {
+        if (error_) std::rethrow_exception(error_);
+    }
+
+private:
+    std::mutex mutex_;
+    std::exception_ptr error_;
+};
+
+// Number of worker threads to use when the caller passes 0.
+inline unsigned default_thread_count() {
+    unsigned n = std::thread::hardware_concurrency();
+    return n ? n : 1;
+}
+
+// Splits [0, n) into contiguous chunks and runs fn(begin, end) on up to
+// `threads` threads (the calling thread takes the first chunk).
+template <typename Fn>
+void parallel_for(size_t n, unsigned threads, Fn&& fn) {
+    if (threads == 0) threads = default_thread_count();
+    size_t chunks = std::min<size_t>(threads, n);
+    if (chunks <= 1) {
+        if (n) fn(size_t(0), n);
+        return;
+    }
+    size_t step = (n + chunks - 1) / chunks;
+    std::vector<std::thread> pool;
+    for (size_t c = 1; c < chunks; ++c) {
+        size_t begin = c * step, end = std::min(n, begin + step);
+        if (begin < end) pool.emplace_back([&fn, begin, end] { fn(begin, end); });
+    }
+    fn(size_t(0), std::min(n, step));
+    for (auto& t : pool) t.join();
+}
@@ -0,0 +1,194 @@
+// planar.cpp
+// Planar (one plane per channel) image layout and views over either layout
+#include "planar.h"
+#include "buffers.h"
+#include "mapped_file.h"
+#include "parallel.h"
+#include "stream_io.h"
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace {
+
+// Rows per parallel_for item; bands this tall keep each thread on
+// neighbouring memory in all four buffers.
+constexpr size_t kBandRows = 16;
+
+#if defined(__SSE2__)
+__m128i load(const uint8_t* p) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)); }
+void store(uint8_t* p, __m128i v) { _mm_storeu_si128(reinterpret_cast<__m128i*>(p), v); }
+
+// Each round interleaves the bytes of one vector's halves with another's,
+// taking every third byte one step closer to its plane; four rounds sort
+// 16 BGR pixels into 16 B, 16 G and 16 R.
+void deinterleave16(const uint8_t* in, uint8_t* b, uint8_t* g, uint8_t* r) {
+    __m128i v0 = load(in), v1 = load(in + 16), v2 = load(in + 32);
+    for (int round = 0; round < 4; ++round) {
+        __m128i t0 = _mm_unpacklo_epi8(v0, _mm_unpackhi_epi64(v1, v1));
+        __m128i t1 = _mm_unpacklo_epi8(_mm_unpackhi_epi64(v0, v0), v2);
+        __m128i t2 = _mm_unpacklo_epi8(v1, _mm_unpackhi_epi64(v2, v2));
+        v0 = t0;
+        v1 = t1;
+        v2 = t2;
+    }
+    store(b, v0);
+    store(g, v1);
+    store(r, v2);
+}
+
+// Inverse of deinterleave16: B/G pairs and R/0 pairs are widened into
+// 4-byte BGR0 pixels, and the zero bytes are squeezed out by shifts.
+void interleave16(const uint8_t* b, const uint8_t* g, const uint8_t* r, uint8_t* out) {
+    const __m128i zero = _mm_setzero_si128();
+    __m128i vb = load(b), vg = load(g), vr = load(r);
+    __m128i bg0 = _mm_unpacklo_epi8(vb, vg), bg1 = _mm_unpackhi_epi8(vb, vg);
+    __m128i r0 = _mm_unpacklo_epi8(vr, zero), r1 = _mm_unpackhi_epi8(vr, zero);
+    __m128i px[4] = {_mm_unpacklo_epi16(bg0, r0), _mm_unpackhi_epi16(bg0, r0), _mm_unpacklo_epi16(bg1, r1),
+                     _mm_unpackhi_epi16(bg1, r1)};  // BGR0 x 4 each
+    // Squeeze each 16-byte BGR0 x 4 vector to its 12 payload bytes
+    const __m128i low3 = _mm_set_epi32(0, 0, 0, 0x00FFFFFF);
+    for (auto& v : px) {
+        __m128i p0 = _mm_and_si128(v, low3);
+        __m128i p1 = _mm_srli_si128(_mm_and_si128(v, _mm_slli_si128(low3, 4)), 1);
+        __m128i p2 = _mm_srli_si128(_mm_and_si128(v, _mm_slli_si128(low3, 8)), 2);
+        __m128i p3 = _mm_srli_si128(_mm_and_si128(v, _mm_slli_si128(low3, 12)), 3);
+        v = _mm_or_si128(_mm_or_si128(p0, p1), _mm_or_si128(p2, p3));
+    }
+    store(out, _mm_or_si128(px[0], _mm_slli_si128(px[1], 12)));
+    store(out + 16, _mm_or_si128(_mm_srli_si128(px[1], 4), _mm_slli_si128(px[2], 8)));
+    store(out + 32, _mm_or_si128(_mm_srli_si128(px[2], 8), _mm_slli_si128(px[3], 4)));
+}
+#endif
+
+} // namespace
+
+PlanarImage::PlanarImage(int width, int height) {
+    if (width < 0 || height < 0) throw std::runtime_error("Invalid planar image size");
+    width_ = width;
+    height_ = height;
+    stride_ = ((size_t)width + kPlaneAlign - 1) / kPlaneAlign * kPlaneAlign;
+    if (!stride_ || !height_) return;
+    raw_bytes_ = 3 * plane_bytes() + kPlaneAlign;
+    raw_ = static_cast<uint8_t*>(large_allocate(raw_bytes_));
+    base_ = raw_ + (kPlaneAlign - (uintptr_t)raw_ % kPlaneAlign) % kPlaneAlign;
+    std::memset(base_, 0, 3 * plane_bytes());
+}
+
+PlanarImage::~PlanarImage() { release(); }
+
+PlanarImage::PlanarImage(const PlanarImage& other) : PlanarImage(other.width_, other.height_) {
+    if (base_) std::memcpy(base_, other.base_, 3 * plane_bytes());
+}
+
+PlanarImage& PlanarImage::operator=(const PlanarImage& other) {
+    if (this != &other) *this = PlanarImage(other);
+    return *this;
+}
+
+PlanarImage::PlanarImage(PlanarImage&& other) noexcept { *this = std::move(other); }
+
+PlanarImage& PlanarImage::operator=(PlanarImage&& other) noexcept {
+    if (this != &other) {
+        release();
+        width_ = std::exchange(other.width_, 0);
+        height_ = std::exchange(other.height_, 0);
+        stride_ = std::exchange(other.stride_, 0);
+        raw_ = std::exchange(other.raw_, nullptr);
+        base_ = std::exchange(other.base_, nullptr);
+        raw_bytes_ = std::exchange(other.raw_bytes_, 0);
+    }
+    return *this;
+}
+
+void PlanarImage::release() {
+    large_free(raw_, raw_bytes_);
+    raw_ = base_ = nullptr;
+    raw_bytes_ = 0;
+}
+
+void deinterleave_row(const uint8_t* bgr, uint8_t* b, uint8_t* g, uint8_t* r, size_t pixels) {
+    size_t x = 0;
+#if defined(__SSE2__)
+    for (; x + 16 <= pixels; x += 16) deinterleave16(bgr + x * 3, b + x, g + x, r + x);
+#elif defined(__ARM_NEON)
+    for (; x + 16 <= pixels; x += 16) {
+        uint8x16x3_t v = vld3q_u8(bgr + x * 3);
+        vst1q_u8(b + x, v.val[0]);
+        vst1q_u8(g + x, v.val[1]);
+        vst1q_u8(r + x, v.val[2]);
+    }
+#endif
+    for (; x < pixels; ++x) {
+        b[x] = bgr[x * 3];
+        g[x] = bgr[x * 3 + 1];
+        r[x] = bgr[x * 3 + 2];
+    }
+}
+
+void interleave_row(const uint8_t* b, const uint8_t* g, const uint8_t* r, uint8_t* bgr, size_t pixels) {
+    size_t x = 0;
+#if defined(__SSE2__)
+    for (; x + 16 <= pixels; x += 16) interleave16(b + x, g + x, r + x, bgr + x * 3);
+#elif defined(__ARM_NEON)
+    for (; x + 16 <= pixels; x += 16) vst3q_u8(bgr + x * 3, uint8x16x3_t{{vld1q_u8(b + x), vld1q_u8(g + x), vld1q_u8(r + x)}});
+#endif
+    for (; x < pixels; ++x) {
+        bgr[x * 3] = b[x];
+        bgr[x * 3 + 1] = g[x];
+        bgr[x * 3 + 2] = r[x];
+    }
+}
+
+PlanarImage to_planar(const BMPImage& img, unsigned threads) {
+    PlanarImage out(img.width, img.height);
+    const size_t row_bytes = (size_t)img.width * 3;
+    parallel_for((img.height + kBandRows - 1) / kBandRows, threads, [&](size_t begin, size_t end) {
+        for (int y = (int)(begin * kBandRows); y < (int)std::min(end * kBandRows, (size_t)img.height); ++y)
+            deinterleave_row(&img.data[y * row_bytes], out.row(0, y), out.row(1, y), out.row(2, y), img.width);
+    });
+    return out;
+}
+
+BMPImage to_interleaved(const PlanarImage& img, unsigned threads) {
+    BMPImage out{img.width(), img.height(), {}};
+    const size_t row_bytes = (size_t)img.width() * 3;
+    resize_large(out.data, row_bytes * img.height());
+    parallel_for((img.height() + kBandRows - 1) / kBandRows, threads, [&](size_t begin, size_t end) {
+        for (int y = (int)(begin * kBandRows); y < (int)std::min(end * kBandRows, (size_t)img.height()); ++y)
+            interleave_row(img.row(0, y), img.row(1, y), img.row(2, y), &out.data[y * row_bytes], img.width());
+    });
+    return out;
+}
+
+PlanarImage load_planar(const std::string& path, unsigned threads) {
+    if (is_std_stream(path) || is_png_file(path)) return to_planar(load_cover(path), threads);
+    BMPInfo info = probe_bmp(path);
+    MappedFile file(path, MappedFile::Mode::ReadOnly);
+    if (file.size() < info.file_size) throw std::runtime_error("Truncated BMP pixel data");
+    PlanarImage out(info.width, info.height);
+    const uint64_t row_bytes = (uint64_t)info.width * 3;
+    parallel_for((info.height + kBandRows - 1) / kBandRows, threads, [&](size_t begin, size_t end) {
+        for (int y = (int)(begin * kBandRows); y < (int)std::min(end * kBandRows, (size_t)info.height); ++y)
+            deinterleave_row(file.data() + bmp_channel_offset(info, y * row_bytes), out.row(0, y), out.row(1, y),
+                             out.row(2, y), info.width);
+    });
+    return out;
+}
+
+void write_planar(const std::string& path, const PlanarImage& img, const PngOptions& png) {
+    write_cover(path, to_interleaved(img), png);
+}
+
+ImageView::ImageView(const BMPImage& img) : width(img.width), height(img.height) {
+    for (int c = 0; c < 3; ++c) channel[c] = {img.data.data() + c, 3, (size_t)img.width * 3};
+}
+
+ImageView::ImageView(const PlanarImage& img) : width(img.width()), height(img.height()) {
+    for (int c = 0; c < 3; ++c) channel[c] = {img.plane(c), 1, img.stride()};
+}
@@ -0,0 +1,86 @@
+// planar.h
+// Planar (one plane per channel) image layout and views over either layout
+#pragma once
+#include "bmp.h"
+#include "png.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Planes and plane rows start on this boundary, so a row can be read with
+// aligned vector loads and the padding past `width` with whole vectors.
+constexpr size_t kPlaneAlign = 64;
+
+// The pixels of a BMPImage as three separate B, G and R planes. Each plane
+// row is `stride` bytes (width rounded up to kPlaneAlign); the padding is
+// zero. Planes of 2 MB or more go through large_allocate().
+class PlanarImage {
+public:
+    PlanarImage() = default;
+    PlanarImage(int width, int height);  // zeroed planes
+    ~PlanarImage();
+    PlanarImage(const PlanarImage& other);
+    PlanarImage& operator=(const PlanarImage& other);
+    PlanarImage(PlanarImage&& other) noexcept;
+    PlanarImage& operator=(PlanarImage&& other) noexcept;
+
+    int width() const { return width_; }
+    int height() const { return height_; }
+    size_t stride() const { return stride_; }
+    bool empty() const { return !base_; }
+
+    // c: 0 = B, 1 = G, 2 = R
+    uint8_t* plane(int c) { return base_ + c * plane_bytes(); }
+    const uint8_t* plane(int c) const { return base_ + c * plane_bytes(); }
+    uint8_t* row(int c, int y) { return plane(c) + (size_t)y * stride_; }
+    const uint8_t* row(int c, int y) const { return plane(c) + (size_t)y * stride_; }
+
+private:
+    size_t plane_bytes() const { return stride_ * (size_t)height_; }
+    void release();
+
+    int width_ = 0;
+    int height_ = 0;
+    size_t stride_ = 0;
+    uint8_t* raw_ = nullptr;   // allocation, possibly unaligned
+    uint8_t* base_ = nullptr;  // first plane, kPlaneAlign-aligned
+    size_t raw_bytes_ = 0;
+};
+
+// Splits `pixels` interleaved BGR pixels into three planes and back. SSE2
+// (or NEON) transposes 16 pixels per step; other targets run scalar loops.
+void deinterleave_row(const uint8_t* bgr, uint8_t* b, uint8_t* g, uint8_t* r, size_t pixels);
+void interleave_row(const uint8_t* b, const uint8_t* g, const uint8_t* r, uint8_t* bgr, size_t pixels);
+
+// Whole-image transposes, parallel across row bands (0 threads = default).
+PlanarImage to_planar(const BMPImage& img, unsigned threads = 0);
+BMPImage to_interleaved(const PlanarImage& img, unsigned threads = 0);
+
+// load_cover() into planes. BMP files are transposed straight from a
+// read-only mapping, skipping the interleaved copy; PNG and "-" decode first.
+PlanarImage load_planar(const std::string& path, unsigned threads = 0);
+// write_cover() from planes: PNG for ".png", otherwise BMP.
+void write_planar(const std::string& path, const PlanarImage& img, const PngOptions& png = PngOptions());
+
+// One channel in either layout: pixel x of row y is row(y)[x * step].
+struct ChannelView {
+    const uint8_t* data = nullptr;
+    size_t step = 1;        // 3 interleaved, 1 planar
+    size_t row_stride = 0;  // bytes between rows
+
+    const uint8_t* row(int y) const { return data + (size_t)y * row_stride; }
+};
+
+// Read-only view of an image in either layout, for analyses that work per
+// channel. Planar views let those loops run over contiguous bytes.
+struct ImageView {
+    int width = 0;
+    int height = 0;
+    ChannelView channel[3];
+
+    ImageView() = default;
+    ImageView(const BMPImage& img);
+    ImageView(const PlanarImage& img);
+
+    bool planar() const { return channel[0].step == 1; }
+};
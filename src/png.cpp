@@ -0,0 +1,1431 @@
+// png.cpp
+// PNG covers: in-tree inflate/deflate, band-parallel compression, streamed embedding
+#include "png.h"
+#include "file_io.h"
+#include "mapped_file.h"
+#include "parallel.h"
+#include "prng_permute.h"
+#include "stream_io.h"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <climits>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <future>
+#include <stdexcept>
+#include <thread>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+constexpr uint8_t kSignature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+constexpr size_t kWindow = 32768;          // deflate history
+constexpr size_t kBlockSymbols = 32768;    // symbols per deflate block
+constexpr size_t kIdatBytes = 1 << 20;     // IDAT chunk size on output
+
+[[noreturn]] void corrupt(const char* what) {
+    throw std::runtime_error(std::string("Corrupt PNG: ") + what);
+}
+
+uint32_t get32(const uint8_t* p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+void put32(uint8_t* p, uint32_t v) {
+    p[0] = (uint8_t)(v >> 24);
+    p[1] = (uint8_t)(v >> 16);
+    p[2] = (uint8_t)(v >> 8);
+    p[3] = (uint8_t)v;
+}
+
+// ---------------------------------------------------------------------------
+// Checksums
+
+uint32_t crc32(uint32_t crc, const uint8_t* data, size_t len) {
+    static const std::array<uint32_t, 256> table = [] {
+        std::array<uint32_t, 256> t{};
+        for (uint32_t n = 0; n < 256; ++n) {
+            uint32_t c = n;
+            for (int k = 0; k < 8; ++k) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            t[n] = c;
+        }
+        return t;
+    }();
+    crc = ~crc;
+    for (size_t i = 0; i < len; ++i) crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+constexpr uint32_t kAdlerBase = 65521;
+
+uint32_t adler32(uint32_t adler, const uint8_t* p, size_t len) {
+    uint32_t a = adler & 0xFFFF, b = adler >> 16;
+    while (len) {
+        // 5552 bytes is the most that cannot overflow b before the modulo
+        size_t n = std::min<size_t>(len, 5552);
+        len -= n;
+        for (; n >= 8; n -= 8, p += 8) {
+            a += p[0]; b += a; a += p[1]; b += a; a += p[2]; b += a; a += p[3]; b += a;
+            a += p[4]; b += a; a += p[5]; b += a; a += p[6]; b += a; a += p[7]; b += a;
+        }
+        for (; n; --n) {
+            a += *p++;
+            b += a;
+        }
+        a %= kAdlerBase;
+        b %= kAdlerBase;
+    }
+    return a | (b << 16);
+}
+
+// Adler-32 of A followed by B from the two checksums and B's length, so
+// bands can be summed on their own workers.
+uint32_t adler32_combine(uint32_t a, uint32_t b, uint64_t len_b) {
+    uint32_t rem = (uint32_t)(len_b % kAdlerBase);
+    uint32_t sum1 = a & 0xFFFF;
+    uint32_t sum2 = (uint32_t)((uint64_t)rem * sum1 % kAdlerBase);
+    sum1 += (b & 0xFFFF) + kAdlerBase - 1;
+    sum2 += (a >> 16) + (b >> 16) + kAdlerBase - rem;
+    if (sum1 >= kAdlerBase) sum1 -= kAdlerBase;
+    if (sum1 >= kAdlerBase) sum1 -= kAdlerBase;
+    if (sum2 >= 2 * kAdlerBase) sum2 -= 2 * kAdlerBase;
+    if (sum2 >= kAdlerBase) sum2 -= kAdlerBase;
+    return sum1 | (sum2 << 16);
+}
+
+// ---------------------------------------------------------------------------
+// Chunks
+
+struct PngFile {
+    uint32_t width = 0;
+    uint32_t height = 0;
+    int channels = 3;               // 3 = RGB, 4 = RGBA
+    std::vector<uint8_t> before;    // chunks between IHDR and IDAT, verbatim
+    std::vector<uint8_t> after;     // chunks between IDAT and IEND, verbatim
+    std::vector<uint8_t> idat;      // the zlib stream
+
+    size_t row_bytes() const { return (size_t)width * channels; }
+};
+
+void append_chunk(std::vector<uint8_t>& out, const char* type, const uint8_t* data, size_t len) {
+    uint8_t head[8];
+    put32(head, (uint32_t)len);
+    std::memcpy(head + 4, type, 4);
+    out.insert(out.end(), head, head + 8);
+    out.insert(out.end(), data, data + len);
+    uint8_t tail[4];
+    put32(tail, crc32(crc32(0, head + 4, 4), data, len));
+    out.insert(out.end(), tail, tail + 4);
+}
+
+PngFile parse_png(const uint8_t* bytes, size_t size) {
+    if (!is_png(bytes, size)) throw std::runtime_error("Not a PNG file");
+    PngFile png;
+    bool have_header = false, have_data = false, ended = false;
+    for (size_t pos = 8; pos + 12 <= size;) {
+        uint32_t len = get32(bytes + pos);
+        const uint8_t* type = bytes + pos + 4;
+        const uint8_t* data = bytes + pos + 8;
+        if (len > size - pos - 12) corrupt("truncated chunk");
+        if (crc32(0, type, len + 4) != get32(data + len)) corrupt("chunk CRC mismatch");
+        std::string name(reinterpret_cast<const char*>(type), 4);
+        size_t chunk_end = pos + 12 + len;
+
+        if (!have_header) {
+            if (name != "IHDR" || len != 13) corrupt("IHDR must come first");
+            png.width = get32(data);
+            png.height = get32(data + 4);
+            if (!png.width || !png.height || png.width > INT_MAX || png.height > INT_MAX) corrupt("bad dimensions");
+            if (data[8] != 8 || (data[9] != 2 && data[9] != 6))
+                throw std::runtime_error("Only 8-bit RGB and RGBA PNGs are supported");
+            if (data[10] != 0 || data[11] != 0) corrupt("unknown compression or filter method");
+            if (data[12] != 0) throw std::runtime_error("Interlaced PNGs are not supported");
+            png.channels = data[9] == 6 ? 4 : 3;
+            have_header = true;
+        } else if (name == "IDAT") {
+            if (have_data && !png.after.empty()) corrupt("IDAT chunks are not consecutive");
+            png.idat.insert(png.idat.end(), data, data + len);
+            have_data = true;
+        } else if (name == "IEND") {
+            ended = true;
+            break;
+        } else if ((type[0] & 0x20) == 0 && name != "PLTE") {
+            throw std::runtime_error("Unsupported critical PNG chunk " + name);
+        } else {
+            std::vector<uint8_t>& keep = have_data ? png.after : png.before;
+            keep.insert(keep.end(), bytes + pos, bytes + chunk_end);
+        }
+        pos = chunk_end;
+    }
+    if (!have_header || !have_data) corrupt("missing IHDR or IDAT");
+    if (!ended) corrupt("missing IEND");
+    return png;
+}
+
+// ---------------------------------------------------------------------------
+// Inflate (RFC 1950/1951)
+
+constexpr uint16_t kLengthBase[29] = {3,  4,  5,  6,  7,  8,  9,  10, 11,  13,  15,  17,  19,  23, 27,
+                                      31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+constexpr uint8_t kLengthExtra[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2,
+                                      2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+constexpr uint16_t kDistBase[30] = {1,   2,   3,   4,   5,   7,    9,    13,   17,   25,   33,   49,    65,    97,    129,
+                                    193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+constexpr uint8_t kDistExtra[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6,
+                                    6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+constexpr uint8_t kCodeLengthOrder[19] = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+
+uint32_t reverse_bits(uint32_t code, int n) {
+    uint32_t r = 0;
+    for (int i = 0; i < n; ++i, code >>= 1) r = (r << 1) | (code & 1);
+    return r;
+}
+
+// Codes of up to kFastBits resolve with one lookup on the next input bits;
+// longer ones walk the canonical code per length.
+struct InflateTable {
+    static constexpr int kFastBits = 10;
+    uint16_t fast[1 << kFastBits];  // (length << 9) | symbol, 0 = longer code
+    uint16_t count[16];
+    uint16_t symbols[288];
+
+    void build(const uint8_t* lengths, int n) {
+        std::memset(fast, 0, sizeof(fast));
+        std::memset(count, 0, sizeof(count));
+        for (int i = 0; i < n; ++i) ++count[lengths[i]];
+        count[0] = 0;
+        int left = 1;
+        for (int len = 1; len <= 15; ++len) {
+            left = (left << 1) - count[len];
+            if (left < 0) corrupt("over-subscribed Huffman code");
+        }
+        uint16_t offsets[16] = {};
+        for (int len = 1; len < 15; ++len) offsets[len + 1] = (uint16_t)(offsets[len] + count[len]);
+        for (int sym = 0; sym < n; ++sym)
+            if (lengths[sym]) symbols[offsets[lengths[sym]]++] = (uint16_t)sym;
+
+        uint32_t code = 0;
+        int k = 0;
+        for (int len = 1; len <= 15; ++len, code <<= 1) {
+            for (int i = 0; i < count[len]; ++i, ++code, ++k) {
+                if (len > kFastBits) continue;
+                for (uint32_t j = reverse_bits(code, len); j < (1u << kFastBits); j += 1u << len)
+                    fast[j] = (uint16_t)((len << 9) | symbols[k]);
+            }
+        }
+    }
+};
+
+class Inflater {
+public:
+    Inflater(const uint8_t* data, size_t size) : pos_(data), end_(data + size) {
+        if (size < 2 || (data[0] & 0x0F) != 8 || (data[0] >> 4) > 7 || ((data[0] << 8) | data[1]) % 31 ||
+            (data[1] & 0x20))
+            corrupt("bad zlib header");
+        pos_ += 2;
+        buf_.resize(1 << 20);
+    }
+
+    // Next `n` bytes of the stream; valid until the next call.
+    const uint8_t* read(size_t n) {
+        if (end_out_ - read_ < n && !produce(n)) corrupt("image data ends early");
+        const uint8_t* p = &buf_[read_];
+        read_ += n;
+        return p;
+    }
+
+    // Decodes to the end and checks the Adler-32 trailer.
+    void finish() {
+        while (produce(end_out_ - read_ + 65536)) read_ = end_out_;
+    }
+
+private:
+    uint32_t bits(int n) {
+        refill();
+        uint32_t v = (uint32_t)(bits_ & ((1ull << n) - 1));
+        bits_ >>= n;
+        count_ -= n;
+        return v;
+    }
+
+    void refill() {
+        if (count_ >= 48) return;
+        if (end_ - pos_ >= 8) {
+            uint64_t word;
+            std::memcpy(&word, pos_, 8);
+            bits_ |= word << count_;
+            pos_ += (63 - count_) >> 3;
+            count_ |= 56;
+            return;
+        }
+        while (count_ <= 56) {
+            uint64_t byte = 0;
+            if (pos_ < end_) byte = *pos_++;
+            else ++overrun_;
+            bits_ |= byte << count_;
+            count_ += 8;
+        }
+    }
+
+    int decode(const InflateTable& t) {
+        refill();
+        if (uint16_t e = t.fast[bits_ & ((1u << InflateTable::kFastBits) - 1)]) {
+            bits_ >>= e >> 9;
+            count_ -= e >> 9;
+            return e & 0x1FF;
+        }
+        int code = 0, first = 0, index = 0;
+        for (int len = 1; len <= 15; ++len) {
+            code |= (int)((bits_ >> (len - 1)) & 1);
+            int n = t.count[len];
+            if (code - n < first) {
+                bits_ >>= len;
+                count_ -= len;
+                return t.symbols[index + (code - first)];
+            }
+            index += n;
+            first = (first + n) << 1;
+            code <<= 1;
+        }
+        corrupt("invalid Huffman code");
+    }
+
+    void align() {
+        bits_ >>= count_ & 7;
+        count_ &= ~7;
+    }
+
+    void read_block_header() {
+        final_ = bits(1);
+        switch (bits(2)) {
+        case 0: {
+            align();
+            uint32_t len = bits(16), nlen = bits(16);
+            if ((len ^ 0xFFFF) != nlen) corrupt("bad stored block length");
+            stored_left_ = len;
+            state_ = State::Stored;
+            break;
+        }
+        case 1: {
+            static const std::pair<InflateTable, InflateTable> fixed = [] {
+                std::pair<InflateTable, InflateTable> t;
+                uint8_t lengths[288];
+                std::fill(lengths, lengths + 144, 8);
+                std::fill(lengths + 144, lengths + 256, 9);
+                std::fill(lengths + 256, lengths + 280, 7);
+                std::fill(lengths + 280, lengths + 288, 8);
+                t.first.build(lengths, 288);
+                std::fill(lengths, lengths + 30, 5);
+                t.second.build(lengths, 30);
+                return t;
+            }();
+            lit_ = fixed.first;
+            dist_ = fixed.second;
+            state_ = State::Huffman;
+            break;
+        }
+        case 2:
+            read_dynamic_tables();
+            state_ = State::Huffman;
+            break;
+        default:
+            corrupt("bad deflate block type");
+        }
+    }
+
+    void read_dynamic_tables() {
+        int hlit = (int)bits(5) + 257, hdist = (int)bits(5) + 1, hclen = (int)bits(4) + 4;
+        if (hlit > 286 || hdist > 30) corrupt("bad deflate table sizes");
+        uint8_t cl_lengths[19] = {};
+        for (int i = 0; i < hclen; ++i) cl_lengths[kCodeLengthOrder[i]] = (uint8_t)bits(3);
+        InflateTable cl;
+        cl.build(cl_lengths, 19);
+        uint8_t lengths[286 + 30];
+        for (int i = 0; i < hlit + hdist;) {
+            int sym = decode(cl);
+            if (sym < 16) {
+                lengths[i++] = (uint8_t)sym;
+                continue;
+            }
+            uint8_t value = 0;
+            int repeat;
+            if (sym == 16) {
+                if (!i) corrupt("length repeat with no previous length");
+                value = lengths[i - 1];
+                repeat = 3 + (int)bits(2);
+            } else if (sym == 17) {
+                repeat = 3 + (int)bits(3);
+            } else {
+                repeat = 11 + (int)bits(7);
+            }
+            if (i + repeat > hlit + hdist) corrupt("code lengths overflow");
+            std::fill(lengths + i, lengths + i + repeat, value);
+            i += repeat;
+        }
+        if (!lengths[256]) corrupt("no end-of-block code");
+        lit_.build(lengths, hlit);
+        dist_.build(lengths + hlit, hdist);
+    }
+
+    // Decodes until `need` bytes past read_ are available. Returns false once
+    // the stream has ended short of that.
+    bool produce(size_t need) {
+        // Keep the last window of history, then make room for the request
+        size_t keep = std::min(read_, end_out_ > kWindow ? end_out_ - kWindow : 0);
+        if (keep > (1 << 18)) {
+            std::memmove(buf_.data(), buf_.data() + keep, end_out_ - keep);
+            read_ -= keep;
+            end_out_ -= keep;
+        }
+        if (buf_.size() < read_ + need + 512) buf_.resize(std::max(buf_.size() * 2, read_ + need + 512));
+        size_t start = end_out_;
+        const size_t target = read_ + need;
+        uint8_t* out = buf_.data();
+
+        while (end_out_ < target) {
+            if (overrun_ && (int)overrun_ * 8 > count_) corrupt("truncated zlib stream");
+            if (state_ == State::Done) break;
+            if (state_ == State::Header) {
+                if (final_) {
+                    check_trailer(start);
+                    start = end_out_;
+                    state_ = State::Done;
+                    break;
+                }
+                read_block_header();
+            } else if (state_ == State::Stored) {
+                size_t n = std::min(stored_left_, target - end_out_);
+                for (; n && count_ >= 8; --n, --stored_left_) out[end_out_++] = (uint8_t)bits(8);
+                size_t direct = std::min<size_t>(n, (size_t)(end_ - pos_));
+                if (n && !direct) corrupt("truncated stored block");
+                std::memcpy(out + end_out_, pos_, direct);
+                pos_ += direct;
+                end_out_ += direct;
+                stored_left_ -= direct;
+                if (!stored_left_) state_ = State::Header;
+            } else {
+                int sym = decode(lit_);
+                if (sym < 256) {
+                    out[end_out_++] = (uint8_t)sym;
+                    continue;
+                }
+                if (sym == 256) {
+                    state_ = State::Header;
+                    continue;
+                }
+                sym -= 257;
+                if (sym >= 29) corrupt("bad length code");
+                size_t len = kLengthBase[sym] + bits(kLengthExtra[sym]);
+                int dsym = decode(dist_);
+                if (dsym >= 30) corrupt("bad distance code");
+                size_t dist = kDistBase[dsym] + bits(kDistExtra[dsym]);
+                if (dist > total_ + end_out_ - start) corrupt("distance before start of stream");
+                const uint8_t* from = out + end_out_ - dist;
+                uint8_t* to = out + end_out_;
+                if (dist >= 8) {
+                    // Non-overlapping 8-byte steps; the buffer has slack for the overshoot
+                    for (size_t i = 0; i < len; i += 8) std::memcpy(to + i, from + i, 8);
+                } else {
+                    for (size_t i = 0; i < len; ++i) to[i] = from[i];
+                }
+                end_out_ += len;
+            }
+        }
+        adler_ = adler32(adler_, out + start, end_out_ - start);
+        total_ += end_out_ - start;
+        return end_out_ >= target;
+    }
+
+    void check_trailer(size_t start) {
+        adler_ = adler32(adler_, buf_.data() + start, end_out_ - start);
+        total_ += end_out_ - start;
+        align();
+        uint32_t stored = 0;
+        for (int i = 0; i < 4; ++i) stored = (stored << 8) | bits(8);
+        if (overrun_ && (int)overrun_ * 8 > count_) corrupt("missing zlib checksum");
+        if (stored != adler_) corrupt("zlib checksum mismatch");
+    }
+
+    enum class State { Header, Stored, Huffman, Done };
+
+    const uint8_t* pos_;
+    const uint8_t* end_;
+    uint64_t bits_ = 0;
+    int count_ = 0;
+    size_t overrun_ = 0;  // zero bytes fed past the end of the input
+
+    State state_ = State::Header;
+    bool final_ = false;
+    size_t stored_left_ = 0;
+    InflateTable lit_, dist_;
+
+    std::vector<uint8_t> buf_;  // history window followed by unread output
+    size_t read_ = 0;           // first unread byte in buf_
+    size_t end_out_ = 0;        // end of decoded output in buf_
+    uint64_t total_ = 0;        // bytes decoded before the current produce()
+    uint32_t adler_ = 1;
+};
+
+// ---------------------------------------------------------------------------
+// Row filters
+
+uint8_t paeth(int a, int b, int c) {
+    int pa = std::abs(b - c), pb = std::abs(a - c), pc = std::abs(a + b - 2 * c);
+    return (uint8_t)(pa <= pb && pa <= pc ? a : pb <= pc ? b : c);
+}
+
+// Undoes the filter in place. `cur` and `prev` are preceded by `bpp` zero
+// bytes, so the left neighbour of the first pixel needs no special case.
+void unfilter_row(uint8_t type, uint8_t* cur, const uint8_t* prev, size_t n, int bpp) {
+    switch (type) {
+    case 0:
+        break;
+    case 1:
+        for (size_t i = 0; i < n; ++i) cur[i] = (uint8_t)(cur[i] + cur[(ptrdiff_t)i - bpp]);
+        break;
+    case 2:
+        for (size_t i = 0; i < n; ++i) cur[i] = (uint8_t)(cur[i] + prev[i]);
+        break;
+    case 3:
+        for (size_t i = 0; i < n; ++i) cur[i] = (uint8_t)(cur[i] + ((cur[(ptrdiff_t)i - bpp] + prev[i]) >> 1));
+        break;
+    case 4:
+        for (size_t i = 0; i < n; ++i)
+            cur[i] = (uint8_t)(cur[i] + paeth(cur[(ptrdiff_t)i - bpp], prev[i], prev[(ptrdiff_t)i - bpp]));
+        break;
+    default:
+        corrupt("bad filter type");
+    }
+}
+
+uint8_t predict(int type, uint8_t a, uint8_t b, uint8_t c) {
+    switch (type) {
+    case 1: return a;
+    case 2: return b;
+    case 3: return (uint8_t)((a + b) >> 1);
+    case 4: return paeth(a, b, c);
+    default: return 0;
+    }
+}
+
+#if defined(__SSE2__)
+__m128i abs_epi16(__m128i x) { return _mm_max_epi16(x, _mm_sub_epi16(_mm_setzero_si128(), x)); }
+
+__m128i select_epi16(__m128i mask, __m128i yes, __m128i no) {
+    return _mm_or_si128(_mm_and_si128(mask, yes), _mm_andnot_si128(mask, no));
+}
+
+// Paeth predictor on eight 16-bit lanes: pa = |b - c|, pb = |a - c|,
+// pc = |a + b - 2c|, ties going to a, then b.
+__m128i paeth_epi16(__m128i a, __m128i b, __m128i c) {
+    __m128i bc = _mm_sub_epi16(b, c), ac = _mm_sub_epi16(a, c);
+    __m128i pa = abs_epi16(bc), pb = abs_epi16(ac), pc = abs_epi16(_mm_add_epi16(bc, ac));
+    __m128i b_or_c = select_epi16(_mm_cmpgt_epi16(pb, pc), c, b);
+    __m128i not_a = _mm_or_si128(_mm_cmpgt_epi16(pa, pb), _mm_cmpgt_epi16(pa, pc));
+    return select_epi16(not_a, b_or_c, a);
+}
+
+template <int Type>
+__m128i predict_sse2(__m128i a, __m128i b, __m128i c) {
+    const __m128i zero = _mm_setzero_si128();
+    if (Type == 1) return a;
+    if (Type == 2) return b;
+    if (Type == 3) {
+        // pavgb rounds up; PNG's average rounds down
+        return _mm_sub_epi8(_mm_avg_epu8(a, b), _mm_and_si128(_mm_xor_si128(a, b), _mm_set1_epi8(1)));
+    }
+    if (Type == 4) {
+        __m128i lo = paeth_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero), _mm_unpacklo_epi8(c, zero));
+        __m128i hi = paeth_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero), _mm_unpackhi_epi8(c, zero));
+        return _mm_packus_epi16(lo, hi);
+    }
+    return zero;
+}
+#endif
+
+// Applies filter `Type` to a raw row (padded like unfilter_row) and returns
+// the sum of the outputs read as signed magnitudes, the usual heuristic for
+// picking the filter that deflate will compress best.
+template <int Type>
+uint64_t filter_row(const uint8_t* raw, const uint8_t* prev, size_t n, int bpp, uint8_t* out) {
+    size_t i = 0;
+    uint64_t sum = 0;
+#if defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    __m128i acc = zero;
+    auto load = [](const uint8_t* p) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)); };
+    for (; i + 16 <= n; i += 16) {
+        __m128i pred = predict_sse2<Type>(load(raw + i - bpp), load(prev + i), load(prev + i - bpp));
+        __m128i d = _mm_sub_epi8(load(raw + i), pred);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), d);
+        acc = _mm_add_epi64(acc, _mm_sad_epu8(_mm_min_epu8(d, _mm_sub_epi8(zero, d)), zero));
+    }
+    sum = (uint64_t)_mm_cvtsi128_si64(acc) + (uint64_t)_mm_cvtsi128_si64(_mm_unpackhi_epi64(acc, acc));
+#endif
+    for (; i < n; ++i) {
+        uint8_t d = (uint8_t)(raw[i] - predict(Type, raw[(ptrdiff_t)i - bpp], prev[i], prev[(ptrdiff_t)i - bpp]));
+        out[i] = d;
+        sum += d < 128 ? d : 256 - d;
+    }
+    return sum;
+}
+
+// Writes the filter type byte and the best-scoring filtered row to `out`.
+void filter_best(const uint8_t* raw, const uint8_t* prev, size_t n, int bpp, uint8_t* out, uint8_t* scratch) {
+    using FilterFn = uint64_t (*)(const uint8_t*, const uint8_t*, size_t, int, uint8_t*);
+    static constexpr FilterFn filters[5] = {filter_row<0>, filter_row<1>, filter_row<2>, filter_row<3>,
+                                            filter_row<4>};
+    uint8_t* best = out + 1;
+    uint8_t* trial = scratch;
+    uint64_t best_score = filters[0](raw, prev, n, bpp, best);
+    out[0] = 0;
+    for (int type = 1; type < 5; ++type) {
+        uint64_t score = filters[type](raw, prev, n, bpp, trial);
+        if (score < best_score) {
+            best_score = score;
+            out[0] = (uint8_t)type;
+            std::swap(best, trial);
+        }
+    }
+    if (best != out + 1) std::memcpy(out + 1, best, n);
+}
+
+// ---------------------------------------------------------------------------
+// Deflate
+
+// LZ77 effort per level, after zlib's configuration table
+struct Effort {
+    int good;   // search a quarter of the chain once the previous match is this long
+    int lazy;   // no lazy search once the previous match is this long
+    int nice;   // stop searching at this length
+    int chain;  // candidates examined per position
+};
+constexpr Effort kEffort[10] = {{0, 0, 0, 0},       {4, 4, 8, 4},       {4, 5, 16, 8},      {4, 6, 32, 32},
+                                {4, 4, 16, 16},     {8, 16, 32, 32},    {8, 16, 128, 128},  {8, 32, 128, 256},
+                                {32, 128, 258, 1024}, {32, 258, 258, 4096}};
+
+struct Symbol {
+    uint16_t value;  // literal byte, or match length
+    uint16_t dist;   // 0 for literals
+};
+
+uint8_t length_code(size_t len) {
+    static const std::array<uint8_t, 259> table = [] {
+        std::array<uint8_t, 259> t{};
+        for (int code = 0; code < 29; ++code) {
+            int top = code == 28 ? 258 : (code == 27 ? 257 : kLengthBase[code + 1] - 1);
+            for (int l = kLengthBase[code]; l <= top; ++l) t[l] = (uint8_t)code;
+        }
+        return t;
+    }();
+    return table[len];
+}
+
+int distance_code(uint32_t dist) {
+    uint32_t x = dist - 1;
+    if (x < 4) return (int)x;
+    int k = 31 - __builtin_clz(x);
+    return 2 * k + (int)((x >> (k - 1)) & 1);
+}
+
+// Length-limited Huffman code lengths. The tree is built from sorted
+// frequencies with the two-queue method; lengths past `limit` are folded
+// back by the Kraft-sum repair miniz uses. At least two symbols always get a
+// code so every decoder accepts the table.
+void huffman_lengths(const uint32_t* freq_in, int n, int limit, uint8_t* lengths) {
+    std::vector<uint32_t> freq(freq_in, freq_in + n);
+    std::fill(lengths, lengths + n, 0);
+    int used = (int)std::count_if(freq.begin(), freq.end(), [](uint32_t f) { return f != 0; });
+    for (int s = 0; s < n && used < 2; ++s)
+        if (!freq[s]) {
+            freq[s] = 1;
+            ++used;
+        }
+
+    std::vector<std::pair<uint32_t, int>> leaves;
+    for (int s = 0; s < n; ++s)
+        if (freq[s]) leaves.push_back({freq[s], s});
+    std::sort(leaves.begin(), leaves.end());
+    const size_t m = leaves.size();
+
+    // Internal node i merges two of the smallest remaining nodes; children
+    // are leaf indices or m + internal index
+    std::vector<uint64_t> weight(m - 1);
+    std::vector<size_t> parent(2 * m - 1);
+    size_t leaf = 0, inner = 0;
+    auto take = [&](size_t made) {
+        if (leaf < m && (inner >= made || leaves[leaf].first <= weight[inner])) return leaf++;
+        return m + inner++;
+    };
+    for (size_t k = 0; k + 1 < m; ++k) {
+        size_t a = take(k), b = take(k);
+        weight[k] = (a < m ? leaves[a].first : weight[a - m]) + (b < m ? leaves[b].first : weight[b - m]);
+        parent[a] = parent[b] = m + k;
+    }
+    std::vector<int> depth(2 * m - 1, 0);
+    int counts[64] = {};
+    for (size_t node = 2 * m - 2; node-- > 0;) {
+        depth[node] = depth[parent[node]] + 1;
+        if (node < m) ++counts[std::min(depth[node], 63)];
+    }
+
+    int max_len = 0;
+    for (int len = 1; len < 64; ++len)
+        if (counts[len]) max_len = len;
+    if (max_len > limit) {
+        for (int len = limit + 1; len < 64; ++len) {
+            counts[limit] += counts[len];
+            counts[len] = 0;
+        }
+        uint64_t total = 0;
+        for (int len = limit; len > 0; --len) total += (uint64_t)counts[len] << (limit - len);
+        while (total != (1ull << limit)) {
+            --counts[limit];
+            for (int len = limit - 1; len > 0; --len)
+                if (counts[len]) {
+                    --counts[len];
+                    counts[len + 1] += 2;
+                    break;
+                }
+            --total;
+        }
+        max_len = limit;
+    }
+    // Rarest symbols get the longest codes
+    size_t next = 0;
+    for (int len = max_len; len > 0; --len)
+        for (int i = 0; i < counts[len]; ++i) lengths[leaves[next++].second] = (uint8_t)len;
+}
+
+// Canonical codes, bit-reversed for LSB-first output.
+void canonical_codes(const uint8_t* lengths, int n, uint16_t* codes) {
+    uint16_t count[16] = {}, next[16] = {};
+    for (int i = 0; i < n; ++i) ++count[lengths[i]];
+    count[0] = 0;
+    for (int len = 1; len < 16; ++len) next[len] = (uint16_t)((next[len - 1] + count[len - 1]) << 1);
+    for (int i = 0; i < n; ++i)
+        if (lengths[i]) codes[i] = (uint16_t)reverse_bits(next[lengths[i]]++, lengths[i]);
+}
+
+class DeflateBits {
+public:
+    explicit DeflateBits(std::vector<uint8_t>& out) : out_(out) {}
+
+    void put(uint32_t bits, int n) {
+        acc_ |= (uint64_t)bits << count_;
+        count_ += n;
+        if (count_ >= 32) {
+            uint8_t bytes[4] = {(uint8_t)acc_, (uint8_t)(acc_ >> 8), (uint8_t)(acc_ >> 16), (uint8_t)(acc_ >> 24)};
+            out_.insert(out_.end(), bytes, bytes + 4);
+            acc_ >>= 32;
+            count_ -= 32;
+        }
+    }
+
+    void align() {
+        for (; count_ > 0; count_ -= 8, acc_ >>= 8) out_.push_back((uint8_t)acc_);
+        count_ = 0;
+        acc_ = 0;
+    }
+
+    std::vector<uint8_t>& bytes() { return out_; }
+
+private:
+    std::vector<uint8_t>& out_;
+    uint64_t acc_ = 0;
+    int count_ = 0;
+};
+
+struct BlockCodes {
+    uint8_t lit_len[286], dist_len[30];
+    uint16_t lit_code[286], dist_code[30];
+};
+
+const BlockCodes& fixed_codes() {
+    static const BlockCodes codes = [] {
+        // Codes come from all 288 symbols of RFC 1951 3.2.6, of which 286
+        // and 287 are never sent; leaving them out shifts the 9-bit codes
+        BlockCodes c{};
+        uint8_t lit_len[288];
+        uint16_t lit_code[288];
+        std::fill(lit_len, lit_len + 144, 8);
+        std::fill(lit_len + 144, lit_len + 256, 9);
+        std::fill(lit_len + 256, lit_len + 280, 7);
+        std::fill(lit_len + 280, lit_len + 288, 8);
+        canonical_codes(lit_len, 288, lit_code);
+        std::copy(lit_len, lit_len + 286, c.lit_len);
+        std::copy(lit_code, lit_code + 286, c.lit_code);
+        std::fill(c.dist_len, c.dist_len + 30, 5);
+        canonical_codes(c.dist_len, 30, c.dist_code);
+        return c;
+    }();
+    return codes;
+}
+
+uint64_t symbol_bits(const uint32_t* lit_freq, const uint32_t* dist_freq, const BlockCodes& c) {
+    uint64_t bits = 0;
+    for (int s = 0; s < 286; ++s)
+        bits += (uint64_t)lit_freq[s] * (c.lit_len[s] + (s > 256 ? kLengthExtra[s - 257] : 0));
+    for (int s = 0; s < 30; ++s) bits += (uint64_t)dist_freq[s] * (c.dist_len[s] + kDistExtra[s]);
+    return bits;
+}
+
+// Emits one block for `symbols`, which cover `raw` (n bytes): dynamic,
+// fixed or stored, whichever is smallest.
+void write_block(DeflateBits& out, const std::vector<Symbol>& symbols, const uint8_t* raw, size_t n) {
+    uint32_t lit_freq[286] = {}, dist_freq[30] = {};
+    for (const Symbol& s : symbols) {
+        if (!s.dist) {
+            ++lit_freq[s.value];
+        } else {
+            ++lit_freq[257 + length_code(s.value)];
+            ++dist_freq[distance_code(s.dist)];
+        }
+    }
+    lit_freq[256] = 1;
+
+    BlockCodes dyn;
+    huffman_lengths(lit_freq, 286, 15, dyn.lit_len);
+    huffman_lengths(dist_freq, 30, 15, dyn.dist_len);
+    canonical_codes(dyn.lit_len, 286, dyn.lit_code);
+    canonical_codes(dyn.dist_len, 30, dyn.dist_code);
+
+    // Code lengths of both tables as one run-length coded sequence
+    int hlit = 286, hdist = 30;
+    while (hlit > 257 && !dyn.lit_len[hlit - 1]) --hlit;
+    while (hdist > 1 && !dyn.dist_len[hdist - 1]) --hdist;
+    std::vector<uint8_t> all(dyn.lit_len, dyn.lit_len + hlit);
+    all.insert(all.end(), dyn.dist_len, dyn.dist_len + hdist);
+    std::vector<std::pair<uint8_t, uint8_t>> runs;  // (symbol, extra value)
+    for (size_t i = 0; i < all.size();) {
+        size_t j = i;
+        while (j < all.size() && all[j] == all[i]) ++j;
+        size_t run = j - i;
+        if (!all[i]) {
+            for (; run >= 11; run -= std::min<size_t>(run, 138)) runs.push_back({18, (uint8_t)(std::min<size_t>(run, 138) - 11)});
+            if (run >= 3) {
+                runs.push_back({17, (uint8_t)(run - 3)});
+                run = 0;
+            }
+        } else {
+            runs.push_back({all[i], 0});
+            --run;
+            for (; run >= 3; run -= std::min<size_t>(run, 6)) runs.push_back({16, (uint8_t)(std::min<size_t>(run, 6) - 3)});
+        }
+        for (; run; --run) runs.push_back({all[i], 0});
+        i = j;
+    }
+    uint32_t cl_freq[19] = {};
+    for (auto& r : runs) ++cl_freq[r.first];
+    uint8_t cl_len[19];
+    uint16_t cl_code[19];
+    huffman_lengths(cl_freq, 19, 7, cl_len);
+    canonical_codes(cl_len, 19, cl_code);
+    int hclen = 19;
+    while (hclen > 4 && !cl_len[kCodeLengthOrder[hclen - 1]]) --hclen;
+
+    static constexpr uint8_t kRunExtra[3] = {2, 3, 7};
+    uint64_t dynamic_bits = 3 + 14 + 3 * (uint64_t)hclen + symbol_bits(lit_freq, dist_freq, dyn);
+    for (auto& r : runs) dynamic_bits += cl_len[r.first] + (r.first >= 16 ? kRunExtra[r.first - 16] : 0);
+    uint64_t fixed_bits = 3 + symbol_bits(lit_freq, dist_freq, fixed_codes());
+    uint64_t stored_bits = ((n + 65534) / 65535 + (n == 0)) * 40 + 8 * (uint64_t)n;
+
+    if (stored_bits <= std::min(dynamic_bits, fixed_bits)) {
+        size_t done = 0;
+        do {
+            size_t len = std::min<size_t>(n - done, 65535);
+            out.put(0, 3);
+            out.align();
+            uint8_t head[4] = {(uint8_t)len, (uint8_t)(len >> 8), (uint8_t)~len, (uint8_t)(~len >> 8)};
+            out.bytes().insert(out.bytes().end(), head, head + 4);
+            out.bytes().insert(out.bytes().end(), raw + done, raw + done + len);
+            done += len;
+        } while (done < n);
+        return;
+    }
+
+    const BlockCodes* codes = &dyn;
+    if (fixed_bits <= dynamic_bits) {
+        codes = &fixed_codes();
+        out.put(1 << 1, 3);
+    } else {
+        out.put(2 << 1, 3);
+        out.put((uint32_t)(hlit - 257), 5);
+        out.put((uint32_t)(hdist - 1), 5);
+        out.put((uint32_t)(hclen - 4), 4);
+        for (int i = 0; i < hclen; ++i) out.put(cl_len[kCodeLengthOrder[i]], 3);
+        for (auto& r : runs) {
+            out.put(cl_code[r.first], cl_len[r.first]);
+            if (r.first >= 16) out.put(r.second, kRunExtra[r.first - 16]);
+        }
+    }
+    for (const Symbol& s : symbols) {
+        if (!s.dist) {
+            out.put(codes->lit_code[s.value], codes->lit_len[s.value]);
+            continue;
+        }
+        int lc = length_code(s.value);
+        out.put(codes->lit_code[257 + lc], codes->lit_len[257 + lc]);
+        out.put(s.value - kLengthBase[lc], kLengthExtra[lc]);
+        int dc = distance_code(s.dist);
+        out.put(codes->dist_code[dc], codes->dist_len[dc]);
+        out.put(s.dist - kDistBase[dc], kDistExtra[dc]);
+    }
+    out.put(codes->lit_code[256], codes->lit_len[256]);
+}
+
+// Compresses `data` as a run of deflate blocks with no history before it.
+// A middle band ends on an empty stored block, so it finishes byte-aligned
+// and the next band's blocks can simply follow; the last band ends with a
+// final empty block.
+void deflate_band(const uint8_t* data, size_t n, int level, bool last, std::vector<uint8_t>& out) {
+    constexpr int kHashBits = 15;
+    const Effort effort = kEffort[std::clamp(level, 1, 9)];
+    std::vector<int32_t> head(1 << kHashBits, -1), prev(n);
+    auto hash = [&](size_t p) {
+        uint32_t v = (uint32_t)data[p] | ((uint32_t)data[p + 1] << 8) | ((uint32_t)data[p + 2] << 16);
+        return (v * 0x9E3779B1u) >> (32 - kHashBits);
+    };
+    auto insert = [&](size_t p) {
+        if (p + 3 > n) return -1;
+        uint32_t h = hash(p);
+        int32_t cand = head[h];
+        prev[p] = cand;
+        head[h] = (int32_t)p;
+        return cand;
+    };
+    auto match_length = [&](size_t a, size_t b, size_t max) {
+        size_t len = 0;
+        while (len + 8 <= max) {
+            uint64_t x, y;
+            std::memcpy(&x, data + a + len, 8);
+            std::memcpy(&y, data + b + len, 8);
+            if (uint64_t diff = x ^ y) return len + (__builtin_ctzll(diff) >> 3);
+            len += 8;
+        }
+        while (len < max && data[a + len] == data[b + len]) ++len;
+        return len;
+    };
+    // Longest match at p better than `best`, returning its distance in dist
+    auto find = [&](size_t p, int32_t cand, size_t best, uint32_t& dist) {
+        size_t max = std::min<size_t>(258, n - p);
+        if (max < 3) return size_t(0);
+        size_t limit = p > kWindow ? p - kWindow : 0;
+        size_t found = 0;
+        int chain = best >= (size_t)effort.good ? effort.chain >> 2 : effort.chain;
+        for (; cand >= 0 && (size_t)cand >= limit && chain--; cand = prev[cand]) {
+            if (best < max && data[cand + best] != data[p + best]) continue;
+            size_t len = match_length((size_t)cand, p, max);
+            if (len > best && len >= 3) {
+                best = found = len;
+                dist = (uint32_t)(p - cand);
+                if (len >= (size_t)effort.nice || len == max) break;
+            }
+        }
+        return found;
+    };
+
+    DeflateBits bits(out);
+    std::vector<Symbol> symbols;
+    symbols.reserve(kBlockSymbols + 2);
+    size_t block_start = 0, covered = 0;
+    auto emit = [&](Symbol s) {
+        symbols.push_back(s);
+        covered += s.dist ? s.value : 1;
+        if (symbols.size() >= kBlockSymbols) {
+            write_block(bits, symbols, data + block_start, covered - block_start);
+            symbols.clear();
+            block_start = covered;
+        }
+    };
+
+    // Lazy matching: a match is held back one position in case the next
+    // position starts a longer one
+    size_t prev_len = 0;
+    uint32_t prev_dist = 0, dist = 0;
+    bool pending = false;
+    for (size_t p = 0; p < n;) {
+        int32_t cand = insert(p);
+        size_t len = 0;
+        if (prev_len < (size_t)effort.lazy) len = find(p, cand, pending ? std::max<size_t>(prev_len, 2) : 2, dist);
+        if (pending && prev_len >= 3 && len <= prev_len) {
+            emit({(uint16_t)prev_len, (uint16_t)prev_dist});
+            size_t end = p - 1 + prev_len;
+            for (++p; p < end; ++p) insert(p);
+            prev_len = 0;
+            pending = false;
+            continue;
+        }
+        if (pending) emit({data[p - 1], 0});
+        prev_len = len;
+        prev_dist = dist;
+        pending = true;
+        ++p;
+    }
+    if (pending) {
+        if (prev_len >= 3) emit({(uint16_t)prev_len, (uint16_t)prev_dist});
+        else emit({data[n - 1], 0});
+    }
+    if (!symbols.empty() || n == 0) write_block(bits, symbols, data + block_start, covered - block_start);
+
+    if (last) {
+        bits.put(1 | (1 << 1), 3);  // final fixed block holding only end-of-block
+        bits.put(0, 7);
+        bits.align();
+    } else {
+        bits.put(0, 3);             // empty stored block: byte alignment marker
+        bits.align();
+        const uint8_t marker[4] = {0x00, 0x00, 0xFF, 0xFF};
+        out.insert(out.end(), marker, marker + 4);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Band pipeline
+
+struct CompressedBand {
+    std::vector<uint8_t> bytes;  // deflate data
+    uint32_t adler = 1;          // of the filtered rows
+    uint64_t length = 0;         // filtered bytes
+};
+
+struct RawBand {
+    std::vector<uint8_t> rows;  // raw rows, row_bytes each
+    std::vector<uint8_t> prev;  // raw row above the band, empty for the first
+    size_t row_count = 0;
+    bool last = false;
+    std::promise<CompressedBand> done;
+};
+
+CompressedBand compress_band(const RawBand& band, size_t row_bytes, int bpp, int level) {
+    CompressedBand result;
+    std::vector<uint8_t> filtered(band.row_count * (row_bytes + 1));
+    // Padded copies give the filters a zero left neighbour for the first pixel
+    std::vector<uint8_t> prev(row_bytes + bpp, 0), cur(row_bytes + bpp, 0), scratch(row_bytes);
+    if (!band.prev.empty()) std::memcpy(prev.data() + bpp, band.prev.data(), row_bytes);
+    for (size_t r = 0; r < band.row_count; ++r) {
+        std::memcpy(cur.data() + bpp, band.rows.data() + r * row_bytes, row_bytes);
+        filter_best(cur.data() + bpp, prev.data() + bpp, row_bytes, bpp, &filtered[r * (row_bytes + 1)],
+                    scratch.data());
+        std::swap(prev, cur);
+    }
+    result.adler = adler32(1, filtered.data(), filtered.size());
+    result.length = filtered.size();
+    result.bytes.reserve(filtered.size() / 2);
+    deflate_band(filtered.data(), filtered.size(), level, band.last, result.bytes);
+    return result;
+}
+
+// Writes PNG chunks through `write`, collecting the zlib stream into IDAT
+// chunks of about kIdatBytes.
+class ChunkWriter {
+public:
+    explicit ChunkWriter(std::function<void(const uint8_t*, size_t)> write) : write_(std::move(write)) {}
+
+    void raw(const uint8_t* data, size_t len) { write_(data, len); }
+
+    void chunk(const char* type, const uint8_t* data, size_t len) {
+        std::vector<uint8_t> out;
+        append_chunk(out, type, data, len);
+        write_(out.data(), out.size());
+    }
+
+    void zlib(const uint8_t* data, size_t len) {
+        idat_.insert(idat_.end(), data, data + len);
+        if (idat_.size() >= kIdatBytes) flush_idat();
+    }
+
+    void flush_idat() {
+        if (idat_.empty()) return;
+        chunk("IDAT", idat_.data(), idat_.size());
+        idat_.clear();
+    }
+
+private:
+    std::function<void(const uint8_t*, size_t)> write_;
+    std::vector<uint8_t> idat_;
+};
+
+void write_header(ChunkWriter& writer, uint32_t width, uint32_t height, int channels) {
+    writer.raw(kSignature, 8);
+    uint8_t ihdr[13];
+    put32(ihdr, width);
+    put32(ihdr + 4, height);
+    ihdr[8] = 8;
+    ihdr[9] = channels == 4 ? 6 : 2;
+    ihdr[10] = ihdr[11] = ihdr[12] = 0;
+    writer.chunk("IHDR", ihdr, 13);
+}
+
+// Compresses the bands `next(band)` fills, on worker threads, and writes the
+// zlib stream in order. The calling thread only produces rows; a writer
+// thread waits on each band's future in turn. Returns the band count.
+template <typename Next>
+uint64_t compress_bands(size_t row_bytes, int bpp, const PngOptions& options, ChunkWriter& writer, Next next) {
+    unsigned workers = options.threads ? options.threads : default_thread_count();
+    BoundedQueue<RawBand> to_compress(2 * workers);
+    BoundedQueue<std::future<CompressedBand>> to_write(2 * workers + 1);
+    PipelineError error;
+
+    std::vector<std::thread> pool;
+    for (unsigned w = 0; w < workers; ++w) {
+        pool.emplace_back([&] {
+            RawBand band;
+            while (to_compress.pop(band)) {
+                try {
+                    band.done.set_value(compress_band(band, row_bytes, bpp, options.level));
+                } catch (...) {
+                    band.done.set_exception(std::current_exception());
+                }
+            }
+        });
+    }
+
+    uint64_t bands = 0;
+    std::thread output([&] {
+        try {
+            const uint8_t zlib_header[2] = {0x78, 0x9C};
+            writer.zlib(zlib_header, 2);
+            uint32_t adler = 1;
+            std::future<CompressedBand> pending;
+            while (to_write.pop(pending)) {
+                CompressedBand band = pending.get();
+                writer.zlib(band.bytes.data(), band.bytes.size());
+                adler = adler32_combine(adler, band.adler, band.length);
+                ++bands;
+            }
+            uint8_t trailer[4];
+            put32(trailer, adler);
+            writer.zlib(trailer, 4);
+            writer.flush_idat();
+        } catch (...) {
+            error.fail(to_compress, to_write);
+        }
+    });
+
+    try {
+        for (;;) {
+            RawBand band;
+            if (!next(band)) break;
+            std::future<CompressedBand> result = band.done.get_future();
+            if (!to_write.push(std::move(result)) || !to_compress.push(std::move(band))) break;
+        }
+    } catch (...) {
+        error.fail(to_compress, to_write);
+    }
+    to_compress.close();
+    to_write.close();
+    for (auto& t : pool) t.join();
+    output.join();
+    error.rethrow();
+    return bands;
+}
+
+// ---------------------------------------------------------------------------
+// Streamed embedding
+
+// Carrier bytes and the bits the kernel writes in each, for channels
+// [0, span) in carrier order. Embedding into all-zero and all-one arrays
+// shows which bits the kernel owns without tying the plan to cover values.
+// The arrays run a header's worth past the span because the capacity check
+// sizes the length varint for the whole array; the slack is never written.
+struct EmbedPlan {
+    std::vector<uint8_t> value, mask;
+
+    EmbedPlan(const std::vector<uint8_t>& message, const ContainerOptions& options, uint64_t span,
+              uint64_t channels) {
+        ContainerOptions replace = options;
+        replace.mode = EmbedMode::Replace;
+        span = std::min(channels, span + kContainerMaxHeaderChannels);
+        std::vector<uint8_t> zeros(span, 0x00), ones(span, 0xFF);
+        container_encode_channels(zeros.data(), zeros.size(), message, replace);
+        container_encode_channels(ones.data(), ones.size(), message, replace);
+        value.resize(span);
+        mask.resize(span);
+        for (uint64_t j = 0; j < span; ++j) {
+            mask[j] = (uint8_t)~(zeros[j] ^ ones[j]);
+            value[j] = zeros[j] & mask[j];
+        }
+    }
+};
+
+// Logical pixels of the carrier that land in each stored row. Unkeyed
+// carriers are in image order; keyed ones are KeyedBijection positions of
+// the first `used` logical pixels, sorted so rows can take them in turn.
+class PixelTargets {
+public:
+    PixelTargets(uint64_t width, uint64_t pixels, uint64_t used, const std::string& passphrase)
+        : width_(width), used_(used) {
+        if (passphrase.empty()) return;
+        KeyedBijection order(pixels, passphrase);
+        keyed_.reserve(used);
+        for (uint64_t q = 0; q < used; ++q) keyed_.push_back({order.forward(q), q});
+        std::sort(keyed_.begin(), keyed_.end());
+        keyed_order_ = true;
+    }
+
+    // Calls fn(x, logical_pixel) for the carrier pixels in row r; rows must
+    // be visited in order.
+    template <typename Fn>
+    void for_row(uint64_t r, Fn fn) {
+        uint64_t begin = r * width_, end = begin + width_;
+        if (!keyed_order_) {
+            for (uint64_t p = begin; p < std::min(end, used_); ++p) fn(p - begin, p);
+            return;
+        }
+        for (; next_ < keyed_.size() && keyed_[next_].first < end; ++next_)
+            fn(keyed_[next_].first - begin, keyed_[next_].second);
+    }
+
+private:
+    uint64_t width_, used_;
+    bool keyed_order_ = false;
+    std::vector<std::pair<uint64_t, uint64_t>> keyed_;
+    size_t next_ = 0;
+};
+
+// Logical channel j of a keyed carrier lives at this offset of BMPImage data
+uint64_t keyed_channel(const KeyedBijection& order, uint64_t j) { return order.forward(j / 3) * 3 + j % 3; }
+
+std::vector<uint8_t> gather_keyed(const BMPImage& img, const KeyedBijection& order, uint64_t count) {
+    std::vector<uint8_t> out(count);
+    for (uint64_t j = 0; j < count; ++j) out[j] = img.data[keyed_channel(order, j)];
+    return out;
+}
+
+bool ends_with_png(const std::string& path) {
+    if (path.size() < 4) return false;
+    std::string ext = path.substr(path.size() - 4);
+    std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+    return ext == ".png";
+}
+
+} // namespace
+
+bool is_png(const uint8_t* bytes, size_t size) {
+    return size >= 8 && std::memcmp(bytes, kSignature, 8) == 0;
+}
+
+bool is_png_file(const std::string& path) {
+    std::error_code error;
+    if (is_std_stream(path) || !std::filesystem::is_regular_file(path, error)) return false;
+    std::ifstream file(path, std::ios::binary);
+    uint8_t magic[8] = {};
+    file.read(reinterpret_cast<char*>(magic), 8);
+    return file.gcount() == 8 && is_png(magic, 8);
+}
+
+BMPImage decode_png(const uint8_t* bytes, size_t size) {
+    PngFile png = parse_png(bytes, size);
+    const size_t row_bytes = png.row_bytes();
+    const int bpp = png.channels;
+    BMPImage img;
+    img.width = (int)png.width;
+    img.height = (int)png.height;
+    img.data.resize((size_t)png.width * png.height * 3);
+
+    Inflater inflater(png.idat.data(), png.idat.size());
+    std::vector<uint8_t> prev(row_bytes + bpp, 0), cur(row_bytes + bpp, 0);
+    for (uint32_t r = 0; r < png.height; ++r) {
+        const uint8_t* line = inflater.read(row_bytes + 1);
+        std::memcpy(cur.data() + bpp, line + 1, row_bytes);
+        unfilter_row(line[0], cur.data() + bpp, prev.data() + bpp, row_bytes, bpp);
+        uint8_t* out = &img.data[(size_t)r * png.width * 3];
+        const uint8_t* in = cur.data() + bpp;
+        for (uint32_t x = 0; x < png.width; ++x, in += bpp, out += 3) {
+            out[0] = in[2];
+            out[1] = in[1];
+            out[2] = in[0];
+        }
+        std::swap(prev, cur);
+    }
+    inflater.finish();
+    return img;
+}
+
+BMPImage load_png(const std::string& path) {
+    if (is_std_stream(path)) {
+        std::vector<uint8_t> bytes = read_all(path);
+        return decode_png(bytes.data(), bytes.size());
+    }
+    MappedFile file(path, MappedFile::Mode::ReadOnly);
+    return decode_png(file.data(), file.size());
+}
+
+std::vector<uint8_t> encode_png(const BMPImage& image, const PngOptions& options) {
+    if (image.width <= 0 || image.height <= 0) throw std::runtime_error("Cannot write an empty PNG");
+    std::vector<uint8_t> out;
+    ChunkWriter writer([&](const uint8_t* data, size_t len) { out.insert(out.end(), data, data + len); });
+    write_header(writer, (uint32_t)image.width, (uint32_t)image.height, 3);
+
+    const size_t row_bytes = (size_t)image.width * 3;
+    const size_t band_rows = (size_t)std::max(1, options.band_rows);
+    size_t row = 0;
+    compress_bands(row_bytes, 3, options, writer, [&](RawBand& band) {
+        if (row >= (size_t)image.height) return false;
+        band.row_count = std::min(band_rows, (size_t)image.height - row);
+        band.last = row + band.row_count == (size_t)image.height;
+        // BGR to RGB
+        band.rows.resize(band.row_count * row_bytes);
+        const uint8_t* in = &image.data[row * row_bytes];
+        for (size_t i = 0; i < band.rows.size(); i += 3) {
+            band.rows[i] = in[i + 2];
+            band.rows[i + 1] = in[i + 1];
+            band.rows[i + 2] = in[i];
+        }
+        if (row) {
+            band.prev.resize(row_bytes);
+            const uint8_t* above = &image.data[(row - 1) * row_bytes];
+            for (size_t i = 0; i < row_bytes; i += 3) {
+                band.prev[i] = above[i + 2];
+                band.prev[i + 1] = above[i + 1];
+                band.prev[i + 2] = above[i];
+            }
+        }
+        row += band.row_count;
+        return true;
+    });
+    writer.chunk("IEND", nullptr, 0);
+    return out;
+}
+
+void write_png(const std::string& path, const BMPImage& image, const PngOptions& options) {
+    write_all(path, encode_png(image, options));
+}
+
+BMPImage load_cover(const std::string& path) {
+    return is_png_file(path) ? load_png(path) : load_bmp(path);
+}
+
+void write_cover(const std::string& path, const BMPImage& image, const PngOptions& png) {
+    if (!is_std_stream(path) && ends_with_png(path)) write_png(path, image, png);
+    else write_bmp(path, image);
+}
+
+PngStats png_embed(const std::string& input, const std::string& output, const std::vector<uint8_t>& message,
+                   const ContainerOptions& options, const PngOptions& png_options) {
+    auto start = std::chrono::steady_clock::now();
+    if (options.mode == EmbedMode::Match && options.params.bits_per_channel != 1)
+        throw std::runtime_error("LSB matching needs 1 bit per channel");
+
+    std::vector<uint8_t> stdin_bytes;
+    std::unique_ptr<MappedFile> mapped;
+    const uint8_t* bytes;
+    size_t size;
+    if (is_std_stream(input)) {
+        stdin_bytes = read_all(input);
+        bytes = stdin_bytes.data();
+        size = stdin_bytes.size();
+    } else {
+        mapped = std::make_unique<MappedFile>(input, MappedFile::Mode::ReadOnly);
+        bytes = mapped->data();
+        size = mapped->size();
+    }
+    PngFile png = parse_png(bytes, size);
+
+    const uint64_t pixels = (uint64_t)png.width * png.height;
+    uint64_t cap = container_capacity(pixels * 3, options.params);
+    if (message.size() > cap)
+        throw std::runtime_error("Message too large for image (capacity: " + std::to_string(cap) + " bytes)");
+    const uint64_t span = container_span(message.size(), options.params);
+    EmbedPlan plan(message, options, span, pixels * 3);
+    PixelTargets targets(png.width, pixels, (span + 2) / 3, options.passphrase);
+    uint64_t rng = keyed_hash(options.passphrase, 1) | 1;
+
+    // Output goes straight to the file as bands complete
+    PngStats stats;
+    stats.input_bytes = size;
+    std::vector<uint8_t> stdout_bytes;
+    FileDescriptor out_fd;
+    if (!is_std_stream(output)) out_fd = open_for_write(output);
+    ChunkWriter writer([&](const uint8_t* data, size_t len) {
+        if (out_fd) pwrite_full(out_fd.get(), data, len, stats.output_bytes);
+        else stdout_bytes.insert(stdout_bytes.end(), data, data + len);
+        stats.output_bytes += len;
+    });
+    write_header(writer, png.width, png.height, png.channels);
+    writer.raw(png.before.data(), png.before.size());
+
+    const size_t row_bytes = png.row_bytes();
+    const int bpp = png.channels;
+    const size_t band_rows = (size_t)std::max(1, png_options.band_rows);
+    Inflater inflater(png.idat.data(), png.idat.size());
+    std::vector<uint8_t> prev(row_bytes + bpp, 0), cur(row_bytes + bpp, 0);
+    std::vector<uint8_t> above;  // last embedded row, which the next band filters against
+    uint64_t row = 0;
+    stats.bands = compress_bands(row_bytes, bpp, png_options, writer, [&](RawBand& band) {
+        if (row >= png.height) return false;
+        band.row_count = std::min<uint64_t>(band_rows, png.height - row);
+        band.last = row + band.row_count == png.height;
+        band.prev = above;
+        band.rows.resize(band.row_count * row_bytes);
+        for (size_t k = 0; k < band.row_count; ++k, ++row) {
+            const uint8_t* line = inflater.read(row_bytes + 1);
+            std::memcpy(cur.data() + bpp, line + 1, row_bytes);
+            unfilter_row(line[0], cur.data() + bpp, prev.data() + bpp, row_bytes, bpp);
+            // The unfiltered row is the one the next row unfilters against;
+            // embedding happens on the copy handed to the band
+            uint8_t* dst = &band.rows[k * row_bytes];
+            std::memcpy(dst, cur.data() + bpp, row_bytes);
+            targets.for_row(row, [&](uint64_t x, uint64_t q) {
+                for (int c = 0; c < 3; ++c) {
+                    uint64_t j = q * 3 + c;
+                    if (j >= span || !plan.mask[j]) continue;
+                    uint8_t& v = dst[x * bpp + 2 - c];  // carrier channels are B, G, R
+                    if (options.mode == EmbedMode::Match) {
+                        if (!((v ^ plan.value[j]) & 1)) continue;
+                        rng ^= rng << 13;
+                        rng ^= rng >> 7;
+                        rng ^= rng << 17;
+                        v = v == 0 ? 1 : v == 255 ? 254 : (rng & 1) ? v + 1 : v - 1;
+                    } else {
+                        v = (uint8_t)((v & ~plan.mask[j]) | plan.value[j]);
+                    }
+                }
+            });
+            std::swap(prev, cur);
+        }
+        above.assign(band.rows.end() - row_bytes, band.rows.end());
+        return true;
+    });
+    inflater.finish();
+
+    writer.raw(png.after.data(), png.after.size());
+    writer.chunk("IEND", nullptr, 0);
+    if (!out_fd) write_all(output, std::move(stdout_bytes));
+    stats.rows = png.height;
+    stats.elapsed_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return stats;
+}
+
+uint64_t png_capacity(const std::string& path, const KernelParams& params) {
+    std::ifstream file(path, std::ios::binary);
+    uint8_t head[33] = {};
+    file.read(reinterpret_cast<char*>(head), sizeof(head));
+    if (file.gcount() != (std::streamsize)sizeof(head) || !is_png(head, 8) || std::memcmp(head + 12, "IHDR", 4))
+        throw std::runtime_error("Not a PNG file");
+    return container_capacity((uint64_t)get32(head + 16) * get32(head + 20) * 3, params);
+}
+
+bool png_try_extract(const BMPImage& img, const std::string& passphrase, std::vector<uint8_t>& message,
+                     ContainerDecodeInfo* info) {
+    if (passphrase.empty()) return container_try_decode(img, passphrase, message, info);
+    const uint64_t channels = img.data.size();
+    if (channels < kContainerHeaderChannels) return false;
+    KeyedBijection order(channels / 3, passphrase);
+    std::vector<uint8_t> prefix = gather_keyed(img, order, std::min<uint64_t>(channels, kContainerMaxHeaderChannels));
+    ContainerHeader header;
+    if (!parse_container_header(prefix.data(), prefix.size(), header)) return false;
+    uint64_t span = container_span(header);
+    if (span > channels) throw std::runtime_error("Message too large or corrupted");
+    std::vector<uint8_t> carrier = gather_keyed(img, order, span);
+    if (info && info->ecc) info->ecc->reset(img.width, img.height);
+    CarrierMap map;
+    map.bijection = &order;
+    return container_try_decode_channels(carrier.data(), carrier.size(), message, info, map);
+}
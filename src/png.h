@@ -0,0 +1,63 @@
+// png.h
+// PNG covers: in-tree inflate/deflate, band-parallel compression, streamed embedding
+#pragma once
+#include "bmp.h"
+#include "container.h"
+#include <string>
+#include <vector>
+
+// Supported files are 8-bit truecolor (RGB) and truecolor with alpha (RGBA),
+// not interlaced. Alpha is carried through by the streaming encoder and
+// dropped when a PNG is loaded into a BMPImage.
+struct PngOptions {
+    unsigned threads = 0;   // deflate workers, 0 = hardware concurrency
+    int band_rows = 64;     // rows per independently compressed band
+    int level = 6;          // match search effort 1..9, as in zlib
+};
+
+struct PngStats {
+    uint64_t rows = 0;
+    uint64_t bands = 0;
+    uint64_t input_bytes = 0;
+    uint64_t output_bytes = 0;
+    double elapsed_ms = 0;
+};
+
+// True when the bytes start with the 8-byte PNG signature. The file variant
+// only sniffs regular files, so stdin and pipes are left unread.
+bool is_png(const uint8_t* bytes, size_t size);
+bool is_png_file(const std::string& path);
+
+// Decodes a whole PNG to top-down BGR pixels. Throws std::runtime_error on
+// unsupported or corrupt files.
+BMPImage decode_png(const uint8_t* bytes, size_t size);
+BMPImage load_png(const std::string& path);
+
+// Encodes pixels as an RGB PNG. Rows are filtered with a per-row filter
+// choice and compressed in bands on `options.threads` workers; each band is
+// an independent run of deflate blocks, so the bands concatenate into one
+// zlib stream (as pigz does). "-" writes to stdout.
+std::vector<uint8_t> encode_png(const BMPImage& image, const PngOptions& options = PngOptions());
+void write_png(const std::string& path, const BMPImage& image, const PngOptions& options = PngOptions());
+
+// Covers by content (PNG or BMP) and outputs by extension (".png" or BMP),
+// for commands that accept either. "-" stays BMP.
+BMPImage load_cover(const std::string& path);
+void write_cover(const std::string& path, const BMPImage& image, const PngOptions& png = PngOptions());
+
+// Embeds a container while streaming `input` to `output`: scanlines are
+// inflated, unfiltered, embedded, refiltered and handed to the deflate
+// workers band by band, so only a few bands are ever in memory. Unkeyed
+// carriers are the channels in BMPImage order, as in container_encode.
+// Keyed carriers visit pixels in KeyedBijection order instead of the
+// prng_permutation order, which would need a table as large as the image;
+// decode_message_file tries both. Throws std::runtime_error on error.
+PngStats png_embed(const std::string& input, const std::string& output, const std::vector<uint8_t>& message,
+                   const ContainerOptions& options, const PngOptions& png = PngOptions());
+
+// Message bytes a streamed container can carry.
+uint64_t png_capacity(const std::string& path, const KernelParams& params);
+
+// Decodes a container written by png_embed from decoded pixels.
+bool png_try_extract(const BMPImage& img, const std::string& passphrase, std::vector<uint8_t>& message,
+                     ContainerDecodeInfo* info = nullptr);
@@ -0,0 +1,96 @@
+// preview.cpp
+// Downsampled RGBA previews of a cover and of its LSB plane
+#include "preview.h"
+#include <algorithm>
+
+namespace {
+
+// First source column (or row) of each preview column, plus the end.
+std::vector<int> block_starts(int src, int dst) {
+    std::vector<int> starts(dst + 1);
+    for (int i = 0; i <= dst; ++i) starts[i] = (int)((int64_t)i * src / dst);
+    return starts;
+}
+
+// Sums one value per channel over each preview pixel's source block and
+// writes sum / count through `finish`. `value(index)` reads a source channel.
+template <typename Value, typename Finish>
+void box_rows(const BMPImage& img, PreviewImage& out, int row_begin, int row_end, Value value, Finish finish) {
+    auto xs = block_starts(img.width, out.width);
+    auto ys = block_starts(img.height, out.height);
+    std::vector<uint32_t> sums((size_t)out.width * 3);
+    for (int oy = row_begin; oy < row_end; ++oy) {
+        std::fill(sums.begin(), sums.end(), 0);
+        int y0 = ys[oy], y1 = std::max(ys[oy + 1], y0 + 1);
+        for (int sy = y0; sy < y1; ++sy) {
+            size_t row = (size_t)sy * img.width * 3;
+            for (int ox = 0; ox < out.width; ++ox) {
+                uint32_t b = 0, g = 0, r = 0;
+                int x1 = std::max(xs[ox + 1], xs[ox] + 1);
+                for (size_t i = row + (size_t)xs[ox] * 3, end = row + (size_t)x1 * 3; i < end; i += 3) {
+                    b += value(i);
+                    g += value(i + 1);
+                    r += value(i + 2);
+                }
+                sums[ox * 3] += b;
+                sums[ox * 3 + 1] += g;
+                sums[ox * 3 + 2] += r;
+            }
+        }
+        uint8_t* dst = &out.rgba[(size_t)oy * out.width * 4];
+        for (int ox = 0; ox < out.width; ++ox) {
+            uint32_t count = (uint32_t)(std::max(xs[ox + 1], xs[ox] + 1) - xs[ox]) * (uint32_t)(y1 - y0);
+            dst[ox * 4] = finish(sums[ox * 3 + 2], count);
+            dst[ox * 4 + 1] = finish(sums[ox * 3 + 1], count);
+            dst[ox * 4 + 2] = finish(sums[ox * 3], count);
+            dst[ox * 4 + 3] = 255;
+        }
+    }
+}
+
+} // namespace
+
+PreviewImage make_preview(int src_width, int src_height, int max_side) {
+    PreviewImage p;
+    int longest = std::max(src_width, src_height);
+    if (longest <= max_side) {
+        p.width = src_width;
+        p.height = src_height;
+    } else {
+        p.width = std::max(1, (int)((int64_t)src_width * max_side / longest));
+        p.height = std::max(1, (int)((int64_t)src_height * max_side / longest));
+    }
+    p.rgba.assign((size_t)p.width * p.height * 4, 0);
+    return p;
+}
+
+void downsample_rows(const BMPImage& img, PreviewImage& out, int row_begin, int row_end) {
+    const uint8_t* data = img.data.data();
+    box_rows(img, out, row_begin, row_end, [data](size_t i) -> uint32_t { return data[i]; },
+             [](uint32_t sum, uint32_t count) { return (uint8_t)(sum / count); });
+}
+
+std::vector<uint64_t> pack_lsbs(const BMPImage& img) {
+    std::vector<uint64_t> bits((img.data.size() + 63) / 64);
+    for (size_t w = 0; w < bits.size(); ++w) {
+        size_t base = w * 64, n = std::min<size_t>(64, img.data.size() - base);
+        uint64_t word = 0;
+        for (size_t k = 0; k < n; ++k) word |= (uint64_t)(img.data[base + k] & 1) << k;
+        bits[w] = word;
+    }
+    return bits;
+}
+
+void lsb_plane_rows(const BMPImage& img, const std::vector<uint64_t>* reference, PreviewImage& out,
+                    int row_begin, int row_end) {
+    const uint8_t* data = img.data.data();
+    if (!reference) {
+        box_rows(img, out, row_begin, row_end, [data](size_t i) -> uint32_t { return data[i] & 1; },
+                 [](uint32_t sum, uint32_t count) { return (uint8_t)(sum * 255 / count); });
+        return;
+    }
+    const uint64_t* ref = reference->data();
+    box_rows(img, out, row_begin, row_end,
+             [data, ref](size_t i) -> uint32_t { return (data[i] ^ (uint32_t)(ref[i / 64] >> (i % 64))) & 1; },
+             [](uint32_t sum, uint32_t count) { return (uint8_t)(sum ? 64 + sum * 191 / count : 0); });
+}
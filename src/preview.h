@@ -0,0 +1,30 @@
+// preview.h
+// Downsampled RGBA previews of a cover and of its LSB plane
+#pragma once
+#include "bmp.h"
+#include <cstdint>
+#include <vector>
+
+// Top-down RGBA8, ready for a texture upload.
+struct PreviewImage {
+    int width = 0;
+    int height = 0;
+    std::vector<uint8_t> rgba;
+};
+
+// Allocates a preview of the image scaled to fit max_side (never upscaled).
+PreviewImage make_preview(int src_width, int src_height, int max_side);
+
+// Box-filters the source pixels behind preview rows [row_begin, row_end).
+// Rows are independent, so callers can fill a preview band by band.
+void downsample_rows(const BMPImage& img, PreviewImage& out, int row_begin, int row_end);
+
+// Packs the LSB of every channel, 64 channels per word.
+std::vector<uint64_t> pack_lsbs(const BMPImage& img);
+
+// Amplified LSB view for preview rows [row_begin, row_end). Without a
+// reference each channel shows the share of set LSBs behind it; with the
+// cover's pack_lsbs() it shows changed LSBs, brightened so that a single
+// change in a block is visible.
+void lsb_plane_rows(const BMPImage& img, const std::vector<uint64_t>* reference, PreviewImage& out,
+                    int row_begin, int row_end);
@@ -4,6 +4,7 @@
 #include <random>
 #include <algorithm>
 #include <functional>
+#include <stdexcept>
 
 // Simple hash for passphrase to seed
 static uint32_t hash_passphrase(const std::string& pass) {
@@ -15,10 +16,142 @@ static uint32_t hash_passphrase(const std::string& pass) {
     return h;
 }
 
-std::vector<size_t> prng_permutation(size_t n, const std::string& passphrase) {
-    std::vector<size_t> perm(n);
+// Same swaps as std::shuffle(perm, rng), so keyed layouts are unchanged.
+// Each swap touches a random entry of the table, a cache miss once it
+// outgrows the caches; the swap positions depend only on the generator, so
+// they are drawn a batch ahead and their entries prefetched. Ranges small
+// enough for std::shuffle's two-positions-per-draw path go to std::shuffle.
+static void shuffle_permutation(Permutation& perm, std::mt19937& rng) {
+    const uint64_t n = perm.size();
+    const uint64_t rng_range = rng.max() - rng.min();
+    if (n < 2 || rng_range / n >= n) {
+        std::shuffle(perm.begin(), perm.end(), rng);
+        return;
+    }
+    constexpr size_t kAhead = 32;
+    std::uniform_int_distribution<size_t> dist;
+    size_t* p = perm.data();
+    size_t targets[kAhead];
+    for (size_t i = 1; i < n; i += kAhead) {
+        size_t batch = std::min<size_t>(kAhead, n - i);
+        for (size_t k = 0; k < batch; ++k) {
+            targets[k] = dist(rng, decltype(dist)::param_type(0, i + k));
+            __builtin_prefetch(p + targets[k], 1);
+        }
+        for (size_t k = 0; k < batch; ++k) std::swap(p[i + k], p[targets[k]]);
+    }
+}
+
+Permutation prng_permutation(size_t n, const std::string& passphrase) {
+    Permutation perm(n);
     for (size_t i = 0; i < n; ++i) perm[i] = i;
     std::mt19937 rng(hash_passphrase(passphrase));
-    std::shuffle(perm.begin(), perm.end(), rng);
+    shuffle_permutation(perm, rng);
     return perm;
 }
+
+Permutation prng_permutation(size_t n, const std::string& passphrase, uint64_t stream) {
+    Permutation perm(n);
+    for (size_t i = 0; i < n; ++i) perm[i] = i;
+    std::seed_seq seed{hash_passphrase(passphrase), (uint32_t)stream, (uint32_t)(stream >> 32)};
+    std::mt19937 rng(seed);
+    shuffle_permutation(perm, rng);
+    return perm;
+}
+
+std::vector<uint8_t> apply_permutation(const std::vector<uint8_t>& data, const Permutation& perm) {
+    std::vector<uint8_t> out;
+    resize_large(out, data.size());
+    for (size_t i = 0; i < data.size(); ++i) out[i] = data[perm[i]];
+    return out;
+}
+
+std::vector<uint8_t> invert_permutation(const std::vector<uint8_t>& data, const Permutation& perm) {
+    std::vector<uint8_t> out;
+    resize_large(out, data.size());
+    for (size_t i = 0; i < data.size(); ++i) out[perm[i]] = data[i];
+    return out;
+}
+
+std::vector<uint8_t> apply_pixel_permutation(const std::vector<uint8_t>& data, const Permutation& perm) {
+    std::vector<uint8_t> out;
+    resize_large(out, data.size());
+    for (size_t i = 0; i < perm.size(); ++i) {
+        const uint8_t* src = &data[perm[i] * 3];
+        out[i * 3] = src[0];
+        out[i * 3 + 1] = src[1];
+        out[i * 3 + 2] = src[2];
+    }
+    return out;
+}
+
+std::vector<uint8_t> invert_pixel_permutation(const std::vector<uint8_t>& data, const Permutation& perm) {
+    std::vector<uint8_t> out;
+    resize_large(out, data.size());
+    for (size_t i = 0; i < perm.size(); ++i) {
+        uint8_t* dst = &out[perm[i] * 3];
+        dst[0] = data[i * 3];
+        dst[1] = data[i * 3 + 1];
+        dst[2] = data[i * 3 + 2];
+    }
+    return out;
+}
+
+static uint64_t mix64(uint64_t z) {
+    z += 0x9E3779B97F4A7C15ull;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+KeyedBijection::KeyedBijection(uint64_t n, const std::string& passphrase, uint64_t stream) : n_(n) {
+    if (n == 0) throw std::runtime_error("Keyed bijection needs a non-empty domain");
+    int bits = 0;
+    while (bits < 64 && (1ull << bits) < n) ++bits;
+    half_bits_ = (bits + 1) / 2;
+    if (half_bits_ == 0) half_bits_ = 1;
+    half_mask_ = (1ull << half_bits_) - 1;
+    uint64_t state = mix64(((uint64_t)hash_passphrase(passphrase) << 32) ^ mix64(stream));
+    for (auto& k : keys_) k = state = mix64(state);
+}
+
+uint64_t KeyedBijection::round(int r, uint64_t half) const {
+    return mix64(keys_[r] ^ half) & half_mask_;
+}
+
+uint64_t KeyedBijection::encrypt(uint64_t x) const {
+    uint64_t left = x >> half_bits_, right = x & half_mask_;
+    for (int r = 0; r < kRounds; ++r) {
+        uint64_t next = left ^ round(r, right);
+        left = right;
+        right = next;
+    }
+    return (left << half_bits_) | right;
+}
+
+uint64_t KeyedBijection::decrypt(uint64_t x) const {
+    uint64_t left = x >> half_bits_, right = x & half_mask_;
+    for (int r = kRounds - 1; r >= 0; --r) {
+        uint64_t prev = right ^ round(r, left);
+        right = left;
+        left = prev;
+    }
+    return (left << half_bits_) | right;
+}
+
+// Cycle-walking: the domain is at most 4n, so this loops a few times on average.
+uint64_t KeyedBijection::forward(uint64_t i) const {
+    uint64_t x = encrypt(i);
+    while (x >= n_) x = encrypt(x);
+    return x;
+}
+
+uint64_t KeyedBijection::inverse(uint64_t p) const {
+    uint64_t x = decrypt(p);
+    while (x >= n_) x = decrypt(x);
+    return x;
+}
+
+uint64_t keyed_hash(const std::string& passphrase, uint64_t value) {
+    return mix64(mix64(((uint64_t)hash_passphrase(passphrase) << 32) ^ 0x736C6F74ull) ^ value);
+}
@@ -1,9 +1,57 @@
 // prng_permute.h
 // Passphrase-based PRNG permutation for channel order
 #pragma once
+#include "buffers.h"
 #include <string>
 #include <vector>
 #include <cstdint>
 
+// Permutation tables are 8 bytes per entry and read in random order, so they
+// live in large-buffer storage (huge pages, local NUMA node).
+using Permutation = std::vector<size_t, LargeAllocator<size_t>>;
+
 // Generates a permutation of indices [0, n) using a passphrase-based PRNG
-std::vector<size_t> prng_permutation(size_t n, const std::string& passphrase);
+Permutation prng_permutation(size_t n, const std::string& passphrase);
+
+// Independent permutation for sub-stream `stream` (e.g. a band or frame index),
+// so each region of a cover can be ordered without the others.
+Permutation prng_permutation(size_t n, const std::string& passphrase, uint64_t stream);
+
+// Gathers channels into passphrase order: out[i] = data[perm[i]].
+// Logical channel i of a keyed image lives at physical index perm[i].
+std::vector<uint8_t> apply_permutation(const std::vector<uint8_t>& data, const Permutation& perm);
+
+// Inverse of apply_permutation: out[perm[i]] = data[i].
+std::vector<uint8_t> invert_permutation(const std::vector<uint8_t>& data, const Permutation& perm);
+
+// Pixel-granular variants: whole 3-byte pixels move together, so channel
+// positions within a pixel (B, G, R) are preserved. `perm` has one entry per pixel.
+std::vector<uint8_t> apply_pixel_permutation(const std::vector<uint8_t>& data, const Permutation& perm);
+std::vector<uint8_t> invert_pixel_permutation(const std::vector<uint8_t>& data, const Permutation& perm);
+
+// Keyed bijection on [0, n) evaluated one index at a time in O(1), for when
+// only a few positions of a huge keyed order are needed. A balanced Feistel
+// network permutes the enclosing power-of-four domain and cycle-walks values
+// that fall outside [0, n).
+class KeyedBijection {
+public:
+    KeyedBijection(uint64_t n, const std::string& passphrase, uint64_t stream = 0);
+
+    uint64_t size() const { return n_; }
+    uint64_t forward(uint64_t i) const;  // i-th position in keyed order
+    uint64_t inverse(uint64_t p) const;  // forward(inverse(p)) == p
+
+private:
+    static constexpr int kRounds = 6;
+    uint64_t round(int r, uint64_t half) const;
+    uint64_t encrypt(uint64_t x) const;
+    uint64_t decrypt(uint64_t x) const;
+
+    uint64_t n_;
+    int half_bits_ = 0;
+    uint64_t half_mask_ = 0;
+    uint64_t keys_[kRounds];
+};
+
+// 64-bit keyed hash of `value`, e.g. for per-position tags.
+uint64_t keyed_hash(const std::string& passphrase, uint64_t value);
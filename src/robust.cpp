@@ -0,0 +1,247 @@
+// robust.cpp
+// Self-synchronizing embedding: row-local blocks that survive cropping and lost rows
+#include "robust.h"
+#include "container.h"
+#include "mapped_file.h"
+#include "parallel.h"
+#include "prng_permute.h"
+#include "stream_io.h"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <numeric>
+#include <stdexcept>
+
+namespace {
+
+using BlockKernel = kernels::LsbKernel<1, 0x7, BitOrder::MsbFirst, EccType::None>;
+
+constexpr size_t kSyncBits = 32;
+constexpr size_t kBodyBytes = kRobustBlockBytes - 4;
+
+struct Block {
+    uint32_t index = 0;
+    uint32_t count = 0;
+    uint32_t length = 0;
+    std::array<uint8_t, kRobustChunkBytes> data{};
+};
+
+// Sync word and body whitening derived from the passphrase
+struct BlockKeys {
+    uint32_t sync = 0;
+    uint8_t whitening[kBodyBytes];
+
+    explicit BlockKeys(const std::string& passphrase) {
+        // Never all zeros or all ones, so flat regions (LSBs of a solid
+        // colour) cannot match it
+        sync = (uint32_t)keyed_hash(passphrase, 0x73796E63) | 0x80000001u;
+        for (size_t i = 0; i < kBodyBytes; ++i)
+            whitening[i] = (uint8_t)(keyed_hash(passphrase, 1 + i / 8) >> (8 * (i % 8)));
+    }
+};
+
+void put32(uint8_t* out, uint32_t v) {
+    out[0] = (uint8_t)(v >> 24);
+    out[1] = (uint8_t)(v >> 16);
+    out[2] = (uint8_t)(v >> 8);
+    out[3] = (uint8_t)v;
+}
+
+uint32_t get32(const uint8_t* in) {
+    return ((uint32_t)in[0] << 24) | ((uint32_t)in[1] << 16) | ((uint32_t)in[2] << 8) | in[3];
+}
+
+void build_block(const BlockKeys& keys, const Block& block, uint8_t out[kRobustBlockBytes]) {
+    put32(out, keys.sync);
+    put32(out + 4, block.index);
+    put32(out + 8, block.count);
+    put32(out + 12, block.length);
+    std::memcpy(out + 16, block.data.data(), kRobustChunkBytes);
+    uint16_t crc = crc16_ccitt(out + 4, kRobustBlockBytes - 6);
+    out[kRobustBlockBytes - 2] = (uint8_t)(crc >> 8);
+    out[kRobustBlockBytes - 1] = (uint8_t)crc;
+    for (size_t i = 0; i < kBodyBytes; ++i) out[4 + i] ^= keys.whitening[i];
+}
+
+bool parse_block(const BlockKeys& keys, uint8_t bytes[kRobustBlockBytes], Block& block) {
+    for (size_t i = 0; i < kBodyBytes; ++i) bytes[4 + i] ^= keys.whitening[i];
+    uint16_t crc = (uint16_t)((bytes[kRobustBlockBytes - 2] << 8) | bytes[kRobustBlockBytes - 1]);
+    if (crc16_ccitt(bytes + 4, kRobustBlockBytes - 6) != crc) return false;
+    block.index = get32(bytes + 4);
+    block.count = get32(bytes + 8);
+    block.length = get32(bytes + 12);
+    uint64_t chunks = std::max<uint64_t>(1, ((uint64_t)block.length + kRobustChunkBytes - 1) / kRobustChunkBytes);
+    if (block.count != chunks || block.index >= block.count) return false;
+    std::memcpy(block.data.data(), bytes + 16, kRobustChunkBytes);
+    return true;
+}
+
+// Slides a 32-bit window over the LSBs of one row and collects the blocks
+// behind every sync whose CRC checks. LSBs enter the window eight channels
+// at a time (one multiply packs a word's low bits into a byte), and the
+// eight alignments that byte completes are compared against the sync. After
+// a good block the scan resumes at its end; a false sync costs one CRC.
+void scan_row(const uint8_t* row, size_t n, const BlockKeys& keys, std::vector<Block>& out, uint64_t& hits) {
+    uint64_t window = 0; // LSBs of the `filled` channels before i, newest lowest
+    size_t filled = 0;
+    // A sync ending in the last few channels has no room for its block, so
+    // the partial word at the end of the row is never needed
+    for (size_t i = 0; i + 8 <= n;) {
+        uint64_t word;
+        std::memcpy(&word, row + i, 8);
+        window = (window << 8) | (((word & kernels::kByteOnes) * 0x8040201008040201ull) >> 56);
+        i += 8;
+        filled += 8;
+        // Alignment s is a sync ending at channel i - 1 - s; earliest first
+        for (int s = 7; s >= 0; --s) {
+            if ((uint32_t)(window >> s) != keys.sync || filled < kSyncBits + s) continue;
+            ++hits;
+            size_t start = i - s - kSyncBits;
+            if (start + kRobustBlockChannels > n) return;
+            uint8_t bytes[kRobustBlockBytes];
+            BlockKernel::extract(row + start, kRobustBlockChannels, bytes, kRobustBlockBytes);
+            Block block;
+            if (!parse_block(keys, bytes, block)) continue;
+            out.push_back(block);
+            i = start + kRobustBlockChannels;
+            filled = 0;
+            window = 0;
+            break;
+        }
+    }
+}
+
+// Scans `rows` rows of `row_bytes` channels, `stride` bytes apart, and
+// reassembles the message from the blocks found.
+std::vector<uint8_t> decode_rows(const uint8_t* base, uint64_t stride, size_t row_bytes, uint64_t rows,
+                                 const RobustOptions& options, RobustDecodeStats* stats) {
+    auto start = std::chrono::steady_clock::now();
+    BlockKeys keys(options.passphrase);
+    std::vector<Block> blocks;
+    uint64_t hits = 0;
+    std::mutex mutex;
+    parallel_for(rows, options.threads, [&](size_t begin, size_t end) {
+        std::vector<Block> local;
+        uint64_t local_hits = 0;
+        for (size_t r = begin; r < end; ++r) scan_row(base + r * stride, row_bytes, keys, local, local_hits);
+        std::lock_guard<std::mutex> lock(mutex);
+        blocks.insert(blocks.end(), local.begin(), local.end());
+        hits += local_hits;
+    });
+
+    RobustDecodeStats result;
+    result.rows = rows;
+    result.sync_hits = hits;
+    result.valid_blocks = blocks.size();
+    std::vector<uint8_t> message;
+    if (!blocks.empty()) {
+        // A stray block passing the CRC by chance must not decide the layout
+        std::map<std::pair<uint32_t, uint32_t>, uint64_t> votes;
+        for (const Block& b : blocks) ++votes[{b.count, b.length}];
+        auto best = votes.begin();
+        for (auto it = votes.begin(); it != votes.end(); ++it)
+            if (it->second > best->second) best = it;
+        uint32_t count = best->first.first, length = best->first.second;
+
+        std::vector<bool> have(count, false);
+        message.assign((size_t)count * kRobustChunkBytes, 0);
+        for (const Block& b : blocks) {
+            if (b.count != count || b.length != length || have[b.index]) continue;
+            have[b.index] = true;
+            std::memcpy(&message[(size_t)b.index * kRobustChunkBytes], b.data.data(), kRobustChunkBytes);
+            ++result.chunks_recovered;
+        }
+        result.chunks = count;
+        message.resize(length);
+    }
+    result.elapsed_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    if (stats) *stats = result;
+
+    if (blocks.empty()) throw std::runtime_error("No robust blocks found (wrong passphrase or not a robust image)");
+    if (result.chunks_recovered < result.chunks)
+        throw std::runtime_error("Recovered only " + std::to_string(result.chunks_recovered) + " of " +
+                                 std::to_string(result.chunks) + " chunks; too much of the image is missing");
+    return message;
+}
+
+std::vector<uint8_t> decode_file_bytes(const uint8_t* bytes, size_t size, const RobustOptions& options,
+                                       RobustDecodeStats* stats) {
+    BMPInfo info = parse_bmp_headers(bytes, size);
+    if (size < info.data_offset) throw std::runtime_error("Truncated BMP header");
+    uint64_t rows = std::min<uint64_t>(info.height, (size - info.data_offset) / info.row_stride);
+    return decode_rows(bytes + info.data_offset, info.row_stride, (size_t)info.width * 3, rows, options, stats);
+}
+
+} // namespace
+
+uint64_t robust_slots(int width, int height) {
+    return (uint64_t)width * 3 / kRobustBlockChannels * (uint64_t)height;
+}
+
+uint64_t robust_capacity(int width, int height) {
+    return std::min<uint64_t>(robust_slots(width, height) * kRobustChunkBytes, 0xFFFFFFFFull);
+}
+
+RobustEncodeStats robust_encode(BMPImage& img, const std::vector<uint8_t>& message, const RobustOptions& options) {
+    const size_t row_bytes = (size_t)img.width * 3;
+    RobustEncodeStats stats;
+    stats.blocks_per_row = row_bytes / kRobustBlockChannels;
+    if (!stats.blocks_per_row)
+        throw std::runtime_error("Image too narrow for robust blocks (needs " +
+                                 std::to_string((kRobustBlockChannels + 2) / 3) + " pixels per row)");
+    uint64_t cap = robust_capacity(img.width, img.height);
+    if (message.size() > cap)
+        throw std::runtime_error("Message too large for image (capacity: " + std::to_string(cap) + " bytes)");
+    stats.chunks = std::max<uint64_t>(1, (message.size() + kRobustChunkBytes - 1) / kRobustChunkBytes);
+    stats.slots = stats.blocks_per_row * (uint64_t)img.height;
+
+    BlockKeys keys(options.passphrase);
+    std::vector<uint8_t> blocks(stats.chunks * kRobustBlockBytes);
+    for (uint64_t c = 0; c < stats.chunks; ++c) {
+        Block block;
+        block.index = (uint32_t)c;
+        block.count = (uint32_t)stats.chunks;
+        block.length = (uint32_t)message.size();
+        size_t offset = (size_t)c * kRobustChunkBytes;
+        if (offset < message.size())
+            std::memcpy(block.data.data(), &message[offset], std::min(kRobustChunkBytes, message.size() - offset));
+        build_block(keys, block, &blocks[c * kRobustBlockBytes]);
+    }
+
+    // Row r starts `step` chunks after row r-1. A step coprime to the chunk
+    // count walks every chunk through every column, so cropping to a few
+    // columns still leaves each chunk in some row.
+    uint64_t step = stats.blocks_per_row % stats.chunks;
+    while (std::gcd(step, stats.chunks) != 1) ++step;
+    for (uint64_t r = 0; r < (uint64_t)img.height; ++r) {
+        uint64_t first = (r % stats.chunks) * step % stats.chunks;
+        for (uint64_t j = 0; j < stats.blocks_per_row; ++j) {
+            const uint8_t* block = &blocks[(first + j) % stats.chunks * kRobustBlockBytes];
+            uint8_t* at = img.data.data() + r * row_bytes + j * kRobustBlockChannels;
+            if (options.mode == EmbedMode::Match)
+                BlockKernel::embed_matching(at, kRobustBlockChannels, block, kRobustBlockBytes,
+                                            keyed_hash(options.passphrase, ~(r * stats.blocks_per_row + j)));
+            else
+                BlockKernel::embed(at, kRobustBlockChannels, block, kRobustBlockBytes);
+        }
+    }
+    return stats;
+}
+
+std::vector<uint8_t> robust_decode(const BMPImage& img, const RobustOptions& options, RobustDecodeStats* stats) {
+    size_t row_bytes = (size_t)img.width * 3;
+    return decode_rows(img.data.data(), row_bytes, row_bytes, (uint64_t)img.height, options, stats);
+}
+
+std::vector<uint8_t> robust_decode_file(const std::string& path, const RobustOptions& options,
+                                        RobustDecodeStats* stats) {
+    if (is_std_stream(path)) {
+        std::vector<uint8_t> bytes = read_all(path);
+        return decode_file_bytes(bytes.data(), bytes.size(), options, stats);
+    }
+    MappedFile file(path, MappedFile::Mode::ReadOnly);
+    return decode_file_bytes(file.data(), file.size(), options, stats);
+}
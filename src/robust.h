@@ -0,0 +1,62 @@
+// robust.h
+// Self-synchronizing embedding: row-local blocks that survive cropping and lost rows
+#pragma once
+#include "bmp.h"
+#include "kernels.h"
+#include <string>
+#include <vector>
+
+// Each image row carries back-to-back blocks of 400 channels at 1 bit per
+// channel, none crossing a row edge:
+//   sync (32) | chunk index (32) | chunk count (32) | message length (32) |
+//   32 data bytes | CRC-16/CCITT (16)
+// Everything after the sync is whitened with a passphrase keystream. Chunks
+// repeat cyclically over all block slots and rotate from row to row, so a
+// narrow crop still holds every chunk in some row. The decoder slides a
+// 32-bit window over each row's LSBs, so blocks are found wherever a crop
+// moved them, and keeps every block whose CRC checks.
+constexpr size_t kRobustChunkBytes = 32;
+constexpr size_t kRobustBlockBytes = 4 + 12 + kRobustChunkBytes + 2;
+constexpr size_t kRobustBlockChannels = kRobustBlockBytes * 8;
+
+struct RobustOptions {
+    std::string passphrase;
+    EmbedMode mode = EmbedMode::Replace;
+    unsigned threads = 0; // decode only; 0 = hardware concurrency
+};
+
+struct RobustEncodeStats {
+    uint64_t chunks = 0;       // distinct chunks in the message
+    uint64_t slots = 0;        // blocks written
+    uint64_t blocks_per_row = 0;
+
+    double repetition() const { return chunks ? (double)slots / chunks : 0; }
+};
+
+struct RobustDecodeStats {
+    uint64_t rows = 0;           // whole rows available for scanning
+    uint64_t sync_hits = 0;      // positions matching the sync pattern
+    uint64_t valid_blocks = 0;   // blocks with a good CRC
+    uint64_t chunks = 0;         // chunk count recorded in the blocks
+    uint64_t chunks_recovered = 0;
+    double elapsed_ms = 0;
+};
+
+// Blocks that fit in the image, and message bytes with one copy of each chunk.
+uint64_t robust_slots(int width, int height);
+uint64_t robust_capacity(int width, int height);
+
+// Embeds `message` in every block slot. Throws std::runtime_error when it
+// does not fit at least once or the image is narrower than one block.
+RobustEncodeStats robust_encode(BMPImage& img, const std::vector<uint8_t>& message, const RobustOptions& options);
+
+// Recovers the message from whatever blocks survive. Throws
+// std::runtime_error when no block is found or chunks are missing.
+std::vector<uint8_t> robust_decode(const BMPImage& img, const RobustOptions& options,
+                                   RobustDecodeStats* stats = nullptr);
+
+// Same, straight from a BMP file whose pixel data may be cut short: only the
+// header must be intact and every complete stored row is scanned. "-" reads
+// stdin.
+std::vector<uint8_t> robust_decode_file(const std::string& path, const RobustOptions& options,
+                                        RobustDecodeStats* stats = nullptr);
@@ -0,0 +1,279 @@
+// scan.cpp
+// Finds images carrying thousandflicks payloads across directory trees
+#include "scan.h"
+#include "bmp.h"
+#include "file_io.h"
+#include "hamming.h"
+#include "lsb.h"
+#include "parallel.h"
+#include "prng_permute.h"
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <filesystem>
+#include <future>
+#include <map>
+#include <mutex>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// Legacy images store a 32-bit length and then one Hamming codeword per
+// byte; this many codewords are checked before calling a file a match.
+constexpr size_t kLegacyCodewords = 8;
+constexpr size_t kLegacyChannels = 32 + kLegacyCodewords * 8;
+constexpr size_t kProbeChannels = std::max(kContainerMaxHeaderChannels, kLegacyChannels);
+// The first read also covers top-down pixel data that starts right after the headers
+constexpr size_t kFirstRead = 4096;
+// Separate channel reads closer than this are merged into one pread
+constexpr uint64_t kCoalesceGap = 4096;
+
+bool is_bmp_name(const fs::path& path) {
+    std::string ext = path.extension().string();
+    for (char& c : ext) c = (char)std::tolower((unsigned char)c);
+    return ext == ".bmp" || ext == ".dib";
+}
+
+// Keyed scans need the first few entries of a permutation that depends only
+// on its length, so prefixes are computed once per image size and shared.
+// Pixel prefixes follow the container order, which skips the table for
+// large covers.
+class PrefixCache {
+public:
+    PrefixCache(std::string passphrase, size_t prefix, bool pixels)
+        : passphrase_(std::move(passphrase)), prefix_(prefix), pixels_(pixels) {}
+
+    std::vector<size_t> get(size_t n) {
+        std::shared_future<std::vector<size_t>> entry;
+        std::promise<std::vector<size_t>> promise;
+        bool owner = false;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto it = entries_.find(n);
+            if (it == entries_.end()) {
+                entry = promise.get_future().share();
+                entries_.emplace(n, entry);
+                owner = true;
+            } else {
+                entry = it->second;
+            }
+        }
+        if (owner) {
+            try {
+                if (pixels_) {
+                    std::vector<uint64_t> order = container_keyed_pixels(n, passphrase_, prefix_);
+                    promise.set_value(std::vector<size_t>(order.begin(), order.end()));
+                } else {
+                    // Copy out the prefix so the full table is released
+                    Permutation perm = prng_permutation(n, passphrase_);
+                    promise.set_value(std::vector<size_t>(perm.begin(), perm.begin() + std::min(prefix_, perm.size())));
+                }
+            } catch (...) {
+                promise.set_exception(std::current_exception());
+            }
+        }
+        return entry.get();
+    }
+
+private:
+    std::string passphrase_;
+    size_t prefix_;
+    bool pixels_;
+    std::mutex mutex_;
+    std::map<size_t, std::shared_future<std::vector<size_t>>> entries_;
+};
+
+// Reads the bytes at `offsets` (any order) with as few preads as possible.
+// `first` holds the first bytes of the file, already read.
+void gather_bytes(int fd, const std::vector<uint64_t>& offsets, const std::vector<uint8_t>& first,
+                  std::vector<uint8_t>& out, uint64_t& bytes_read) {
+    out.assign(offsets.size(), 0);
+    std::vector<size_t> order;
+    for (size_t i = 0; i < offsets.size(); ++i) {
+        if (offsets[i] < first.size()) out[i] = first[offsets[i]];
+        else order.push_back(i);
+    }
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return offsets[a] < offsets[b]; });
+    std::vector<uint8_t> run;
+    for (size_t k = 0; k < order.size();) {
+        uint64_t begin = offsets[order[k]];
+        size_t last = k;
+        while (last + 1 < order.size() && offsets[order[last + 1]] - offsets[order[last]] <= kCoalesceGap) ++last;
+        uint64_t end = offsets[order[last]] + 1;
+        run.resize(end - begin);
+        pread_full(fd, run.data(), run.size(), begin);
+        bytes_read += run.size();
+        for (; k <= last; ++k) out[order[k]] = run[offsets[order[k]] - begin];
+    }
+}
+
+bool legacy_plausible(const uint8_t* channels, const BMPInfo& info, uint64_t& coded_length) {
+    uint64_t length = 0;
+    for (size_t i = 0; i < 32; ++i) length = (length << 1) | (channels[i] & 1);
+    if (length < 2 || length % 2 || length > lsb_capacity(info)) return false;
+    size_t check = (size_t)std::min<uint64_t>(length, kLegacyCodewords);
+    for (size_t b = 0; b < check; ++b) {
+        uint8_t cw = 0;
+        for (int k = 0; k < 8; ++k) cw = (uint8_t)((cw << 1) | (channels[32 + b * 8 + k] & 1));
+        bool corrected = false;
+        hamming74_decode_codeword(cw, corrected);
+        if ((cw & 0x80) || corrected) return false;
+    }
+    coded_length = length;
+    return true;
+}
+
+struct Scanner {
+    const ScanOptions& options;
+    const std::function<void(const ScanMatch&)>& on_match;
+    PrefixCache pixel_prefixes;   // container: pixel order
+    PrefixCache channel_prefixes; // legacy: channel order
+    std::mutex report_mutex;
+    std::atomic<uint64_t> bmp_files{0}, matches{0}, errors{0}, bytes_read{0};
+
+    Scanner(const ScanOptions& opts, const std::function<void(const ScanMatch&)>& cb)
+        : options(opts), on_match(cb),
+          pixel_prefixes(opts.passphrase, kContainerMaxHeaderChannels / 3, true),
+          channel_prefixes(opts.passphrase, kLegacyChannels, false) {}
+
+    void report(const ScanMatch& match) {
+        ++matches;
+        std::lock_guard<std::mutex> lock(report_mutex);
+        on_match(match);
+    }
+
+    void scan_file(const std::string& path) {
+        FileDescriptor fd;
+        try {
+            fd = open_for_read(path);
+        } catch (const std::exception&) {
+            ++errors;
+            return;
+        }
+        std::vector<uint8_t> first(kFirstRead);
+        ssize_t got = ::pread(fd.get(), first.data(), first.size(), 0);
+        if (got < 0) {
+            ++errors;
+            return;
+        }
+        if (got < (ssize_t)kBmpHeaderBytes) return;
+        first.resize((size_t)got);
+        bytes_read += (uint64_t)got;
+
+        BMPInfo info;
+        try {
+            info = parse_bmp_headers(first.data(), first.size());
+        } catch (const std::exception&) {
+            return; // not a 24-bit BMP
+        }
+        ++bmp_files;
+        uint64_t channels = (uint64_t)info.width * info.height * 3;
+        if (channels < kProbeChannels) return;
+
+        try {
+            uint64_t read = 0;
+            std::vector<uint64_t> offsets;
+            std::vector<uint8_t> probe;
+            if (options.passphrase.empty()) {
+                // Both layouts start at channel 0 when unkeyed
+                for (size_t i = 0; i < kProbeChannels; ++i) offsets.push_back(bmp_channel_offset(info, i));
+            } else {
+                for (size_t p : pixel_prefixes.get(channels / 3))
+                    for (int c = 0; c < 3; ++c) offsets.push_back(bmp_channel_offset(info, p * 3 + c));
+            }
+            gather_bytes(fd.get(), offsets, first, probe, read);
+
+            ContainerHeader header;
+            if (parse_container_header(probe.data(), kContainerMaxHeaderChannels, header) &&
+                header.length <= select_kernel(header.params).capacity(channels - container_payload_offset(header))) {
+                ScanMatch match{path, ScanMatch::Kind::Container, info.width, info.height, header, header.length};
+                bytes_read += read;
+                report(match);
+                return;
+            }
+            if (options.legacy) {
+                if (!options.passphrase.empty()) {
+                    offsets.clear();
+                    for (size_t i : channel_prefixes.get(channels)) offsets.push_back(bmp_channel_offset(info, i));
+                    gather_bytes(fd.get(), offsets, first, probe, read);
+                }
+                uint64_t coded = 0;
+                if (legacy_plausible(probe.data(), info, coded)) {
+                    ScanMatch match{path, ScanMatch::Kind::Legacy, info.width, info.height, {}, coded / 2};
+                    bytes_read += read;
+                    report(match);
+                    return;
+                }
+            }
+            bytes_read += read;
+        } catch (const std::exception&) {
+            ++errors; // truncated pixel data
+        }
+    }
+};
+
+} // namespace
+
+ScanStats scan_paths(const std::vector<std::string>& roots, const ScanOptions& options,
+                     const std::function<void(const ScanMatch&)>& on_match) {
+    auto start = std::chrono::steady_clock::now();
+    unsigned threads = options.threads ? options.threads : std::max(8u, 4 * default_thread_count());
+    Scanner scanner(options, on_match);
+    BoundedQueue<std::string> paths(4096);
+    PipelineError error;
+    ScanStats stats;
+
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < threads; ++t) {
+        workers.emplace_back([&] {
+            try {
+                std::string path;
+                while (paths.pop(path)) scanner.scan_file(path);
+            } catch (...) {
+                error.fail(paths);
+            }
+        });
+    }
+
+    // The walk runs on the calling thread and feeds the pool
+    try {
+        for (const auto& root : roots) {
+            std::error_code ec;
+            if (fs::is_regular_file(root, ec)) {
+                ++stats.files_seen;
+                paths.push(root);
+                continue;
+            }
+            fs::recursive_directory_iterator it(root, fs::directory_options::skip_permission_denied, ec), end;
+            if (ec) {
+                ++stats.errors;
+                continue;
+            }
+            for (; it != end; it.increment(ec)) {
+                if (ec) {
+                    ++stats.errors;
+                    break;
+                }
+                if (!it->is_regular_file(ec)) continue;
+                if (!options.all_files && !is_bmp_name(it->path())) continue;
+                ++stats.files_seen;
+                if (!paths.push(it->path().string())) break;
+            }
+        }
+    } catch (...) {
+        error.fail(paths);
+    }
+    paths.close();
+    for (auto& w : workers) w.join();
+    error.rethrow();
+
+    stats.bmp_files = scanner.bmp_files;
+    stats.matches = scanner.matches;
+    stats.errors += scanner.errors;
+    stats.bytes_read = scanner.bytes_read;
+    stats.elapsed_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return stats;
+}
@@ -0,0 +1,44 @@
+// scan.h
+// Finds images carrying thousandflicks payloads across directory trees
+#pragma once
+#include "container.h"
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+struct ScanOptions {
+    std::string passphrase;
+    unsigned threads = 0;   // 0 = a few per core; the scan is I/O bound
+    bool all_files = false; // probe every file, not only *.bmp / *.dib
+    bool legacy = true;     // also report likely legacy (headerless) payloads
+};
+
+struct ScanMatch {
+    enum class Kind { Container, Legacy };
+    std::string path;
+    Kind kind = Kind::Container;
+    int width = 0;
+    int height = 0;
+    ContainerHeader header;     // container matches only
+    uint64_t payload_bytes = 0; // message bytes (legacy: Hamming-coded bytes / 2)
+};
+
+struct ScanStats {
+    uint64_t files_seen = 0;
+    uint64_t bmp_files = 0;
+    uint64_t matches = 0;
+    uint64_t errors = 0;     // unreadable files or directories
+    uint64_t bytes_read = 0;
+    double elapsed_ms = 0;
+
+    double files_per_second() const { return elapsed_ms > 0 ? files_seen * 1000.0 / elapsed_ms : 0; }
+};
+
+// Walks files and directories under `roots` on a thread pool. Each file
+// costs one open and a few small preads: the BMP header plus the channel
+// bytes holding the container header (or the legacy length and first
+// codewords). `on_match` is called for each hit, one call at a time, in
+// completion order.
+ScanStats scan_paths(const std::vector<std::string>& roots, const ScanOptions& options,
+                     const std::function<void(const ScanMatch&)>& on_match);
@@ -0,0 +1,439 @@
+// sequence.cpp
+// Frame-sequence covers: numbered BMP frame directories and Y4M streams
+#include "sequence.h"
+#include "bmp.h"
+#include "buffers.h"
+#include "lsb.h"
+#include "parallel.h"
+#include "prng_permute.h"
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr uint64_t kUnknown = std::numeric_limits<uint64_t>::max();
+
+struct Frame {
+    uint64_t index = 0;
+    std::string name;           // file name for directory sequences
+    std::vector<uint8_t> bytes; // frame exactly as stored
+    uint64_t data_offset = 0;   // first carrier byte in `bytes`
+    uint64_t row_channels = 0;  // carrier bytes per stored row
+    uint64_t row_stride = 0;    // stored bytes per row, including padding
+    uint64_t channels = 0;      // carrier bytes in the frame
+
+    uint64_t offset(uint64_t i) const { return data_offset + (i / row_channels) * row_stride + i % row_channels; }
+};
+
+class FrameSource {
+public:
+    virtual ~FrameSource() = default;
+    // Reads the next frame; returns false at the end of the sequence.
+    virtual bool next(Frame& frame) = 0;
+    // First stream bit carried by frame `index`.
+    virtual uint64_t stream_offset(uint64_t index) const = 0;
+    // Total carrier bits when known up front, kUnknown for streams.
+    virtual uint64_t capacity_bits() const { return kUnknown; }
+};
+
+class FrameSink {
+public:
+    virtual ~FrameSink() = default;
+    virtual void write(const Frame& frame) = 0;
+};
+
+// Orders "frame2.bmp" before "frame10.bmp" by comparing digit runs numerically.
+bool natural_less(const std::string& a, const std::string& b) {
+    size_t i = 0, j = 0;
+    while (i < a.size() && j < b.size()) {
+        if (std::isdigit((unsigned char)a[i]) && std::isdigit((unsigned char)b[j])) {
+            size_t ie = i, je = j;
+            while (ie < a.size() && std::isdigit((unsigned char)a[ie])) ++ie;
+            while (je < b.size() && std::isdigit((unsigned char)b[je])) ++je;
+            std::string na = a.substr(i, ie - i), nb = b.substr(j, je - j);
+            na.erase(0, std::min(na.find_first_not_of('0'), na.size()));
+            nb.erase(0, std::min(nb.find_first_not_of('0'), nb.size()));
+            if (na.size() != nb.size()) return na.size() < nb.size();
+            if (na != nb) return na < nb;
+            i = ie;
+            j = je;
+        } else {
+            if (a[i] != b[j]) return a[i] < b[j];
+            ++i;
+            ++j;
+        }
+    }
+    return a.size() - i < b.size() - j;
+}
+
+class BmpDirSource : public FrameSource {
+public:
+    explicit BmpDirSource(const std::string& dir) : dir_(dir) {
+        for (const auto& entry : fs::directory_iterator(dir)) {
+            std::string ext = entry.path().extension().string();
+            std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+            if (entry.is_regular_file() && ext == ".bmp") names_.push_back(entry.path().filename().string());
+        }
+        if (names_.empty()) throw std::runtime_error("No .bmp frames in directory: " + dir);
+        std::sort(names_.begin(), names_.end(), natural_less);
+        // Header-only pass so every frame's stream segment is known before reading pixels
+        offsets_.push_back(0);
+        for (const auto& name : names_) {
+            BMPInfo info = probe_bmp((dir_ / name).string());
+            infos_.push_back(info);
+            offsets_.push_back(offsets_.back() + (uint64_t)info.width * info.height * 3);
+        }
+    }
+
+    bool next(Frame& frame) override {
+        if (next_ >= names_.size()) return false;
+        const BMPInfo& info = infos_[next_];
+        frame.index = next_;
+        frame.name = names_[next_];
+        std::ifstream in(dir_ / frame.name, std::ios::binary);
+        frame.bytes.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        if (frame.bytes.size() < info.file_size) throw std::runtime_error("Truncated BMP frame: " + frame.name);
+        frame.data_offset = info.data_offset;
+        frame.row_channels = (uint64_t)info.width * 3;
+        frame.row_stride = info.row_stride;
+        frame.channels = frame.row_channels * info.height;
+        ++next_;
+        return true;
+    }
+
+    uint64_t stream_offset(uint64_t index) const override {
+        return offsets_[std::min<uint64_t>(index, names_.size())];
+    }
+    uint64_t capacity_bits() const override { return offsets_.back(); }
+
+private:
+    fs::path dir_;
+    std::vector<std::string> names_;
+    std::vector<BMPInfo> infos_;
+    std::vector<uint64_t> offsets_;
+    size_t next_ = 0;
+};
+
+class BmpDirSink : public FrameSink {
+public:
+    explicit BmpDirSink(const std::string& dir) : dir_(dir) { fs::create_directories(dir_); }
+
+    void write(const Frame& frame) override {
+        std::ofstream out(dir_ / frame.name, std::ios::binary);
+        if (!out) throw std::runtime_error("Cannot write frame: " + (dir_ / frame.name).string());
+        out.write(reinterpret_cast<const char*>(frame.bytes.data()), frame.bytes.size());
+    }
+
+private:
+    fs::path dir_;
+};
+
+// Owns a FILE* unless it is stdin/stdout.
+struct StdioFile {
+    std::FILE* file = nullptr;
+    bool owned = false;
+    std::vector<char> buffer = std::vector<char>(1 << 20);
+
+    StdioFile(const std::string& path, bool write) {
+        if (path == "-") {
+            file = write ? stdout : stdin;
+        } else {
+            file = std::fopen(path.c_str(), write ? "wb" : "rb");
+            owned = true;
+        }
+        if (!file) throw std::runtime_error("Cannot open stream: " + path);
+        std::setvbuf(file, buffer.data(), _IOFBF, buffer.size());
+    }
+    ~StdioFile() {
+        if (owned) std::fclose(file);
+        else std::fflush(file);
+    }
+    StdioFile(const StdioFile&) = delete;
+    StdioFile& operator=(const StdioFile&) = delete;
+};
+
+bool read_line(std::FILE* f, std::string& line) {
+    line.clear();
+    int c;
+    while ((c = std::fgetc(f)) != EOF) {
+        line.push_back((char)c);
+        if (c == '\n') return true;
+        if (line.size() > 4096) throw std::runtime_error("Y4M header line too long");
+    }
+    return !line.empty();
+}
+
+class Y4mSource : public FrameSource {
+public:
+    explicit Y4mSource(const std::string& path) : in_(path, false) {
+        if (!read_line(in_.file, header_) || header_.compare(0, 10, "YUV4MPEG2 ") != 0)
+            throw std::runtime_error("Not a YUV4MPEG2 stream");
+        uint64_t width = 0, height = 0;
+        std::string colorspace = "420";
+        std::istringstream tokens(header_.substr(10));
+        std::string tok;
+        while (tokens >> tok) {
+            if (tok[0] == 'W') width = std::stoull(tok.substr(1));
+            else if (tok[0] == 'H') height = std::stoull(tok.substr(1));
+            else if (tok[0] == 'C') colorspace = tok.substr(1);
+        }
+        if (!width || !height) throw std::runtime_error("Y4M header lacks frame dimensions");
+        uint64_t luma = width * height;
+        uint64_t chroma_w = (width + 1) / 2, chroma_h = (height + 1) / 2;
+        // 8-bit planes only: alpha and pNN (high bit depth) variants change
+        // the frame size, and their byte LSBs are not sample LSBs
+        if (colorspace == "420" || colorspace == "420jpeg" || colorspace == "420paldv" || colorspace == "420mpeg2")
+            frame_size_ = luma + 2 * chroma_w * chroma_h;
+        else if (colorspace == "422") frame_size_ = luma + 2 * chroma_w * height;
+        else if (colorspace == "444") frame_size_ = luma * 3;
+        else if (colorspace == "mono") frame_size_ = luma;
+        else throw std::runtime_error("Unsupported Y4M colorspace: " + colorspace);
+    }
+
+    const std::string& header() const { return header_; }
+
+    bool next(Frame& frame) override {
+        std::string line;
+        if (!read_line(in_.file, line)) return false;
+        if (line.compare(0, 5, "FRAME") != 0) throw std::runtime_error("Malformed Y4M frame marker");
+        frame.index = next_++;
+        frame.bytes.resize(line.size() + frame_size_);
+        std::copy(line.begin(), line.end(), frame.bytes.begin());
+        if (std::fread(frame.bytes.data() + line.size(), 1, frame_size_, in_.file) != frame_size_)
+            throw std::runtime_error("Truncated Y4M frame");
+        frame.data_offset = line.size();
+        frame.row_channels = frame.row_stride = frame.channels = frame_size_;
+        return true;
+    }
+
+    uint64_t stream_offset(uint64_t index) const override { return index * frame_size_; }
+
+private:
+    StdioFile in_;
+    std::string header_;
+    uint64_t frame_size_ = 0;
+    uint64_t next_ = 0;
+};
+
+class Y4mSink : public FrameSink {
+public:
+    Y4mSink(const std::string& path, const std::string& header) : out_(path, true) {
+        std::fwrite(header.data(), 1, header.size(), out_.file);
+    }
+
+    void write(const Frame& frame) override {
+        if (std::fwrite(frame.bytes.data(), 1, frame.bytes.size(), out_.file) != frame.bytes.size())
+            throw std::runtime_error("Write to Y4M stream failed");
+    }
+
+private:
+    StdioFile out_;
+};
+
+bool is_directory_sequence(const std::string& path) {
+    return path != "-" && fs::is_directory(path);
+}
+
+std::unique_ptr<FrameSource> open_source(const std::string& input) {
+    if (is_directory_sequence(input)) return std::make_unique<BmpDirSource>(input);
+    return std::make_unique<Y4mSource>(input);
+}
+
+// Runs frames through reader -> workers -> in-order consumer with at most
+// `in_flight` frames alive. `work` runs on worker threads, `consume` on the
+// calling thread in frame order and may return false to stop early.
+template <typename Work, typename Consume>
+void run_pipeline(FrameSource& source, const SequenceOptions& options, const std::atomic<uint64_t>& stop_bit,
+                  Work&& work, Consume&& consume) {
+    unsigned threads = options.threads ? options.threads : default_thread_count();
+    size_t in_flight = options.max_in_flight ? options.max_in_flight : 2 * threads + 2;
+
+    BoundedQueue<int> tokens(in_flight);
+    BoundedQueue<Frame> todo(in_flight);
+    for (size_t i = 0; i < in_flight; ++i) tokens.push(0);
+    PipelineError error;
+
+    std::mutex done_mutex;
+    std::condition_variable done_cv;
+    std::map<uint64_t, Frame> done;
+    unsigned workers_left = threads;
+
+    std::thread reader([&] {
+        try {
+            int token;
+            for (uint64_t k = 0; source.stream_offset(k) < stop_bit.load() && tokens.pop(token); ++k) {
+                Frame frame;
+                if (!source.next(frame)) break;
+                if (!todo.push(std::move(frame))) break;
+            }
+        } catch (...) {
+            error.fail(tokens, todo);
+        }
+        todo.close();
+    });
+
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t] {
+            // Permutations and output buffers are allocated in work(), on this node
+            NumaWorkerScope numa(t, threads);
+            try {
+                Frame frame;
+                while (todo.pop(frame)) {
+                    work(frame);
+                    std::lock_guard<std::mutex> lock(done_mutex);
+                    done.emplace(frame.index, std::move(frame));
+                    done_cv.notify_all();
+                }
+            } catch (...) {
+                error.fail(tokens, todo);
+            }
+            std::lock_guard<std::mutex> lock(done_mutex);
+            --workers_left;
+            done_cv.notify_all();
+        });
+    }
+
+    try {
+        for (uint64_t next = 0;; ++next) {
+            Frame frame;
+            {
+                std::unique_lock<std::mutex> lock(done_mutex);
+                done_cv.wait(lock, [&] { return done.count(next) || workers_left == 0; });
+                auto it = done.find(next);
+                if (it == done.end()) break;
+                frame = std::move(it->second);
+                done.erase(it);
+            }
+            if (!consume(frame)) break;
+            tokens.push(0);
+        }
+    } catch (...) {
+        error.fail(tokens, todo);
+    }
+    tokens.close();
+    todo.close();
+    reader.join();
+    for (auto& w : workers) w.join();
+    error.rethrow();
+}
+
+Permutation frame_permutation(const Frame& frame, const SequenceOptions& options) {
+    if (options.passphrase.empty()) return {};
+    return prng_permutation(frame.channels, options.passphrase, frame.index);
+}
+
+double elapsed_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+} // namespace
+
+SequenceStats sequence_encode(const std::string& input, const std::string& output,
+                              const std::vector<uint8_t>& encoded, const SequenceOptions& options) {
+    auto start = std::chrono::steady_clock::now();
+    std::unique_ptr<FrameSource> source = open_source(input);
+    if (encoded.size() > kLegacyMaxMessage)
+        throw std::runtime_error("Message exceeds the 4 GiB limit of the sequence length header");
+    uint64_t nbits = 32 + (uint64_t)encoded.size() * 8;
+    if (nbits > source->capacity_bits())
+        throw std::runtime_error("Message too large for sequence (capacity: " +
+                                 std::to_string((source->capacity_bits() - 32) / 8) + " bytes)");
+
+    std::unique_ptr<FrameSink> sink;
+    if (is_directory_sequence(input)) sink = std::make_unique<BmpDirSink>(output);
+    else sink = std::make_unique<Y4mSink>(output, static_cast<Y4mSource&>(*source).header());
+
+    SequenceStats stats;
+    std::atomic<uint64_t> read_all(kUnknown); // every frame is written out
+    const FrameSource& src = *source;
+    run_pipeline(*source, options, read_all,
+        [&](Frame& frame) {
+            uint64_t first = src.stream_offset(frame.index);
+            if (first >= nbits) return;
+            uint64_t count = std::min<uint64_t>(frame.channels, nbits - first);
+            Permutation perm = frame_permutation(frame, options);
+            uint8_t* data = frame.bytes.data();
+            for (uint64_t j = 0; j < count; ++j) {
+                uint64_t off = frame.offset(perm.empty() ? j : perm[j]);
+                data[off] = (data[off] & 0xFE) | lsb_stream_bit(encoded, first + j);
+            }
+        },
+        [&](const Frame& frame) {
+            sink->write(frame);
+            ++stats.frames;
+            stats.bytes += frame.channels;
+            if (src.stream_offset(frame.index) < nbits) ++stats.payload_frames;
+            return true;
+        });
+    if (src.stream_offset(stats.frames) < nbits)
+        throw std::runtime_error("Sequence ended before the payload was fully embedded");
+
+    stats.elapsed_ms = elapsed_since(start);
+    return stats;
+}
+
+std::vector<uint8_t> sequence_decode(const std::string& input, const SequenceOptions& options,
+                                     SequenceStats* stats_out) {
+    auto start = std::chrono::steady_clock::now();
+    std::unique_ptr<FrameSource> source = open_source(input);
+    const FrameSource& src = *source;
+
+    // Stream length is unknown until the 32-bit header has been collected
+    std::atomic<uint64_t> nbits(kUnknown);
+    SequenceStats stats;
+    std::vector<uint8_t> message;
+    uint64_t length = 0, cursor = 0;
+
+    run_pipeline(*source, options, nbits,
+        [&](Frame& frame) {
+            // Pack the carried bits (one per byte) in place of the frame data
+            uint64_t first = src.stream_offset(frame.index);
+            uint64_t limit = nbits.load();
+            uint64_t count = first >= limit ? 0 : std::min<uint64_t>(frame.channels, limit - first);
+            Permutation perm = count ? frame_permutation(frame, options) : Permutation();
+            std::vector<uint8_t> bits(count);
+            for (uint64_t j = 0; j < count; ++j) bits[j] = frame.bytes[frame.offset(perm.empty() ? j : perm[j])] & 1;
+            frame.bytes.swap(bits);
+        },
+        [&](const Frame& frame) {
+            ++stats.frames;
+            stats.bytes += frame.channels;
+            if (!frame.bytes.empty()) ++stats.payload_frames;
+            for (uint8_t bit : frame.bytes) {
+                if (cursor < 32) {
+                    length = (length << 1) | bit;
+                    if (++cursor == 32) {
+                        if (32 + length * 8 > src.capacity_bits()) throw std::runtime_error("Message too large or corrupted");
+                        // Streams have no known capacity, so grow as bits arrive rather than trusting the header
+                        message.reserve(std::min<uint64_t>(length, 1 << 24));
+                        nbits = 32 + length * 8;
+                    }
+                    continue;
+                }
+                if (cursor >= nbits.load()) break;
+                uint64_t k = cursor - 32;
+                if (k % 8 == 0) message.push_back(0);
+                message.back() |= bit << (7 - k % 8);
+                ++cursor;
+            }
+            return cursor < nbits.load();
+        });
+    if (cursor < 32 || cursor < nbits.load()) throw std::runtime_error("Sequence too short or corrupted");
+
+    stats.elapsed_ms = elapsed_since(start);
+    if (stats_out) *stats_out = stats;
+    return message;
+}
@@ -0,0 +1,37 @@
+// sequence.h
+// Frame-sequence covers: numbered BMP frame directories and Y4M streams
+#pragma once
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// A sequence is one logical carrier: the lsb_encode stream (32-bit length +
+// message) is split into consecutive segments, one per frame, in frame
+// order. BMP frames carry data in every pixel channel in storage order; Y4M
+// frames in every plane byte. With a passphrase, each frame is ordered by its
+// own keyed permutation so frames can be processed independently.
+struct SequenceOptions {
+    std::string passphrase;
+    unsigned threads = 0;     // frame workers, 0 = hardware concurrency
+    size_t max_in_flight = 0; // frames buffered at once, 0 = 2 * threads + 2
+};
+
+struct SequenceStats {
+    uint64_t frames = 0;
+    uint64_t payload_frames = 0; // frames that carried payload bits
+    uint64_t bytes = 0;          // carrier bytes processed
+    double elapsed_ms = 0;
+    double fps() const { return elapsed_ms > 0 ? frames * 1000.0 / elapsed_ms : 0; }
+};
+
+// `input` is a directory of numbered .bmp frames, a .y4m file, or "-" for a
+// Y4M stream on stdin. The output mirrors it: a directory (created if needed)
+// with the same frame names, or a .y4m path / "-" for stdout. Frames are read,
+// embedded by a worker pool and written in order through a bounded pipeline,
+// so the sequence is never held in memory. Throws std::runtime_error.
+SequenceStats sequence_encode(const std::string& input, const std::string& output,
+                              const std::vector<uint8_t>& encoded, const SequenceOptions& options);
+
+// Extracts the message, stopping as soon as the last payload frame is read.
+std::vector<uint8_t> sequence_decode(const std::string& input, const SequenceOptions& options,
+                                     SequenceStats* stats = nullptr);
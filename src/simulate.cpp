@@ -0,0 +1,272 @@
+// simulate.cpp
+// Monte-Carlo channel-noise simulator for measuring ECC recovery
+#include "simulate.h"
+#include "kernels.h"
+#include "hamming.h"
+#include "parallel.h"
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+
+namespace {
+
+uint64_t splitmix64(uint64_t& x) {
+    uint64_t z = (x += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+// xoshiro256**: a few ns per draw and seeded per trial, so results do not
+// depend on how trials are split across threads.
+struct Rng {
+    uint64_t s[4];
+
+    explicit Rng(uint64_t seed) {
+        for (auto& v : s) v = splitmix64(seed);
+    }
+    static uint64_t rotl(uint64_t x, int k) { return (x << k) | (x >> (64 - k)); }
+    uint64_t next() {
+        uint64_t result = rotl(s[1] * 5, 7) * 9;
+        uint64_t t = s[1] << 17;
+        s[2] ^= s[0];
+        s[3] ^= s[1];
+        s[1] ^= s[2];
+        s[0] ^= s[3];
+        s[2] ^= t;
+        s[3] = rotl(s[3], 45);
+        return result;
+    }
+    // Uniform in (0, 1]
+    double uniform() { return ((next() >> 11) + 1) * 0x1.0p-53; }
+};
+
+int channels_per_byte(SimCodec codec) {
+    switch (codec) {
+        case SimCodec::None: return 8;
+        case SimCodec::Hamming: return 14;
+        case SimCodec::Legacy: return 16;
+    }
+    return 8;
+}
+
+// Block interleaver: logical carriers are written column-wise into `depth`
+// rows, so a run of adjacent physical channels lands `depth` apart logically.
+struct Interleaver {
+    int depth;
+    size_t cols;
+
+    size_t logical(size_t physical) const {
+        if (depth == 1) return physical;
+        return (physical % cols) * depth + physical / cols;
+    }
+};
+
+// Draws the gap before the next event of probability p (geometric), so
+// injection costs O(flips) rather than O(channels) at low BER.
+struct GapSampler {
+    double inv_log_q = 0;
+    bool always = false, never = false;
+
+    explicit GapSampler(double p) {
+        if (p >= 1) always = true;
+        else if (p <= 0) never = true;
+        else inv_log_q = 1.0 / std::log1p(-p);
+    }
+    size_t next(Rng& rng, size_t limit) const {
+        if (always) return 0;
+        if (never) return limit;
+        double gap = std::floor(std::log(rng.uniform()) * inv_log_q);
+        return gap >= (double)limit ? limit : (size_t)gap;
+    }
+};
+
+// Randomizes the LSBs of physical channels [begin, end). Without interleaving
+// the range is contiguous and is XORed 8 channels at a time.
+uint64_t randomize_range(uint8_t* buf, size_t begin, size_t end, const Interleaver& il, Rng& rng) {
+    constexpr uint64_t kLsbs = 0x0101010101010101ull;
+    uint64_t flips = 0;
+    size_t j = begin;
+    if (il.depth == 1) {
+        for (; j + 8 <= end; j += 8) {
+            uint64_t word, noise = rng.next() & kLsbs;
+            std::memcpy(&word, buf + j, 8);
+            word ^= noise;
+            std::memcpy(buf + j, &word, 8);
+            flips += (uint64_t)__builtin_popcountll(noise);
+        }
+    }
+    while (j < end) {
+        uint64_t bits = rng.next();
+        for (int b = 0; b < 64 && j < end; ++b, ++j) {
+            uint8_t bit = (uint8_t)((bits >> b) & 1);
+            buf[il.logical(j)] ^= bit;
+            flips += bit;
+        }
+    }
+    return flips;
+}
+
+uint64_t inject_noise(const SimulationOptions& options, double ber, uint8_t* buf, size_t n,
+                      const Interleaver& il, Rng& rng) {
+    uint64_t flips = 0;
+    switch (options.model) {
+        case NoiseModel::Random: {
+            GapSampler gaps(ber);
+            for (size_t j = gaps.next(rng, n); j < n; j += 1 + gaps.next(rng, n)) {
+                buf[il.logical(j)] ^= 1;
+                ++flips;
+            }
+            break;
+        }
+        case NoiseModel::Burst: {
+            // A cycle is one burst plus the clean gap before the next, whose
+            // mean (1 - p) / p must be len * (1 - ber) / ber for the flipped
+            // fraction len / cycle to equal ber
+            size_t len = (size_t)options.burst_length;
+            GapSampler gaps(ber / (ber + len * (1 - ber)));
+            for (size_t j = gaps.next(rng, n); j < n; j += gaps.next(rng, n)) {
+                size_t end = std::min(n, j + len);
+                flips += end - j;
+                for (; j < end; ++j) buf[il.logical(j)] ^= 1;
+            }
+            break;
+        }
+        case NoiseModel::Row: {
+            // A rewritten row flips half its LSBs on average
+            size_t row = (size_t)options.row_width * 3;
+            double hit = std::min(1.0, 2 * ber);
+            for (size_t start = 0; start < n; start += row) {
+                if (rng.uniform() <= hit) flips += randomize_range(buf, start, std::min(n, start + row), il, rng);
+            }
+            break;
+        }
+    }
+    return flips;
+}
+
+void validate(const SimulationOptions& options) {
+    if (options.codecs.empty() || options.bers.empty() || options.interleave.empty())
+        throw std::runtime_error("Simulation needs at least one codec, BER and interleave depth");
+    for (double ber : options.bers)
+        if (!(ber >= 0 && ber <= 1)) throw std::runtime_error("BER must be between 0 and 1");
+    for (int depth : options.interleave)
+        if (depth < 1) throw std::runtime_error("Interleave depth must be at least 1");
+    if (options.payload_bytes == 0 || options.trials == 0)
+        throw std::runtime_error("Simulation needs a non-empty payload and at least one trial");
+    if (options.burst_length < 1 || options.row_width < 1)
+        throw std::runtime_error("Burst length and row width must be positive");
+}
+
+void run_point(const SimulationOptions& options, uint64_t point_seed, SimulationPoint& point) {
+    const KernelOps& raw = select_kernel(KernelParams{});
+    KernelParams ham_params;
+    ham_params.ecc = EccType::Hamming74;
+    const KernelOps& ham = select_kernel(ham_params);
+
+    const size_t bytes = options.payload_bytes;
+    const size_t stored = point.codec == SimCodec::Legacy ? bytes * 2 : bytes;
+    const size_t needed = bytes * channels_per_byte(point.codec);
+    const size_t depth = (size_t)point.interleave;
+    const size_t n = (needed + depth - 1) / depth * depth;
+    const Interleaver il{point.interleave, n / depth};
+    std::mutex mutex;
+
+    parallel_for(options.trials, options.threads, [&](size_t begin, size_t end) {
+        std::vector<uint8_t> payload(bytes + 8), decoded(bytes), codewords(stored), buf(n);
+        SimulationPoint local;
+        for (size_t t = begin; t < end; ++t) {
+            Rng rng(point_seed ^ (t * 0xD1B54A32D192ED03ull));
+            for (size_t i = 0; i < bytes; i += 8) {
+                uint64_t r = rng.next();
+                std::memcpy(&payload[i], &r, 8);
+            }
+            size_t corrected = 0;
+            switch (point.codec) {
+                case SimCodec::None:
+                    raw.embed(buf.data(), n, payload.data(), bytes);
+                    local.flips += inject_noise(options, point.ber, buf.data(), n, il, rng);
+                    raw.extract(buf.data(), n, decoded.data(), bytes);
+                    break;
+                case SimCodec::Hamming:
+                    ham.embed(buf.data(), n, payload.data(), bytes);
+                    local.flips += inject_noise(options, point.ber, buf.data(), n, il, rng);
+                    corrected = ham.extract(buf.data(), n, decoded.data(), bytes);
+                    break;
+                case SimCodec::Legacy:
+                    for (size_t i = 0; i < bytes; ++i) {
+                        codewords[2 * i] = hamming74_encode_nibble(payload[i] >> 4);
+                        codewords[2 * i + 1] = hamming74_encode_nibble(payload[i] & 0xF);
+                    }
+                    raw.embed(buf.data(), n, codewords.data(), stored);
+                    local.flips += inject_noise(options, point.ber, buf.data(), n, il, rng);
+                    raw.extract(buf.data(), n, codewords.data(), stored);
+                    for (size_t i = 0; i < bytes; ++i) {
+                        bool e1 = false, e2 = false;
+                        uint8_t hi = hamming74_decode_codeword(codewords[2 * i], e1);
+                        uint8_t lo = hamming74_decode_codeword(codewords[2 * i + 1], e2);
+                        corrected += e1 + e2;
+                        decoded[i] = (uint8_t)((hi << 4) | lo);
+                    }
+                    break;
+            }
+            uint64_t wrong = 0;
+            for (size_t i = 0; i < bytes; ++i) wrong += (uint64_t)__builtin_popcount(payload[i] ^ decoded[i]);
+            local.bit_errors += wrong;
+            local.frame_errors += wrong != 0;
+            local.corrected += corrected;
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        point.flips += local.flips;
+        point.bit_errors += local.bit_errors;
+        point.frame_errors += local.frame_errors;
+        point.corrected += local.corrected;
+    });
+
+    point.trials = options.trials;
+    point.payload_bits = options.trials * bytes * 8;
+    point.channel_bits = options.trials * n;
+}
+
+} // namespace
+
+const char* sim_codec_name(SimCodec codec) {
+    switch (codec) {
+        case SimCodec::None: return "none";
+        case SimCodec::Hamming: return "hamming";
+        case SimCodec::Legacy: return "legacy";
+    }
+    return "?";
+}
+
+const char* noise_model_name(NoiseModel model) {
+    switch (model) {
+        case NoiseModel::Random: return "random";
+        case NoiseModel::Burst: return "burst";
+        case NoiseModel::Row: return "row";
+    }
+    return "?";
+}
+
+std::vector<SimulationPoint> run_simulation(const SimulationOptions& options) {
+    validate(options);
+    std::vector<SimulationPoint> points;
+    uint64_t mix = options.seed;
+    for (SimCodec codec : options.codecs) {
+        for (int depth : options.interleave) {
+            for (double ber : options.bers) {
+                SimulationPoint point;
+                point.codec = codec;
+                point.interleave = depth;
+                point.ber = ber;
+                auto start = std::chrono::steady_clock::now();
+                run_point(options, splitmix64(mix), point);
+                point.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                points.push_back(point);
+            }
+        }
+    }
+    return points;
+}
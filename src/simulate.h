@@ -0,0 +1,63 @@
+// simulate.h
+// Monte-Carlo channel-noise simulator for measuring ECC recovery
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Payload coding under test.
+enum class SimCodec : uint8_t {
+    None,     // raw bytes, 8 channels per byte
+    Hamming,  // in-kernel Hamming(7,4), 14 channels per byte (container format)
+    Legacy    // hamming74_encode + one codeword per byte, 16 channels per byte
+};
+
+// How carrier LSBs get corrupted. Every model is scaled so that the mean
+// fraction of flipped LSBs equals the requested BER.
+enum class NoiseModel : uint8_t {
+    Random, // independent flips
+    Burst,  // runs of `burst_length` consecutive flipped channels
+    Row     // whole rows replaced with random LSBs (partial rewrites, recompression)
+};
+
+struct SimulationOptions {
+    std::vector<SimCodec> codecs = {SimCodec::None, SimCodec::Hamming, SimCodec::Legacy};
+    std::vector<double> bers = {1e-4, 1e-3, 1e-2, 5e-2};
+    std::vector<int> interleave = {1, 16}; // block interleaver depths; 1 disables it
+    NoiseModel model = NoiseModel::Random;
+    int burst_length = 8;      // channels per burst
+    int row_width = 1024;      // pixels per row for the Row model
+    size_t payload_bytes = 256; // message size of one trial
+    uint64_t trials = 20000;   // per (codec, depth, BER) point
+    unsigned threads = 0;
+    uint64_t seed = 1;
+};
+
+// Result for one (codec, interleave depth, BER) combination.
+struct SimulationPoint {
+    SimCodec codec = SimCodec::None;
+    int interleave = 1;
+    double ber = 0;
+    uint64_t trials = 0;
+    uint64_t payload_bits = 0;   // message bits checked over all trials
+    uint64_t channel_bits = 0;   // carrier LSBs exposed to noise
+    uint64_t flips = 0;          // carrier LSBs actually flipped
+    uint64_t bit_errors = 0;     // message bits wrong after decoding
+    uint64_t frame_errors = 0;   // trials whose message was not fully recovered
+    uint64_t corrected = 0;      // codewords the decoder reported as corrected
+    double seconds = 0;
+
+    double measured_ber() const { return channel_bits ? (double)flips / channel_bits : 0; }
+    double residual_ber() const { return payload_bits ? (double)bit_errors / payload_bits : 0; }
+    double frame_error_rate() const { return trials ? (double)frame_errors / trials : 0; }
+    double trials_per_second() const { return seconds > 0 ? trials / seconds : 0; }
+};
+
+// Runs encode -> corrupt -> decode trials for every combination in `options`,
+// in parallel across trials. Results are deterministic for a given seed and
+// thread count. Throws std::runtime_error on invalid options.
+std::vector<SimulationPoint> run_simulation(const SimulationOptions& options);
+
+const char* sim_codec_name(SimCodec codec);
+const char* noise_model_name(NoiseModel model);
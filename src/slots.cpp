@@ -0,0 +1,165 @@
+// slots.cpp
+// Independent passphrase-keyed payload slots sharing one cover
+#include "slots.h"
+#include "kernels.h"
+#include "mapped_file.h"
+#include "prng_permute.h"
+#include "stream_io.h"
+#include <set>
+#include <stdexcept>
+
+namespace {
+
+using BlockKernel = kernels::LsbKernel<1, 0x7, BitOrder::MsbFirst, EccType::None>;
+constexpr size_t kBlockBytes = kSlotBlockChannels / 8;
+
+uint32_t block_tag(const std::string& passphrase, uint64_t block) {
+    return (uint32_t)keyed_hash(passphrase, block);
+}
+
+uint32_t fnv1a(const std::vector<uint8_t>& data) {
+    uint32_t h = 2166136261u;
+    for (uint8_t b : data) {
+        h ^= b;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+void put_be32(uint8_t* out, uint32_t v) {
+    out[0] = (uint8_t)(v >> 24);
+    out[1] = (uint8_t)(v >> 16);
+    out[2] = (uint8_t)(v >> 8);
+    out[3] = (uint8_t)v;
+}
+
+uint32_t get_be32(const uint8_t* in) {
+    return ((uint32_t)in[0] << 24) | ((uint32_t)in[1] << 16) | ((uint32_t)in[2] << 8) | in[3];
+}
+
+// Walks a slot's keyed block order; `read_block(b, bytes)` fills the 32 LSB
+// bytes of block b.
+template <typename ReadBlock>
+std::vector<uint8_t> decode_blocks(size_t blocks, const std::string& passphrase, ReadBlock read_block,
+                                   SlotDecodeStats* stats) {
+    if (passphrase.empty()) throw std::runtime_error("Slots need a passphrase");
+    if (blocks == 0) throw std::runtime_error("Image too small for slots");
+    KeyedBijection order(blocks, passphrase);
+    std::vector<uint8_t> stream;
+    size_t needed = kSlotHeaderBytes;
+    SlotDecodeStats local;
+    size_t run = 0;
+    uint8_t bytes[kBlockBytes];
+    for (uint64_t i = 0; i < blocks && stream.size() < needed; ++i) {
+        uint64_t b = order.forward(i);
+        read_block(b, bytes);
+        if (get_be32(bytes) != block_tag(passphrase, b)) {
+            ++local.blocks_skipped;
+            if (++run > kSlotMaxSkip) break;
+            continue;
+        }
+        run = 0;
+        ++local.blocks_read;
+        stream.insert(stream.end(), bytes + kSlotTagBytes, bytes + kBlockBytes);
+        if (local.blocks_read == 1) needed = kSlotHeaderBytes + get_be32(bytes + kSlotTagBytes);
+    }
+    if (stats) *stats = local;
+    if (local.blocks_read == 0) throw std::runtime_error("No slot found for this passphrase");
+    if (stream.size() < needed) throw std::runtime_error("Slot data incomplete or corrupted");
+
+    uint32_t checksum = get_be32(&stream[4]);
+    std::vector<uint8_t> message(stream.begin() + kSlotHeaderBytes, stream.begin() + needed);
+    if (fnv1a(message) != checksum) throw std::runtime_error("Slot checksum mismatch");
+    return message;
+}
+
+} // namespace
+
+size_t slot_block_count(uint64_t channels) { return (size_t)(channels / kSlotBlockChannels); }
+
+size_t slot_capacity(uint64_t channels) {
+    size_t raw = slot_block_count(channels) * kSlotBlockPayload;
+    return raw > kSlotHeaderBytes ? raw - kSlotHeaderBytes : 0;
+}
+
+SlotEncodeStats slots_encode(BMPImage& img, const std::vector<SlotMessage>& slots) {
+    SlotEncodeStats stats;
+    stats.blocks_total = slot_block_count(img.data.size());
+    std::set<std::string> seen;
+    for (const auto& slot : slots) {
+        if (slot.passphrase.empty()) throw std::runtime_error("Every slot needs a passphrase");
+        if (!seen.insert(slot.passphrase).second) throw std::runtime_error("Slot passphrases must be distinct");
+    }
+    if (stats.blocks_total == 0) throw std::runtime_error("Image too small for slots");
+
+    std::vector<uint64_t> occupied((stats.blocks_total + 63) / 64, 0);
+    for (size_t s = 0; s < slots.size(); ++s) {
+        const auto& slot = slots[s];
+        std::vector<uint8_t> stream(kSlotHeaderBytes);
+        put_be32(&stream[0], (uint32_t)slot.message.size());
+        put_be32(&stream[4], fnv1a(slot.message));
+        stream.insert(stream.end(), slot.message.begin(), slot.message.end());
+
+        KeyedBijection order(stats.blocks_total, slot.passphrase);
+        size_t written = 0, used = 0, run = 0;
+        uint64_t i = 0;
+        while (written < stream.size()) {
+            if (i == stats.blocks_total)
+                throw std::runtime_error("Slot " + std::to_string(s + 1) + " does not fit in the remaining space");
+            uint64_t b = order.forward(i++);
+            if (occupied[b / 64] >> (b % 64) & 1) {
+                if (++run > kSlotMaxSkip)
+                    throw std::runtime_error("Cover too full to place slot " + std::to_string(s + 1));
+                stats.longest_skip = std::max(stats.longest_skip, run);
+                continue;
+            }
+            run = 0;
+            occupied[b / 64] |= 1ull << (b % 64);
+            uint8_t bytes[kBlockBytes] = {};
+            put_be32(bytes, block_tag(slot.passphrase, b));
+            size_t n = std::min(kSlotBlockPayload, stream.size() - written);
+            std::copy(stream.begin() + written, stream.begin() + written + n, bytes + kSlotTagBytes);
+            written += n;
+            BlockKernel::embed(&img.data[b * kSlotBlockChannels], kSlotBlockChannels, bytes, kBlockBytes);
+            ++used;
+        }
+        stats.blocks_per_slot.push_back(used);
+        stats.blocks_used += used;
+    }
+    return stats;
+}
+
+std::vector<uint8_t> slot_decode(const BMPImage& img, const std::string& passphrase, SlotDecodeStats* stats) {
+    return decode_blocks(
+        slot_block_count(img.data.size()), passphrase,
+        [&](uint64_t b, uint8_t* out) {
+            BlockKernel::extract(&img.data[b * kSlotBlockChannels], kSlotBlockChannels, out, kBlockBytes);
+        },
+        stats);
+}
+
+std::vector<uint8_t> slot_decode_file(const std::string& filename, const std::string& passphrase,
+                                      SlotDecodeStats* stats) {
+    if (is_std_stream(filename)) return slot_decode(load_bmp(filename), passphrase, stats);
+    BMPInfo info = probe_bmp(filename);
+    MappedFile file(filename, MappedFile::Mode::ReadOnly);
+    if (file.size() < info.file_size) throw std::runtime_error("Truncated BMP pixel data");
+    const uint8_t* base = file.data();
+    uint64_t row_bytes = (uint64_t)info.width * 3;
+    uint8_t channels[kSlotBlockChannels];
+    return decode_blocks(
+        slot_block_count(row_bytes * info.height), passphrase,
+        [&](uint64_t b, uint8_t* out) {
+            // A block is contiguous within a row; it splits only at row ends
+            uint64_t index = b * kSlotBlockChannels;
+            for (size_t k = 0; k < kSlotBlockChannels;) {
+                uint64_t in_row = row_bytes - (index + k) % row_bytes;
+                size_t n = (size_t)std::min<uint64_t>(in_row, kSlotBlockChannels - k);
+                const uint8_t* src = base + bmp_channel_offset(info, index + k);
+                std::copy(src, src + n, channels + k);
+                k += n;
+            }
+            BlockKernel::extract(channels, kSlotBlockChannels, out, kBlockBytes);
+        },
+        stats);
+}
@@ -0,0 +1,57 @@
+// slots.h
+// Independent passphrase-keyed payload slots sharing one cover
+#pragma once
+#include "bmp.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// The cover is split into blocks of 256 consecutive channels (32 LSB bytes).
+// A block holds a 32-bit tag keyed by the slot passphrase and block index,
+// followed by 28 payload bytes. Each slot visits blocks in its own keyed
+// order and claims the free ones, so slots never overlap; a reader skips
+// blocks whose tag is not theirs. The first block of a slot starts with the
+// message length and an FNV-1a checksum (big-endian, 32 bits each).
+constexpr size_t kSlotBlockChannels = 256;
+constexpr size_t kSlotTagBytes = 4;
+constexpr size_t kSlotBlockPayload = kSlotBlockChannels / 8 - kSlotTagBytes;
+constexpr size_t kSlotHeaderBytes = 8;
+// Longest run of other slots' blocks allowed between two blocks of a slot.
+// The encoder fails rather than exceed it; a reader gives up after it.
+constexpr size_t kSlotMaxSkip = 1024;
+
+struct SlotMessage {
+    std::string passphrase;
+    std::vector<uint8_t> message;
+};
+
+struct SlotEncodeStats {
+    size_t blocks_total = 0;
+    size_t blocks_used = 0;
+    std::vector<size_t> blocks_per_slot;
+    size_t longest_skip = 0;
+};
+
+struct SlotDecodeStats {
+    size_t blocks_read = 0;    // own blocks
+    size_t blocks_skipped = 0; // other slots' blocks passed over
+};
+
+// Blocks available in a cover with `channels` channel bytes.
+size_t slot_block_count(uint64_t channels);
+
+// Message bytes a single slot could carry in an otherwise empty cover.
+size_t slot_capacity(uint64_t channels);
+
+// Embeds all slots in one pass, tracking claimed blocks in an occupancy
+// bitmap. Passphrases must be distinct and non-empty. Throws
+// std::runtime_error when the slots do not fit.
+SlotEncodeStats slots_encode(BMPImage& img, const std::vector<SlotMessage>& slots);
+
+// Extracts one slot. Only that slot's blocks (and any blocks of other slots
+// in its path) are read, so the cost follows the slot size, not the cover.
+// The file variant maps the BMP read-only; "-" falls back to loading stdin.
+std::vector<uint8_t> slot_decode(const BMPImage& img, const std::string& passphrase, SlotDecodeStats* stats = nullptr);
+std::vector<uint8_t> slot_decode_file(const std::string& filename, const std::string& passphrase,
+                                      SlotDecodeStats* stats = nullptr);
@@ -0,0 +1,160 @@
+// stats_cache.cpp
+// Cache of derived cover statistics keyed by (path, mtime, size)
+#include "stats_cache.h"
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <unordered_map>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+struct CacheKey {
+    std::string path;
+    int64_t mtime = 0;
+    uint64_t size = 0;
+};
+
+struct CacheEntry {
+    CacheKey key;
+    CoverStats stats;
+};
+
+std::mutex g_memory_mutex;
+std::unordered_map<std::string, CacheEntry> g_memory;
+
+CacheKey key_for(const std::string& path) {
+    CacheKey key;
+    fs::path p = fs::absolute(path).lexically_normal();
+    key.path = p.string();
+    key.mtime = (int64_t)fs::last_write_time(p).time_since_epoch().count();
+    key.size = (uint64_t)fs::file_size(p);
+    return key;
+}
+
+bool same_key(const CacheKey& a, const CacheKey& b) {
+    return a.path == b.path && a.mtime == b.mtime && a.size == b.size;
+}
+
+fs::path sidecar_for(const CacheKey& key) {
+    const char* xdg = std::getenv("XDG_CACHE_HOME");
+    const char* home = std::getenv("HOME");
+    fs::path dir;
+    if (xdg && *xdg) dir = fs::path(xdg) / "thousandflicks";
+    else if (home && *home) dir = fs::path(home) / ".cache" / "thousandflicks";
+    else return {};
+    // FNV-1a of the absolute path names the sidecar; the path inside guards collisions
+    uint64_t h = 1469598103934665603ull;
+    for (char c : key.path) {
+        h ^= (uint8_t)c;
+        h *= 1099511628211ull;
+    }
+    std::ostringstream name;
+    name << std::hex << std::setw(16) << std::setfill('0') << h << ".stats";
+    return dir / name.str();
+}
+
+bool read_sidecar(const fs::path& file, CacheEntry& entry) {
+    std::ifstream in(file);
+    if (!in) return false;
+    std::map<std::string, std::string> fields;
+    std::string line;
+    while (std::getline(in, line)) {
+        auto eq = line.find('=');
+        if (eq != std::string::npos) fields[line.substr(0, eq)] = line.substr(eq + 1);
+    }
+    try {
+        entry.key.path = fields.at("path");
+        entry.key.mtime = std::stoll(fields.at("mtime"));
+        entry.key.size = std::stoull(fields.at("size"));
+        CoverStats& s = entry.stats;
+        s.width = std::stoi(fields.at("width"));
+        s.height = std::stoi(fields.at("height"));
+        s.channels = std::stoull(fields.at("channels"));
+        s.lsb_capacity = std::stoull(fields.at("lsb_capacity"));
+        s.lsb_ones_ratio = std::stod(fields.at("lsb_ones_ratio"));
+        s.chi_square_p = std::stod(fields.at("chi_square_p"));
+        s.texture_mean = std::stod(fields.at("texture_mean"));
+        s.textured_fraction = std::stod(fields.at("textured_fraction"));
+        s.detectability = std::stod(fields.at("detectability"));
+    } catch (const std::exception&) {
+        return false; // stale format or partial write: treat as a miss
+    }
+    return true;
+}
+
+void write_sidecar(const fs::path& file, const CacheEntry& entry) {
+    std::error_code ec;
+    fs::create_directories(file.parent_path(), ec);
+    if (ec) return;
+    // Write-then-rename so concurrent readers never see a partial file
+    fs::path tmp = file;
+    tmp += ".tmp";
+    {
+        std::ofstream out(tmp);
+        if (!out) return;
+        const CoverStats& s = entry.stats;
+        out << std::setprecision(17);
+        out << "path=" << entry.key.path << "\n"
+            << "mtime=" << entry.key.mtime << "\n"
+            << "size=" << entry.key.size << "\n"
+            << "width=" << s.width << "\n"
+            << "height=" << s.height << "\n"
+            << "channels=" << s.channels << "\n"
+            << "lsb_capacity=" << s.lsb_capacity << "\n"
+            << "lsb_ones_ratio=" << s.lsb_ones_ratio << "\n"
+            << "chi_square_p=" << s.chi_square_p << "\n"
+            << "texture_mean=" << s.texture_mean << "\n"
+            << "textured_fraction=" << s.textured_fraction << "\n"
+            << "detectability=" << s.detectability << "\n";
+    }
+    fs::rename(tmp, file, ec);
+}
+
+} // namespace
+
+bool StatsCache::lookup(const std::string& path, CoverStats& stats) const {
+    CacheKey key = key_for(path);
+    {
+        std::lock_guard<std::mutex> lock(g_memory_mutex);
+        auto it = g_memory.find(key.path);
+        if (it != g_memory.end() && same_key(it->second.key, key)) {
+            stats = it->second.stats;
+            return true;
+        }
+    }
+    if (!use_sidecar_) return false;
+    fs::path file = sidecar_for(key);
+    CacheEntry entry;
+    if (file.empty() || !read_sidecar(file, entry) || !same_key(entry.key, key)) return false;
+    std::lock_guard<std::mutex> lock(g_memory_mutex);
+    g_memory[key.path] = entry;
+    stats = entry.stats;
+    return true;
+}
+
+CoverStats StatsCache::get(const std::string& path, bool* hit) {
+    CoverStats stats;
+    if (lookup(path, stats)) {
+        if (hit) *hit = true;
+        return stats;
+    }
+    if (hit) *hit = false;
+    CacheEntry entry;
+    entry.key = key_for(path);
+    entry.stats = analyze_cover(load_bmp(path));
+    {
+        std::lock_guard<std::mutex> lock(g_memory_mutex);
+        g_memory[entry.key.path] = entry;
+    }
+    if (use_sidecar_) {
+        fs::path file = sidecar_for(entry.key);
+        if (!file.empty()) write_sidecar(file, entry);
+    }
+    return entry.stats;
+}
@@ -0,0 +1,23 @@
+// stats_cache.h
+// Cache of derived cover statistics keyed by (path, mtime, size)
+#pragma once
+#include "analysis.h"
+#include <string>
+
+// Lookups first consult an in-process table, then an optional sidecar file
+// under $XDG_CACHE_HOME/thousandflicks (or ~/.cache/thousandflicks). An entry
+// is only returned while the file's path, modification time and size match.
+class StatsCache {
+public:
+    explicit StatsCache(bool use_sidecar = true) : use_sidecar_(use_sidecar) {}
+
+    // Returns true and fills `stats` when a fresh entry exists.
+    bool lookup(const std::string& path, CoverStats& stats) const;
+
+    // Returns cached statistics, computing and storing them on a miss.
+    // Sets `*hit` to whether the cache answered. Throws on load error.
+    CoverStats get(const std::string& path, bool* hit = nullptr);
+
+private:
+    bool use_sidecar_;
+};
@@ -0,0 +1,109 @@
+// stego.cpp
+// Whole-message encode/decode shared by the command line and the GUIs
+#include "stego.h"
+#include "hamming.h"
+#include "jpeg.h"
+#include "lsb.h"
+#include "png.h"
+#include "prng_permute.h"
+#include "stream_io.h"
+#include <stdexcept>
+
+namespace {
+
+DecodedMessage from_container(std::vector<uint8_t> data, const ContainerDecodeInfo& info) {
+    DecodedMessage result;
+    result.data = std::move(data);
+    result.container = true;
+    result.header = info.header;
+    result.had_error = info.corrected_codewords > 0;
+    return result;
+}
+
+// Legacy layout: Hamming-coded bytes behind a 32-bit length
+DecodedMessage decode_legacy(const BMPImage& img, const std::string& passphrase, EccStats* ecc) {
+    DecodedMessage result;
+    std::vector<uint8_t> coded;
+    Permutation perm;
+    if (!passphrase.empty()) {
+        perm = prng_permutation(img.data.size(), passphrase);
+        BMPImage keyed{img.width, img.height, apply_permutation(img.data, perm)};
+        coded = lsb_decode(keyed, lsb_capacity(keyed));
+    } else {
+        coded = lsb_decode(img, lsb_capacity(img));
+    }
+    if (!ecc) {
+        result.data = hamming74_decode(coded, result.had_error);
+        return result;
+    }
+    // Codewords follow the 32-bit length, one carrier per bit
+    ecc->reset(img.width, img.height);
+    CarrierMap map;
+    if (!perm.empty()) map.channels = &perm;
+    result.data = hamming74_decode_with_stats(coded, result.had_error, 32, map, *ecc);
+    return result;
+}
+
+// JPEG covers only ever hold containers
+DecodedMessage decode_jpeg(const JpegImage& image, const std::string& passphrase) {
+    std::vector<uint8_t> data;
+    ContainerDecodeInfo info;
+    if (!jpeg_try_extract(image, passphrase, data, &info))
+        throw std::runtime_error("No message found in JPEG (wrong passphrase?)");
+    return from_container(std::move(data), info);
+}
+
+// PNG covers hold either a streamed container (keyed pixels in bijection
+// order) or anything the BMP path writes, saved as PNG
+DecodedMessage decode_png_cover(const BMPImage& img, const std::string& passphrase, EccStats* ecc) {
+    std::vector<uint8_t> data;
+    ContainerDecodeInfo info;
+    info.ecc = ecc;
+    if (!passphrase.empty() && png_try_extract(img, passphrase, data, &info))
+        return from_container(std::move(data), info);
+    return decode_message(img, passphrase, ecc);
+}
+
+} // namespace
+
+void embed_legacy(BMPImage& img, const std::vector<uint8_t>& encoded, const std::string& passphrase,
+                  EmbedMode mode) {
+    Permutation perm;
+    if (!passphrase.empty()) {
+        perm = prng_permutation(img.data.size(), passphrase);
+        img.data = apply_permutation(img.data, perm);
+    }
+    lsb_encode(img, encoded, mode, keyed_hash(passphrase, 0));
+    if (!passphrase.empty()) img.data = invert_permutation(img.data, perm);
+}
+
+void encode_legacy_message(BMPImage& img, const std::vector<uint8_t>& message, const std::string& passphrase) {
+    embed_legacy(img, hamming74_encode(message), passphrase);
+}
+
+DecodedMessage decode_message(const BMPImage& img, const std::string& passphrase, EccStats* ecc) {
+    std::vector<uint8_t> data;
+    ContainerDecodeInfo info;
+    info.ecc = ecc;
+    if (container_try_decode(img, passphrase, data, &info)) return from_container(std::move(data), info);
+    return decode_legacy(img, passphrase, ecc);
+}
+
+DecodedMessage decode_message_file(const std::string& path, const std::string& passphrase, EccStats* ecc) {
+    if (is_std_stream(path)) return decode_message(load_bmp(path), passphrase, ecc);
+    if (is_jpeg_file(path)) {
+        if (ecc) ecc->reset(0, 0);
+        return decode_jpeg(jpeg_parse(read_all(path)), passphrase);
+    }
+    if (is_png_file(path)) return decode_png_cover(load_png(path), passphrase, ecc);
+    std::vector<uint8_t> data;
+    ContainerDecodeInfo info;
+    info.ecc = ecc;
+    if (container_try_decode_file(path, passphrase, data, &info)) return from_container(std::move(data), info);
+    return decode_legacy(load_bmp(path), passphrase, ecc);
+}
+
+DecodedMessage decode_message_bytes(const uint8_t* bytes, size_t size, const std::string& passphrase) {
+    if (is_png(bytes, size)) return decode_png_cover(decode_png(bytes, size), passphrase, nullptr);
+    return decode_message(decode_bmp(bytes, size), passphrase);
+}
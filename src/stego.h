@@ -0,0 +1,39 @@
+// stego.h
+// Whole-message encode/decode shared by the command line and the GUIs
+#pragma once
+#include "bmp.h"
+#include "container.h"
+#include <string>
+#include <vector>
+
+struct DecodedMessage {
+    std::vector<uint8_t> data;
+    bool container = false;  // true when a container header was found
+    ContainerHeader header;  // valid when `container` is set
+    bool had_error = false;  // Hamming ECC corrected at least one codeword
+};
+
+// Embeds already Hamming-coded bytes with the legacy layout, visiting the
+// channels in keyed order when a passphrase is given. LSB matching draws its
+// step directions from the passphrase.
+void embed_legacy(BMPImage& img, const std::vector<uint8_t>& encoded, const std::string& passphrase,
+                  EmbedMode mode = EmbedMode::Replace);
+
+// Hamming-codes `message` and embeds it with the legacy layout.
+void encode_legacy_message(BMPImage& img, const std::vector<uint8_t>& message, const std::string& passphrase);
+
+// Decodes a container if present, otherwise the legacy layout. Throws
+// std::runtime_error when neither yields a message. `ecc`, when given, is
+// reset to the image size and filled with where the ECC corrected bits.
+DecodedMessage decode_message(const BMPImage& img, const std::string& passphrase, EccStats* ecc = nullptr);
+
+// Same, from a file: containers are read through a mapping without loading
+// the pixel data, so huge covers decode in time proportional to the payload.
+// Baseline JPEG files are read from their DCT coefficients and PNG files are
+// decoded to pixels first. "-" reads a BMP from stdin. JPEG coefficients do
+// not map to pixels, so `ecc` is left empty for them.
+DecodedMessage decode_message_file(const std::string& path, const std::string& passphrase,
+                                   EccStats* ecc = nullptr);
+
+// Same, from a BMP or PNG file already in memory.
+DecodedMessage decode_message_bytes(const uint8_t* bytes, size_t size, const std::string& passphrase);
@@ -0,0 +1,120 @@
+// stream_io.cpp
+// Whole-buffer I/O on file paths or "-" (stdin/stdout) for pipelines
+#include "stream_io.h"
+#include "file_io.h"
+#include <cerrno>
+#include <mutex>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr size_t kChunk = 1 << 20;
+
+bool is_fifo(int fd) {
+    struct stat st;
+    return ::fstat(fd, &st) == 0 && S_ISFIFO(st.st_mode);
+}
+
+void write_exact(int fd, const uint8_t* p, size_t len) {
+    while (len) {
+        ssize_t n = ::write(fd, p, len);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) throw std::runtime_error("Write failed");
+        p += n;
+        len -= (size_t)n;
+    }
+}
+
+#ifdef __linux__
+// Maps the buffer's pages into the pipe rather than copying them. The pipe
+// references those pages until the reader drains it, so the buffer is
+// parked here and never freed or reused.
+bool splice_to_pipe(int fd, std::vector<uint8_t>& data) {
+    size_t off = 0;
+    while (off < data.size()) {
+        struct iovec iov = {data.data() + off, data.size() - off};
+        ssize_t n = ::vmsplice(fd, &iov, 1, 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && off == 0) return false; // not spliceable: caller falls back to write()
+        if (n <= 0) throw std::runtime_error("vmsplice failed");
+        off += (size_t)n;
+    }
+    // Deliberately leaked: destroying it at exit would free the buffers, and
+    // the allocator's bookkeeping writes would land in pages still queued in the pipe.
+    static std::mutex retired_mutex;
+    static auto* retired = new std::vector<std::vector<uint8_t>>();
+    std::lock_guard<std::mutex> lock(retired_mutex);
+    retired->push_back(std::move(data));
+    return true;
+}
+#endif
+
+} // namespace
+
+void read_exact(int fd, void* buf, size_t len) {
+    auto* p = static_cast<uint8_t*>(buf);
+    while (len) {
+        ssize_t n = ::read(fd, p, len);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) throw std::runtime_error("Unexpected end of input");
+        p += n;
+        len -= (size_t)n;
+    }
+}
+
+std::vector<uint8_t> read_all(const std::string& path) {
+    FileDescriptor owned;
+    int fd = STDIN_FILENO;
+    if (!is_std_stream(path)) {
+        owned = open_for_read(path);
+        fd = owned.get();
+    } else {
+        tune_pipe(fd);
+    }
+
+    std::vector<uint8_t> data;
+    struct stat st;
+    if (::fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+        off_t pos = ::lseek(fd, 0, SEEK_CUR);
+        if (pos >= 0 && st.st_size > pos) data.reserve((size_t)(st.st_size - pos));
+    }
+    size_t used = 0;
+    for (;;) {
+        if (data.size() - used < kChunk) data.resize(used + kChunk);
+        ssize_t n = ::read(fd, data.data() + used, data.size() - used);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) throw std::runtime_error("Read failed: " + path);
+        if (n == 0) break;
+        used += (size_t)n;
+    }
+    data.resize(used);
+    return data;
+}
+
+void write_all(const std::string& path, std::vector<uint8_t>&& data) {
+    if (!is_std_stream(path)) {
+        FileDescriptor out = open_for_write(path);
+        write_exact(out.get(), data.data(), data.size());
+        return;
+    }
+    int fd = STDOUT_FILENO;
+    if (is_fifo(fd)) {
+        tune_pipe(fd);
+#ifdef __linux__
+        if (splice_to_pipe(fd, data)) return;
+#endif
+    }
+    write_exact(fd, data.data(), data.size());
+}
+
+void tune_pipe(int fd) {
+#if defined(__linux__) && defined(F_SETPIPE_SZ)
+    if (is_fifo(fd)) ::fcntl(fd, F_SETPIPE_SZ, (int)kChunk); // best effort; capped by pipe-max-size
+#else
+    (void)fd;
+#endif
+}
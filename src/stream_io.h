@@ -0,0 +1,24 @@
+// stream_io.h
+// Whole-buffer I/O on file paths or "-" (stdin/stdout) for pipelines
+#pragma once
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+// True for the "-" placeholder meaning stdin/stdout.
+inline bool is_std_stream(const std::string& path) { return path == "-"; }
+
+// Reads exactly `len` bytes from a descriptor. Throws std::runtime_error on EOF.
+void read_exact(int fd, void* buf, size_t len);
+
+// Reads everything from a path, or from stdin for "-", in large chunks.
+std::vector<uint8_t> read_all(const std::string& path);
+
+// Writes a buffer to a path, or to stdout for "-". The buffer is consumed:
+// when stdout is a pipe on Linux its pages are handed to the pipe with
+// vmsplice instead of being copied, and are kept alive until process exit.
+void write_all(const std::string& path, std::vector<uint8_t>&& data);
+
+// Raises a pipe's kernel buffer so large writes need fewer wakeups (Linux only).
+void tune_pipe(int fd);
@@ -0,0 +1,379 @@
+// tiled.cpp
+// Band-streamed LSB embedding for covers too large to load at once
+#include "tiled.h"
+#include "file_io.h"
+#include "lsb.h"
+#include "parallel.h"
+#include "prng_permute.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <sys/stat.h>
+
+namespace {
+
+constexpr size_t kBandRowsBits = 16;  // plain band-height field at the start
+constexpr size_t kPoolBuffers = 3;    // band N-1 writing, N computing, N+1 reading
+constexpr uint64_t kPermutationBudget = 1ull << 30;  // bytes of finished band permutations
+
+// Geometry of the storage-order carrier for a given band height.
+struct BandLayout {
+    BMPInfo info;
+    uint64_t row_channels = 0;   // width * 3
+    uint64_t band_rows = 0;
+    uint64_t band_channels = 0;  // row_channels * band_rows
+    uint64_t bands = 0;
+
+    BandLayout(const BMPInfo& i, uint64_t rows) : info(i), row_channels((uint64_t)i.width * 3), band_rows(rows) {
+        band_channels = row_channels * band_rows;
+        bands = ((uint64_t)info.height + band_rows - 1) / band_rows;
+    }
+
+    uint64_t rows_in(uint64_t b) const {
+        uint64_t first = b * band_rows;
+        return std::min<uint64_t>(band_rows, info.height - first);
+    }
+    // Carrier channels skipped at the start of band b (the band-height field)
+    uint64_t skip(uint64_t b) const { return b == 0 ? kBandRowsBits : 0; }
+    // Carrier channels in band b
+    uint64_t domain(uint64_t b) const { return rows_in(b) * row_channels - skip(b); }
+    // Logical stream index of the first carrier channel in band b
+    uint64_t base(uint64_t b) const { return b == 0 ? 0 : b * band_channels - kBandRowsBits; }
+    // Band holding logical stream index i
+    uint64_t band_of(uint64_t i) const { return (i + kBandRowsBits) / band_channels; }
+    // Byte offset of a band-local storage channel inside the band buffer
+    uint64_t buffer_offset(uint64_t local) const {
+        return (local / row_channels) * info.row_stride + local % row_channels;
+    }
+    uint64_t file_offset(uint64_t b) const { return info.data_offset + b * band_rows * info.row_stride; }
+    uint64_t buffer_size(uint64_t b) const { return rows_in(b) * info.row_stride; }
+};
+
+struct Band {
+    uint64_t index = 0;
+    std::vector<uint8_t> data;
+};
+
+// Shuffles the keyed permutation of each band ahead of the compute stage.
+// A band's permutation depends only on its index, so up to `threads` of
+// them are built at once while earlier bands embed; finished tables are
+// capped by kPermutationBudget. With one thread (--threads 1 or a single
+// core) there is nothing to overlap with and take() shuffles inline.
+class BandPermutations {
+public:
+    BandPermutations(const BandLayout& layout, const std::string& passphrase, uint64_t bands, unsigned threads)
+        : layout_(layout), passphrase_(passphrase), bands_(bands) {
+        if (threads == 0) threads = default_thread_count();
+        if (threads <= 1) return;
+        uint64_t table_bytes = std::max<uint64_t>(layout.domain(0) * sizeof(size_t), 1);
+        ahead_ = std::max<uint64_t>(1, std::min<uint64_t>(threads, kPermutationBudget / table_bytes));
+        for (uint64_t t = 0; t < std::min<uint64_t>(ahead_, bands); ++t) workers_.emplace_back([this] { run(); });
+    }
+
+    ~BandPermutations() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        space_.notify_all();
+        for (auto& w : workers_) w.join();
+    }
+
+    // Permutation of band b; bands must be taken in increasing order.
+    Permutation take(uint64_t b) {
+        if (workers_.empty()) return prng_permutation(layout_.domain(b), passphrase_, b);
+        std::unique_lock<std::mutex> lock(mutex_);
+        ready_.wait(lock, [&] { return error_ || done_.count(b); });
+        if (error_) std::rethrow_exception(error_);
+        Permutation perm = std::move(done_[b]);
+        done_.erase(b);
+        taken_ = b + 1;
+        space_.notify_all();
+        return perm;
+    }
+
+    // Stops building permutations past `bands` (decode, once the length is known).
+    void limit(uint64_t bands) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        bands_ = std::min(bands_, bands);
+    }
+
+private:
+    void run() {
+        try {
+            for (;;) {
+                uint64_t b;
+                {
+                    std::unique_lock<std::mutex> lock(mutex_);
+                    space_.wait(lock, [&] { return stop_ || next_ >= bands_ || next_ < taken_ + ahead_; });
+                    if (stop_ || next_ >= bands_) return;
+                    b = next_++;
+                }
+                Permutation perm = prng_permutation(layout_.domain(b), passphrase_, b);
+                std::lock_guard<std::mutex> lock(mutex_);
+                done_.emplace(b, std::move(perm));
+                ready_.notify_all();
+            }
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!error_) error_ = std::current_exception();
+            ready_.notify_all();
+        }
+    }
+
+    const BandLayout& layout_;
+    const std::string& passphrase_;
+    std::mutex mutex_;
+    std::condition_variable ready_, space_;
+    std::map<uint64_t, Permutation> done_;
+    std::exception_ptr error_;
+    uint64_t bands_;
+    uint64_t ahead_ = 1;
+    uint64_t next_ = 0;   // next band to shuffle
+    uint64_t taken_ = 0;  // bands handed to the compute stage
+    bool stop_ = false;
+    std::vector<std::thread> workers_;
+};
+
+uint64_t file_size_of(int fd) {
+    struct stat st;
+    if (::fstat(fd, &st) != 0) throw std::runtime_error("Cannot stat file");
+    return (uint64_t)st.st_size;
+}
+
+// Calls fn(logical_local_index, buffer_offset) for carrier channels
+// [begin, end) of band b, split across worker threads. Keyed offsets land
+// anywhere in the band, so they are computed a batch ahead and their bytes
+// of `data` prefetched.
+template <typename Fn>
+void for_band_channels(const BandLayout& layout, uint64_t b, uint64_t count, const Permutation& perm,
+                       const uint8_t* data, unsigned threads, Fn&& fn) {
+    constexpr size_t kAhead = 32;
+    uint64_t skip = layout.skip(b);
+    parallel_for(count, threads, [&](size_t begin, size_t end) {
+        if (perm.empty()) {
+            for (size_t j = begin; j < end; ++j) fn(j, layout.buffer_offset(skip + j));
+            return;
+        }
+        uint64_t offsets[kAhead];
+        for (size_t j = begin; j < end; j += kAhead) {
+            size_t batch = std::min<size_t>(kAhead, end - j);
+            for (size_t k = 0; k < batch; ++k) {
+                offsets[k] = layout.buffer_offset(skip + perm[j + k]);
+                __builtin_prefetch(data + offsets[k], 1);
+            }
+            for (size_t k = 0; k < batch; ++k) fn(j + k, offsets[k]);
+        }
+    });
+}
+
+} // namespace
+
+uint64_t tiled_capacity(const BMPInfo& info) {
+    uint64_t channels = (uint64_t)info.width * info.height * 3;
+    if (channels < kBandRowsBits + 32) return 0;
+    return std::min<uint64_t>((channels - kBandRowsBits - 32) / 8, kLegacyMaxMessage);
+}
+
+TiledStats tiled_encode(const std::string& input, const std::string& output,
+                        const std::vector<uint8_t>& encoded, const TiledOptions& options) {
+    auto start = std::chrono::steady_clock::now();
+    BMPInfo info = probe_bmp(input);
+    if (options.band_rows <= 0 || options.band_rows > 0xFFFF)
+        throw std::runtime_error("Band height must be between 1 and 65535 rows");
+    BandLayout layout(info, std::min<uint64_t>(options.band_rows, info.height));
+    if (layout.domain(0) < 32) throw std::runtime_error("Band too small for the container header");
+    uint64_t cap = tiled_capacity(info);
+    if (encoded.size() > cap)
+        throw std::runtime_error("Message too large for image (capacity: " + std::to_string(cap) + " bytes)");
+
+    FileDescriptor in = open_for_read(input);
+    FileDescriptor out = open_for_write(output);
+    uint64_t in_size = file_size_of(in.get());
+    if (in_size < info.file_size) throw std::runtime_error("Truncated BMP pixel data");
+
+    // Headers (and anything before the pixel array) are copied verbatim
+    std::vector<uint8_t> header(info.data_offset);
+    pread_full(in.get(), header.data(), header.size(), 0);
+    pwrite_full(out.get(), header.data(), header.size(), 0);
+
+    uint64_t nbits = 32 + (uint64_t)encoded.size() * 8;
+    uint64_t payload_bands = layout.band_of(nbits - 1) + 1;
+
+    BoundedQueue<std::vector<uint8_t>> free_buffers(kPoolBuffers);
+    BoundedQueue<Band> to_compute(kPoolBuffers), to_write(kPoolBuffers);
+    for (size_t i = 0; i < kPoolBuffers; ++i) free_buffers.push(std::vector<uint8_t>(layout.buffer_size(0)));
+    PipelineError error;
+    std::unique_ptr<BandPermutations> perms;
+    if (!options.passphrase.empty())
+        perms = std::make_unique<BandPermutations>(layout, options.passphrase, payload_bands, options.threads);
+
+    std::thread reader([&] {
+        try {
+            for (uint64_t b = 0; b < payload_bands; ++b) {
+                Band band;
+                band.index = b;
+                if (!free_buffers.pop(band.data)) break;
+                band.data.resize(layout.buffer_size(b));
+                pread_full(in.get(), band.data.data(), band.data.size(), layout.file_offset(b));
+                if (!to_compute.push(std::move(band))) break;
+            }
+            to_compute.close();
+        } catch (...) {
+            error.fail(free_buffers, to_compute, to_write);
+        }
+    });
+
+    std::thread writer([&] {
+        try {
+            Band band;
+            while (to_write.pop(band)) {
+                pwrite_full(out.get(), band.data.data(), band.data.size(), layout.file_offset(band.index));
+                free_buffers.push(std::move(band.data));
+            }
+        } catch (...) {
+            error.fail(free_buffers, to_compute, to_write);
+        }
+    });
+
+    TiledStats stats;
+    try {
+        Band band;
+        while (to_compute.pop(band)) {
+            uint64_t b = band.index;
+            if (b == 0) {
+                for (size_t i = 0; i < kBandRowsBits; ++i) {
+                    uint8_t& ch = band.data[layout.buffer_offset(i)];
+                    ch = (ch & 0xFE) | ((layout.band_rows >> (kBandRowsBits - 1 - i)) & 1);
+                }
+            }
+            uint64_t base = layout.base(b);
+            uint64_t count = std::min<uint64_t>(layout.domain(b), nbits - base);
+            Permutation perm;
+            if (perms) perm = perms->take(b);
+            uint8_t* data = band.data.data();
+            for_band_channels(layout, b, count, perm, data, options.threads, [&](uint64_t j, uint64_t off) {
+                data[off] = (data[off] & 0xFE) | lsb_stream_bit(encoded, base + j);
+            });
+            ++stats.bands;
+            stats.bytes_processed += band.data.size();
+            if (!to_write.push(std::move(band))) break;
+        }
+        to_write.close();
+    } catch (...) {
+        error.fail(free_buffers, to_compute, to_write);
+    }
+    reader.join();
+    writer.join();
+    error.rethrow();
+
+    // Bands past the payload (and any trailing bytes) are unchanged
+    uint64_t tail = payload_bands < layout.bands ? layout.file_offset(payload_bands) : info.file_size;
+    copy_file_span(in.get(), out.get(), tail, in_size - tail);
+
+    stats.elapsed_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return stats;
+}
+
+std::vector<uint8_t> tiled_decode(const std::string& input, const TiledOptions& options, TiledStats* stats_out) {
+    auto start = std::chrono::steady_clock::now();
+    BMPInfo info = probe_bmp(input);
+    FileDescriptor in = open_for_read(input);
+    if (file_size_of(in.get()) < info.file_size) throw std::runtime_error("Truncated BMP pixel data");
+
+    // Plain band-height field in the first carrier channels
+    BandLayout probe(info, 1);
+    uint64_t band_rows = 0;
+    for (size_t i = 0; i < kBandRowsBits; ++i) {
+        uint8_t ch = 0;
+        pread_full(in.get(), &ch, 1, info.data_offset + probe.buffer_offset(i));
+        band_rows = (band_rows << 1) | (ch & 1);
+    }
+    if (band_rows == 0 || band_rows > (uint64_t)info.height) throw std::runtime_error("Not a tiled container or corrupted");
+    BandLayout layout(info, band_rows);
+    if (layout.domain(0) < 32) throw std::runtime_error("Not a tiled container or corrupted");
+
+    // Bands the reader may fetch; lowered once the length header is known
+    std::atomic<uint64_t> needed_bands(layout.bands);
+    BoundedQueue<Band> to_compute(kPoolBuffers - 1);
+    PipelineError error;
+    std::unique_ptr<BandPermutations> perms;
+    if (!options.passphrase.empty())
+        perms = std::make_unique<BandPermutations>(layout, options.passphrase, layout.bands, options.threads);
+
+    std::thread reader([&] {
+        try {
+            for (uint64_t b = 0; b < needed_bands.load(); ++b) {
+                Band band;
+                band.index = b;
+                band.data.resize(layout.buffer_size(b));
+                pread_full(in.get(), band.data.data(), band.data.size(), layout.file_offset(b));
+                if (!to_compute.push(std::move(band))) break;
+            }
+            to_compute.close();
+        } catch (...) {
+            error.fail(to_compute);
+        }
+    });
+
+    TiledStats stats;
+    std::vector<uint8_t> message;
+    uint64_t nbits = 0;
+    try {
+        Band band;
+        while (to_compute.pop(band)) {
+            uint64_t b = band.index;
+            if (nbits && b >= needed_bands.load()) break;
+            Permutation perm;
+            if (perms) perm = perms->take(b);
+            const uint8_t* data = band.data.data();
+            uint64_t skip = layout.skip(b);
+            auto channel = [&](uint64_t j) { return data[layout.buffer_offset(skip + (perm.empty() ? j : perm[j]))] & 1; };
+
+            uint64_t base = layout.base(b);
+            if (b == 0) {
+                uint64_t len = 0;
+                for (uint64_t j = 0; j < 32; ++j) len = (len << 1) | channel(j);
+                if (len > tiled_capacity(info)) throw std::runtime_error("Message too large or corrupted");
+                message.assign(len, 0);
+                nbits = 32 + len * 8;
+                needed_bands = layout.band_of(nbits - 1) + 1;
+                if (perms) perms->limit(needed_bands);
+            }
+
+            // Parallel over whole message bytes so no two workers share a byte
+            uint64_t first_bit = std::max<uint64_t>(base, 32);
+            uint64_t last_bit = std::min<uint64_t>(base + layout.domain(b), nbits);
+            if (first_bit < last_bit) {
+                uint64_t first_byte = (first_bit - 32) / 8, last_byte = (last_bit - 32 + 7) / 8;
+                parallel_for(last_byte - first_byte, options.threads, [&](size_t begin, size_t end) {
+                    for (size_t k = first_byte + begin; k < first_byte + end; ++k) {
+                        uint8_t byte = message[k];
+                        for (int bit = 0; bit < 8; ++bit) {
+                            uint64_t i = 32 + k * 8 + bit;
+                            if (i >= first_bit && i < last_bit) byte |= channel(i - base) << (7 - bit);
+                        }
+                        message[k] = byte;
+                    }
+                });
+            }
+            ++stats.bands;
+            stats.bytes_processed += band.data.size();
+        }
+    } catch (...) {
+        error.fail(to_compute);
+    }
+    to_compute.close();
+    reader.join();
+    error.rethrow();
+    if (stats.bands < needed_bands.load()) throw std::runtime_error("Image too small or corrupted");
+
+    stats.elapsed_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    if (stats_out) *stats_out = stats;
+    return message;
+}
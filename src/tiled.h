@@ -0,0 +1,38 @@
+// tiled.h
+// Band-streamed LSB embedding for covers too large to load at once
+#pragma once
+#include "bmp.h"
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// The tiled container walks the pixel array in storage (file) order, split
+// into bands of `band_rows` stored rows. The first 16 channels hold the band
+// height in plain LSBs; the remaining channels carry the lsb_encode stream
+// (32-bit length + message). With a passphrase, each band is ordered by its
+// own keyed permutation, so positions are computable from that band alone.
+struct TiledOptions {
+    int band_rows = 256;     // stored rows per band (decode reads it from the cover)
+    unsigned threads = 0;    // embed workers per band, 0 = hardware concurrency
+    std::string passphrase;  // per-band keyed ordering when non-empty
+};
+
+struct TiledStats {
+    size_t bands = 0;             // bands pushed through the compute stage
+    uint64_t bytes_processed = 0; // pixel bytes read for those bands
+    double elapsed_ms = 0;
+};
+
+// Maximum message bytes a tiled container can hold in this cover.
+uint64_t tiled_capacity(const BMPInfo& info);
+
+// Streams `input` to `output` band by band: an I/O thread prefetches band N+1
+// with pread while workers embed into band N and a writer thread flushes
+// band N-1. Bands past the payload are copied without passing through memory
+// where the kernel allows. Throws std::runtime_error on error.
+TiledStats tiled_encode(const std::string& input, const std::string& output,
+                        const std::vector<uint8_t>& encoded, const TiledOptions& options);
+
+// Extracts the message, reading only the bands that carry it.
+std::vector<uint8_t> tiled_decode(const std::string& input, const TiledOptions& options,
+                                  TiledStats* stats = nullptr);
@@ -0,0 +1,30 @@
+// update.h
+// In-place payload refresh for already-encoded BMP files
+#pragma once
+#include "kernels.h"
+#include <string>
+#include <vector>
+#include <cstdint>
+
+struct UpdateStats {
+    bool container = false;        // TFK1 container, re-embedded with its own kernel
+    KernelParams params;           // that kernel (containers only)
+    bool old_header_valid = false; // existing length header fits the image
+    size_t old_payload_bytes = 0;  // length in the existing header: message bytes
+                                   // for a container, encoded bytes for the legacy layout
+    size_t bits_compared = 0;      // channel LSBs covered by the new bitstream
+    size_t bytes_written = 0;      // channel bytes whose LSB actually changed
+    size_t pages_dirtied = 0;      // distinct file pages touched by those writes (legacy only)
+    uint64_t file_size = 0;
+    double elapsed_ms = 0;
+};
+
+// Replaces the payload of an already-encoded BMP in place. The file is
+// mapped read-write and only channel bytes that change are stored, so
+// untouched pages are never dirtied. A container found under `passphrase`
+// is re-embedded with the kernel parameters from its header; otherwise the
+// legacy layout (Hamming-encoded `message` behind a 32-bit length) is
+// rewritten. Throws std::runtime_error when the image holds neither for
+// this passphrase, on overflow or on I/O error.
+UpdateStats lsb_update_file(const std::string& filename, const std::vector<uint8_t>& message,
+                            const std::string& passphrase);
@@ -0,0 +1,142 @@
+// test_async.cpp
+// Awaitable jobs: admission queue bound with parked coroutines (-std=c++20)
+#include "src/async.h"
+#include "src/bmp.h"
+#include <cassert>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+
+#ifndef TF_HAS_COROUTINES
+#error "test_async needs C++20 coroutines (-std=c++20)"
+#endif
+
+// Fire-and-forget coroutine: runs until its first suspension when called
+struct Detached {
+    struct promise_type {
+        Detached get_return_object() { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+};
+
+std::vector<uint8_t> make_cover_file() {
+    BMPImage img;
+    img.width = 64;
+    img.height = 48;
+    img.data.resize((size_t)img.width * img.height * 3);
+    std::mt19937 rng(5);
+    for (auto& b : img.data) b = (uint8_t)rng();
+    return encode_bmp(img);
+}
+
+struct Results {
+    std::mutex mutex;
+    std::condition_variable changed;
+    size_t done = 0;
+    size_t failed = 0;
+    std::vector<std::vector<uint8_t>> files;
+};
+
+Detached publish(const std::vector<uint8_t>& cover, std::vector<uint8_t> message, JobOptions options,
+                 Results& results, size_t index) {
+    EncodeJob job;
+    job.input_bytes = cover;
+    job.message = std::move(message);
+    bool ok = true;
+    EncodeJobResult result;
+    try {
+        result = co_await encode_async(std::move(job), options);
+    } catch (const std::exception&) {
+        ok = false;
+    }
+    std::lock_guard<std::mutex> lock(results.mutex);
+    results.files[index] = std::move(result.file);
+    if (!ok) ++results.failed;
+    ++results.done;
+    results.changed.notify_all();
+}
+
+void test_park_bound() {
+    // One job in flight, kQueued in the admission queue, kQueued parked
+    // waiters; one more caller has to block
+    const size_t kQueued = 3, kSuspended = 1 + 2 * kQueued, kJobs = kSuspended + 1;
+    JobExecutor executor(1, 1, kQueued);
+    std::vector<uint8_t> cover = make_cover_file();
+
+    // Hold the only worker so every job has to wait for admission
+    std::promise<void> gate;
+    std::shared_future<void> opened = gate.get_future().share();
+    executor.post([opened] { opened.wait(); });
+
+    std::atomic<size_t> max_queued{0};
+    JobOptions options;
+    options.executor = &executor;
+    options.progress = [&](const JobProgress&) {
+        size_t q = executor.queued(), seen = max_queued.load();
+        while (q > seen && !max_queued.compare_exchange_weak(seen, q)) {}
+    };
+
+    Results results;
+    results.files.resize(kJobs);
+    std::vector<std::vector<uint8_t>> messages(kJobs);
+    for (size_t i = 0; i < kJobs; ++i) messages[i].assign(20 + i, (uint8_t)('a' + i));
+    for (size_t i = 0; i < kSuspended; ++i) publish(cover, messages[i], options, results, i);
+    assert(executor.in_flight() == 1);
+    assert(executor.queued() == kQueued);
+
+    std::atomic<bool> overflow_started{false};
+    std::thread overflow([&] {
+        publish(cover, messages[kJobs - 1], options, results, kJobs - 1);
+        overflow_started = true;
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    assert(!overflow_started);
+    {
+        std::lock_guard<std::mutex> lock(results.mutex);
+        assert(results.done == 0);
+    }
+
+    gate.set_value();
+    overflow.join();
+    {
+        std::unique_lock<std::mutex> lock(results.mutex);
+        bool finished = results.changed.wait_for(lock, std::chrono::seconds(60), [&] { return results.done == kJobs; });
+        assert(finished);
+    }
+    assert(results.failed == 0);
+    assert(max_queued.load() <= kQueued);
+    for (size_t i = 0; i < kJobs; ++i) {
+        DecodedMessage decoded = decode_message_bytes(results.files[i].data(), results.files[i].size(), "");
+        assert(decoded.data == messages[i]);
+    }
+    std::cout << "[PASS] Parked awaitables keep the admission queue at " << kQueued << " (" << kJobs << " jobs)\n";
+}
+
+void test_park_after_idle() {
+    // Room is free: the awaitable starts at once and the executor drains
+    JobExecutor executor(2, 0, 0);
+    std::vector<uint8_t> cover = make_cover_file();
+    JobOptions options;
+    options.executor = &executor;
+    Results results;
+    results.files.resize(1);
+    std::vector<uint8_t> message(100, 'z');
+    publish(cover, message, options, results, 0);
+    std::unique_lock<std::mutex> lock(results.mutex);
+    bool finished = results.changed.wait_for(lock, std::chrono::seconds(60), [&] { return results.done == 1; });
+    assert(finished && results.failed == 0);
+    assert(decode_message_bytes(results.files[0].data(), results.files[0].size(), "").data == message);
+    std::cout << "[PASS] Awaitable admitted directly when room is free\n";
+}
+
+int main() {
+    test_park_bound();
+    test_park_after_idle();
+    std::cout << "All async tests passed!\n";
+    return 0;
+}
@@ -0,0 +1,678 @@
+// test_differential.cpp
+// Differential and fuzz harness: the LSB, Hamming and permutation code
+// against frozen scalar references, BMP header fuzzing, and a golden corpus
+// of stego images that every future build must still decode.
+//
+//   ./test_differential [--seconds N] [--seed N] [--golden DIR] [--write-golden]
+//
+// Built with -fsanitize=fuzzer -DTF_LIBFUZZER, only LLVMFuzzerTestOneInput
+// remains and libFuzzer drives it.
+#include "src/bmp.h"
+#include "src/container.h"
+#include "src/hamming.h"
+#include "src/kernels.h"
+#include "src/lsb.h"
+#include "src/png.h"
+#include "src/prng_permute.h"
+#include "src/stego.h"
+#include "src/stream_io.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+// Frozen copies of the scalar code every stego image written so far depends
+// on. Never edit these to make a test pass: a mismatch means the optimized
+// code changed the on-disk format.
+namespace ref {
+
+uint8_t hamming_encode_nibble(uint8_t nibble) {
+    uint8_t d0 = (nibble >> 0) & 1;
+    uint8_t d1 = (nibble >> 1) & 1;
+    uint8_t d2 = (nibble >> 2) & 1;
+    uint8_t d3 = (nibble >> 3) & 1;
+    uint8_t p0 = d3 ^ d2 ^ d0;
+    uint8_t p1 = d3 ^ d1 ^ d0;
+    uint8_t p2 = d2 ^ d1 ^ d0;
+    return (p0 << 6) | (p1 << 5) | (d3 << 4) | (p2 << 3) | (d2 << 2) | (d1 << 1) | d0;
+}
+
+uint8_t hamming_decode_codeword(uint8_t codeword, bool& had_error) {
+    had_error = false;
+    uint8_t p0 = (codeword >> 6) & 1, p1 = (codeword >> 5) & 1, d3 = (codeword >> 4) & 1;
+    uint8_t p2 = (codeword >> 3) & 1, d2 = (codeword >> 2) & 1, d1 = (codeword >> 1) & 1;
+    uint8_t d0 = codeword & 1;
+    uint8_t syndrome = (uint8_t)(((p0 ^ d3 ^ d2 ^ d0) << 2) | ((p1 ^ d3 ^ d1 ^ d0) << 1) | (p2 ^ d2 ^ d1 ^ d0));
+    if (syndrome) {
+        had_error = true;
+        static const int syndrome_to_bit[] = {-1, 3, 5, 1, 6, 2, 4, 0};
+        codeword ^= (uint8_t)(1 << syndrome_to_bit[syndrome]);
+    }
+    return (uint8_t)((((codeword >> 4) & 1) << 3) | (codeword & 0x7));
+}
+
+// Channel index of carrier `c`: every channel for the full mask, otherwise
+// the masked channels of each whole pixel in B, G, R order.
+size_t carrier_index(uint8_t mask, size_t c) {
+    if (mask == 0x7) return c;
+    int per_pixel = kernels::mask_popcount(mask);
+    size_t pixel = c / per_pixel;
+    int nth = (int)(c % per_pixel);
+    for (int ch = 0; ch < 3; ++ch)
+        if ((mask & (1 << ch)) && nth-- == 0) return pixel * 3 + ch;
+    return 0;
+}
+
+size_t carriers(uint8_t mask, size_t n_channels) {
+    return mask == 0x7 ? n_channels : n_channels / 3 * kernels::mask_popcount(mask);
+}
+
+int unit_bits(EccType ecc) { return ecc == EccType::Hamming74 ? 14 : 8; }
+
+// Payload as the bit stream the carriers take, zero-padded to whole channels.
+std::vector<uint8_t> payload_bits(const KernelParams& p, const uint8_t* payload, size_t bytes) {
+    std::vector<uint8_t> bits;
+    int ub = unit_bits(p.ecc);
+    for (size_t i = 0; i < bytes; ++i) {
+        uint32_t unit = payload[i];
+        if (p.ecc == EccType::Hamming74)
+            unit = ((uint32_t)hamming_encode_nibble(payload[i] >> 4) << 7) | hamming_encode_nibble(payload[i] & 0xF);
+        for (int k = 0; k < ub; ++k)
+            bits.push_back((uint8_t)((unit >> (p.order == BitOrder::MsbFirst ? ub - 1 - k : k)) & 1));
+    }
+    while (bits.size() % p.bits_per_channel) bits.push_back(0);
+    return bits;
+}
+
+int bit_position(const KernelParams& p, int j) {
+    return p.order == BitOrder::MsbFirst ? p.bits_per_channel - 1 - j : j;
+}
+
+size_t capacity(const KernelParams& p, size_t n_channels) {
+    return carriers(p.channel_mask, n_channels) * p.bits_per_channel / unit_bits(p.ecc);
+}
+
+void embed(const KernelParams& p, uint8_t* channels, const uint8_t* payload, size_t bytes) {
+    std::vector<uint8_t> bits = payload_bits(p, payload, bytes);
+    for (size_t c = 0; c * p.bits_per_channel < bits.size(); ++c) {
+        uint8_t& ch = channels[carrier_index(p.channel_mask, c)];
+        for (int j = 0; j < p.bits_per_channel; ++j) {
+            int pos = bit_position(p, j);
+            ch = (uint8_t)((ch & ~(1 << pos)) | (bits[c * p.bits_per_channel + j] << pos));
+        }
+    }
+}
+
+// LSB matching: carrier c steps down when its keyed sign bit is set (never
+// below 0) and always at 255. Sign bits come from splitmix64 draws, each
+// covering 64 carriers as eight lanes of eight.
+void embed_matching(const KernelParams& p, uint8_t* channels, const uint8_t* payload, size_t bytes, uint64_t seed) {
+    std::vector<uint8_t> bits = payload_bits(p, payload, bytes);
+    for (size_t c = 0; c < bits.size(); ++c) {
+        size_t group = c / 8;
+        uint64_t z = seed + (group / 8 + 1) * 0x9E3779B97F4A7C15ull;
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        z ^= z >> 31;
+        int sign = (int)((z >> (8 * (c % 8) + group % 8)) & 1);
+        uint8_t& ch = channels[carrier_index(p.channel_mask, c)];
+        if ((ch & 1) == bits[c]) continue;
+        if (ch == 255 || (sign && ch != 0)) --ch;
+        else ++ch;
+    }
+}
+
+size_t extract(const KernelParams& p, const uint8_t* channels, uint8_t* payload, size_t bytes) {
+    int ub = unit_bits(p.ecc);
+    size_t corrected = 0, bit = 0;
+    auto next_bit = [&] {
+        size_t c = bit / p.bits_per_channel;
+        int j = (int)(bit % p.bits_per_channel);
+        ++bit;
+        return (channels[carrier_index(p.channel_mask, c)] >> bit_position(p, j)) & 1;
+    };
+    for (size_t i = 0; i < bytes; ++i) {
+        uint32_t unit = 0;
+        for (int k = 0; k < ub; ++k) {
+            uint32_t b = (uint32_t)next_bit();
+            if (p.order == BitOrder::MsbFirst) unit = (unit << 1) | b;
+            else unit |= b << k;
+        }
+        if (p.ecc == EccType::Hamming74) {
+            bool hi_error = false, lo_error = false;
+            uint8_t hi = hamming_decode_codeword((uint8_t)((unit >> 7) & 0x7F), hi_error);
+            uint8_t lo = hamming_decode_codeword((uint8_t)(unit & 0x7F), lo_error);
+            corrected += hi_error + lo_error;
+            payload[i] = (uint8_t)((hi << 4) | lo);
+        } else {
+            payload[i] = (uint8_t)unit;
+        }
+    }
+    return corrected;
+}
+
+const KernelParams kLegacy{1, 0x7, BitOrder::MsbFirst, EccType::None};
+
+void lsb_encode(BMPImage& img, const std::vector<uint8_t>& message, EmbedMode mode, uint64_t seed) {
+    if (img.data.size() < 32) throw std::runtime_error("Image too small");
+    if (message.size() > (img.data.size() - 32) / 8) throw std::runtime_error("Message too large for image");
+    uint32_t len = (uint32_t)message.size();
+    uint8_t header[4] = {(uint8_t)(len >> 24), (uint8_t)(len >> 16), (uint8_t)(len >> 8), (uint8_t)len};
+    if (mode == EmbedMode::Match) {
+        embed_matching(kLegacy, img.data.data(), header, 4, seed);
+        embed_matching(kLegacy, img.data.data() + 32, message.data(), message.size(), seed + 1);
+    } else {
+        embed(kLegacy, img.data.data(), header, 4);
+        embed(kLegacy, img.data.data() + 32, message.data(), message.size());
+    }
+}
+
+std::vector<uint8_t> lsb_decode(const BMPImage& img, size_t max_bytes) {
+    if (img.data.size() < 32) throw std::runtime_error("Image too small or corrupted");
+    uint8_t header[4];
+    extract(kLegacy, img.data.data(), header, 4);
+    size_t len = ((size_t)header[0] << 24) | ((size_t)header[1] << 16) | ((size_t)header[2] << 8) | header[3];
+    if (len > max_bytes || 32 + len * 8 > img.data.size()) throw std::runtime_error("Message too large or corrupted");
+    std::vector<uint8_t> message(len);
+    extract(kLegacy, img.data.data() + 32, message.data(), len);
+    return message;
+}
+
+uint32_t hash_passphrase(const std::string& pass) {
+    uint32_t h = 2166136261u;
+    for (char c : pass) {
+        h ^= (uint8_t)c;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+// std::shuffle is only as frozen as the standard library; the golden corpus
+// catches a library that shuffles differently.
+std::vector<size_t> prng_permutation(size_t n, const std::string& passphrase) {
+    std::vector<size_t> perm(n);
+    for (size_t i = 0; i < n; ++i) perm[i] = i;
+    std::mt19937 rng(hash_passphrase(passphrase));
+    std::shuffle(perm.begin(), perm.end(), rng);
+    return perm;
+}
+
+std::vector<size_t> prng_permutation(size_t n, const std::string& passphrase, uint64_t stream) {
+    std::vector<size_t> perm(n);
+    for (size_t i = 0; i < n; ++i) perm[i] = i;
+    std::seed_seq seed{hash_passphrase(passphrase), (uint32_t)stream, (uint32_t)(stream >> 32)};
+    std::mt19937 rng(seed);
+    std::shuffle(perm.begin(), perm.end(), rng);
+    return perm;
+}
+
+uint64_t mix64(uint64_t z) {
+    z += 0x9E3779B97F4A7C15ull;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+// Six-round Feistel over the enclosing power-of-four domain, cycle-walked into [0, n).
+uint64_t keyed_forward(uint64_t n, const std::string& passphrase, uint64_t stream, uint64_t i) {
+    int bits = 0;
+    while (bits < 64 && (1ull << bits) < n) ++bits;
+    int half_bits = std::max((bits + 1) / 2, 1);
+    uint64_t half_mask = (1ull << half_bits) - 1, keys[6];
+    uint64_t state = mix64(((uint64_t)hash_passphrase(passphrase) << 32) ^ mix64(stream));
+    for (auto& k : keys) k = state = mix64(state);
+    uint64_t x = i;
+    do {
+        uint64_t left = x >> half_bits, right = x & half_mask;
+        for (int r = 0; r < 6; ++r) {
+            uint64_t next = left ^ (mix64(keys[r] ^ right) & half_mask);
+            left = right;
+            right = next;
+        }
+        x = (left << half_bits) | right;
+    } while (x >= n);
+    return x;
+}
+
+} // namespace ref
+
+namespace {
+
+uint64_t g_cases = 0;
+
+[[noreturn]] void fail(const char* suite, const std::string& what, uint64_t seed) {
+    std::printf("[FAIL] %s: %s (case seed %llu)\n", suite, what.c_str(), (unsigned long long)seed);
+    std::exit(1);
+}
+
+// Every random case draws from its own seed, printed on failure so the case
+// can be rerun on its own.
+struct Case {
+    std::mt19937_64 rng;
+    explicit Case(uint64_t seed) : rng(seed) {}
+    uint64_t below(uint64_t n) { return n ? rng() % n : 0; }
+    std::vector<uint8_t> bytes(size_t n) {
+        std::vector<uint8_t> out(n);
+        for (auto& b : out) b = (uint8_t)rng();
+        return out;
+    }
+    std::string passphrase() {
+        std::string s(below(12), ' ');
+        for (auto& c : s) c = (char)(32 + below(95));
+        return s;
+    }
+};
+
+std::vector<KernelParams> all_kernel_params() {
+    std::vector<KernelParams> all;
+    for (int bits : {1, 2, 4})
+        for (uint8_t mask = 1; mask <= 7; ++mask)
+            for (BitOrder order : {BitOrder::MsbFirst, BitOrder::LsbFirst})
+                for (EccType ecc : {EccType::None, EccType::Hamming74}) {
+                    KernelParams p{bits, mask, order, ecc};
+                    if (kernel_params_valid(p)) all.push_back(p);
+                }
+    return all;
+}
+
+std::string describe(const KernelParams& p) {
+    return std::to_string(p.bits_per_channel) + "b mask " + std::to_string(p.channel_mask) +
+           (p.order == BitOrder::MsbFirst ? " msb" : " lsb") + (p.ecc == EccType::Hamming74 ? " hamming" : "");
+}
+
+void test_hamming() {
+    const auto& enc = kernels::hamming_encode_table();
+    const auto& dec = kernels::hamming_decode_table();
+    for (int n = 0; n < 16; ++n) {
+        if (hamming74_encode_nibble((uint8_t)n) != ref::hamming_encode_nibble((uint8_t)n) ||
+            enc[n] != ref::hamming_encode_nibble((uint8_t)n))
+            fail("hamming", "encode nibble " + std::to_string(n), 0);
+    }
+    for (int cw = 0; cw < 128; ++cw) {
+        bool err = false, ref_err = false;
+        uint8_t nibble = hamming74_decode_codeword((uint8_t)cw, err);
+        uint8_t expected = ref::hamming_decode_codeword((uint8_t)cw, ref_err);
+        if (nibble != expected || err != ref_err || dec[cw] != (expected | (ref_err ? 0x10 : 0)))
+            fail("hamming", "decode codeword " + std::to_string(cw), 0);
+    }
+    g_cases += 16 + 128;
+}
+
+// All kernel specializations against embed_generic and the reference, with
+// random lengths, carriers and bit errors.
+uint64_t run_kernels(uint64_t seed) {
+    static const std::vector<KernelParams> all = all_kernel_params();
+    Case c(seed);
+    const KernelParams& p = all[c.below(all.size())];
+    const KernelOps& ops = select_kernel(p);
+    size_t n = (size_t)c.below(600);
+    auto cover = c.bytes(n);
+    size_t cap = ref::capacity(p, n);
+    if (ops.capacity(n) != cap) fail("kernels", describe(p) + " capacity", seed);
+    size_t bytes = (size_t)c.below(cap + 1);
+    auto payload = c.bytes(bytes);
+    if (bytes && ops.span(bytes) > n) fail("kernels", describe(p) + " span past the carrier", seed);
+
+    auto expected = cover, fast = cover, generic = cover;
+    ref::embed(p, expected.data(), payload.data(), bytes);
+    ops.embed(fast.data(), n, payload.data(), bytes);
+    embed_generic(p, generic.data(), n, payload.data(), bytes);
+    if (fast != expected) fail("kernels", describe(p) + " embed", seed);
+    if (generic != expected) fail("kernels", describe(p) + " embed_generic", seed);
+
+    if (ops.embed_matching) {
+        uint64_t key = c.rng();
+        auto matched = cover, ref_matched = cover;
+        ops.embed_matching(matched.data(), n, payload.data(), bytes, key);
+        ref::embed_matching(p, ref_matched.data(), payload.data(), bytes, key);
+        if (matched != ref_matched) fail("kernels", describe(p) + " embed_matching", seed);
+    }
+
+    // Flip a few low bits so Hamming has something to correct (or miscorrect)
+    for (int flips = (int)c.below(4); flips > 0 && n; --flips) expected[c.below(n)] ^= (uint8_t)(1 << c.below(4));
+    std::vector<uint8_t> out(bytes), ref_out(bytes), generic_out(bytes);
+    size_t corrected = ops.extract(expected.data(), n, out.data(), bytes);
+    size_t ref_corrected = ref::extract(p, expected.data(), ref_out.data(), bytes);
+    size_t generic_corrected = extract_generic(p, expected.data(), n, generic_out.data(), bytes);
+    if (out != ref_out || corrected != ref_corrected) fail("kernels", describe(p) + " extract", seed);
+    if (generic_out != ref_out || generic_corrected != ref_corrected)
+        fail("kernels", describe(p) + " extract_generic", seed);
+    return 1;
+}
+
+uint64_t run_lsb(uint64_t seed) {
+    Case c(seed);
+    BMPImage img;
+    img.width = 1 + (int)c.below(24);
+    img.height = 1 + (int)c.below(24);
+    img.data = c.bytes((size_t)img.width * img.height * 3);
+    size_t cap = lsb_capacity(img);
+    auto message = c.bytes((size_t)c.below(cap + 2));
+    EmbedMode mode = c.below(2) ? EmbedMode::Match : EmbedMode::Replace;
+    uint64_t key = c.rng();
+
+    BMPImage fast = img, expected = img;
+    bool threw = false, ref_threw = false;
+    try { lsb_encode(fast, message, mode, key); } catch (const std::runtime_error&) { threw = true; }
+    try { ref::lsb_encode(expected, message, mode, key); } catch (const std::runtime_error&) { ref_threw = true; }
+    if (threw != ref_threw) fail("lsb", "overflow check", seed);
+    if (threw) return 1;
+    if (fast.data != expected.data) fail("lsb", "lsb_encode", seed);
+    if (lsb_decode(fast, cap) != ref::lsb_decode(expected, cap) || ref::lsb_decode(expected, cap) != message)
+        fail("lsb", "lsb_decode", seed);
+    return 1;
+}
+
+uint64_t run_permutation(uint64_t seed) {
+    Case c(seed);
+    // Past 65536 entries shuffles take the batched path; cover it now and then
+    size_t n = c.below(64) ? (size_t)c.below(4096) : 65536 + (size_t)c.below(1 << 17);
+    std::string pass = c.passphrase();
+    uint64_t stream = c.below(3) ? c.rng() : 0;
+
+    Permutation perm = prng_permutation(n, pass);
+    if (!std::equal(perm.begin(), perm.end(), ref::prng_permutation(n, pass).begin()) || perm.size() != n)
+        fail("permutation", "prng_permutation n=" + std::to_string(n), seed);
+    Permutation streamed = prng_permutation(n, pass, stream);
+    auto ref_streamed = ref::prng_permutation(n, pass, stream);
+    if (!std::equal(streamed.begin(), streamed.end(), ref_streamed.begin()))
+        fail("permutation", "prng_permutation with stream", seed);
+
+    auto data = c.bytes(n);
+    auto gathered = apply_permutation(data, perm);
+    for (size_t i = 0; i < n; ++i)
+        if (gathered[i] != data[perm[i]]) fail("permutation", "apply_permutation", seed);
+    if (invert_permutation(gathered, perm) != data) fail("permutation", "invert_permutation", seed);
+    auto pixels = c.bytes(n * 3);
+    auto moved = apply_pixel_permutation(pixels, perm);
+    for (size_t i = 0; i < n; ++i)
+        if (std::memcmp(&moved[i * 3], &pixels[perm[i] * 3], 3) != 0) fail("permutation", "apply_pixel", seed);
+    if (invert_pixel_permutation(moved, perm) != pixels) fail("permutation", "invert_pixel", seed);
+
+    if (n) {
+        KeyedBijection keyed(n, pass, stream);
+        for (int k = 0; k < 16; ++k) {
+            uint64_t i = c.below(n);
+            uint64_t at = keyed.forward(i);
+            if (at != ref::keyed_forward(n, pass, stream, i) || keyed.inverse(at) != i)
+                fail("permutation", "KeyedBijection", seed);
+        }
+    }
+    return 1;
+}
+
+// Band-parallel PNG compression must not depend on the worker count.
+uint64_t run_png_threads(uint64_t seed) {
+    Case c(seed);
+    BMPImage img;
+    img.width = 1 + (int)c.below(48);
+    img.height = 1 + (int)c.below(48);
+    img.data = c.bytes((size_t)img.width * img.height * 3);
+    // Smooth some rows so the match finder and filters have work
+    for (size_t i = 3; i < img.data.size(); i += 1 + c.below(3)) img.data[i] = img.data[i - 3];
+    PngOptions options;
+    options.band_rows = 1 + (int)c.below(16);
+    options.level = 1 + (int)c.below(9);
+    options.threads = 1;
+    std::vector<uint8_t> single = encode_png(img, options);
+    for (unsigned threads : {2u, 3u, 8u}) {
+        options.threads = threads;
+        if (encode_png(img, options) != single) fail("png", std::to_string(threads) + " threads", seed);
+    }
+    if (decode_png(single.data(), single.size()).data != img.data) fail("png", "round trip", seed);
+    return 1;
+}
+
+uint64_t fuzz_bmp_seed(uint64_t seed);
+
+struct Suite {
+    const char* name;
+    uint64_t (*run)(uint64_t seed);
+    double share;  // of the time budget
+};
+
+void run_suites(double seconds, uint64_t base_seed) {
+    const Suite suites[] = {
+        {"kernels vs reference", run_kernels, 0.35},
+        {"lsb_encode/lsb_decode vs reference", run_lsb, 0.15},
+        {"permutations vs reference", run_permutation, 0.15},
+        {"PNG bands across thread counts", run_png_threads, 0.1},
+        {"BMP header fuzzing", fuzz_bmp_seed, 0.25},
+    };
+    for (const Suite& suite : suites) {
+        auto start = std::chrono::steady_clock::now();
+        auto budget = std::chrono::duration<double>(seconds * suite.share);
+        uint64_t cases = 0, i = 0;
+        do {
+            for (int k = 0; k < 64; ++k) cases += suite.run(base_seed + (i++ << 8) + (&suite - suites));
+        } while (std::chrono::steady_clock::now() - start < budget);
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        g_cases += cases;
+        std::printf("[PASS] %s: %llu cases, %.2f M/min\n", suite.name, (unsigned long long)cases,
+                    cases / elapsed * 60 / 1e6);
+    }
+}
+
+// Golden corpus: small stego images made once with the code as it stands
+// and kept in the tree. Each must still decode to its message, and
+// re-encoding must reproduce it bit for bit (pixels for PNG, whose deflate
+// output may improve).
+enum class GoldenKind { Legacy, Container, Png };
+
+struct GoldenCase {
+    const char* file;
+    GoldenKind kind;
+    const char* passphrase;
+    KernelParams params;
+    EmbedMode mode;
+};
+
+const GoldenCase kGolden[] = {
+    {"legacy.bmp", GoldenKind::Legacy, "", {}, EmbedMode::Replace},
+    {"legacy_keyed.bmp", GoldenKind::Legacy, "golden", {}, EmbedMode::Replace},
+    {"legacy_match_keyed.bmp", GoldenKind::Legacy, "golden", {}, EmbedMode::Match},
+    {"container.bmp", GoldenKind::Container, "", {1, 0x7, BitOrder::MsbFirst, EccType::Hamming74}, EmbedMode::Replace},
+    {"container_keyed.bmp", GoldenKind::Container, "golden", {1, 0x7, BitOrder::MsbFirst, EccType::Hamming74},
+     EmbedMode::Replace},
+    {"container_2bit_rg_lsb_keyed.bmp", GoldenKind::Container, "golden", {2, 0x6, BitOrder::LsbFirst, EccType::None},
+     EmbedMode::Replace},
+    {"container_4bit_b.bmp", GoldenKind::Container, "", {4, 0x1, BitOrder::MsbFirst, EccType::Hamming74},
+     EmbedMode::Replace},
+    {"container_match_keyed.bmp", GoldenKind::Container, "golden", {1, 0x7, BitOrder::MsbFirst, EccType::Hamming74},
+     EmbedMode::Match},
+    {"container.png", GoldenKind::Png, "", {1, 0x7, BitOrder::MsbFirst, EccType::Hamming74}, EmbedMode::Replace},
+    {"container_keyed.png", GoldenKind::Png, "golden", {1, 0x7, BitOrder::MsbFirst, EccType::Hamming74},
+     EmbedMode::Replace},
+};
+
+// Covers and messages come from a fixed xorshift, not <random>, so they do
+// not depend on the standard library either.
+BMPImage golden_cover(uint32_t index) {
+    BMPImage img;
+    img.width = 40;
+    img.height = 30;
+    img.data.resize((size_t)img.width * img.height * 3);
+    uint32_t x = 0x9E3779B9u * (index + 1);
+    for (auto& b : img.data) {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        b = (uint8_t)(x >> 24);
+    }
+    return img;
+}
+
+std::vector<uint8_t> golden_message(uint32_t index) {
+    std::string text = "Golden message " + std::to_string(index) + ": every build must still read this.";
+    return std::vector<uint8_t>(text.begin(), text.end());
+}
+
+std::vector<uint8_t> make_golden(const GoldenCase& g, uint32_t index) {
+    BMPImage img = golden_cover(index);
+    std::vector<uint8_t> message = golden_message(index);
+    ContainerOptions options;
+    options.params = g.params;
+    options.mode = g.mode;
+    options.passphrase = g.passphrase;
+    switch (g.kind) {
+    case GoldenKind::Legacy:
+        embed_legacy(img, hamming74_encode(message), g.passphrase, g.mode);
+        return encode_bmp(img);
+    case GoldenKind::Container:
+        container_encode(img, message, options);
+        return encode_bmp(img);
+    case GoldenKind::Png: {
+        std::string cover = (fs::temp_directory_path() / "tf_golden_cover.png").string();
+        std::string out = (fs::temp_directory_path() / "tf_golden_out.png").string();
+        write_png(cover, img);
+        png_embed(cover, out, message, options);
+        std::vector<uint8_t> bytes = read_all(out);
+        fs::remove(cover);
+        fs::remove(out);
+        return bytes;
+    }
+    }
+    return {};
+}
+
+void write_golden(const std::string& dir) {
+    fs::create_directories(dir);
+    for (uint32_t i = 0; i < sizeof(kGolden) / sizeof(kGolden[0]); ++i) {
+        std::vector<uint8_t> bytes = make_golden(kGolden[i], i);
+        write_all((fs::path(dir) / kGolden[i].file).string(), std::move(bytes));
+    }
+    std::printf("[PASS] wrote %zu golden images to %s\n", sizeof(kGolden) / sizeof(kGolden[0]), dir.c_str());
+}
+
+void check_golden(const std::string& dir) {
+    for (uint32_t i = 0; i < sizeof(kGolden) / sizeof(kGolden[0]); ++i) {
+        const GoldenCase& g = kGolden[i];
+        std::string path = (fs::path(dir) / g.file).string();
+        if (!fs::exists(path)) fail("golden", path + " missing (run from the repo root)", i);
+        std::vector<uint8_t> stored = read_all(path);
+        DecodedMessage decoded = decode_message_bytes(stored.data(), stored.size(), g.passphrase);
+        if (decoded.data != golden_message(i)) fail("golden", std::string(g.file) + " no longer decodes", i);
+        std::vector<uint8_t> fresh = make_golden(g, i);
+        bool same = g.kind == GoldenKind::Png
+                        ? decode_png(fresh.data(), fresh.size()).data == decode_png(stored.data(), stored.size()).data
+                        : fresh == stored;
+        if (!same) fail("golden", std::string(g.file) + " encodes differently", i);
+        ++g_cases;
+    }
+    std::printf("[PASS] golden corpus: %zu images decode and re-encode identically\n",
+                sizeof(kGolden) / sizeof(kGolden[0]));
+}
+
+} // namespace
+
+// BMP parsing must accept or reject any byte string with a runtime_error,
+// never crash, and whatever it accepts must survive a write/read round trip.
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+    BMPInfo info;
+    try {
+        info = parse_bmp_headers(data, size);
+    } catch (const std::runtime_error&) {
+        return 0;
+    }
+    if (info.width <= 0 || info.height <= 0 || info.data_offset < kBmpHeaderBytes ||
+        info.row_stride < (uint64_t)info.width * 3 || info.row_stride % 4)
+        std::abort();
+    BMPImage img;
+    try {
+        img = decode_bmp(data, size);
+    } catch (const std::runtime_error&) {
+        if (size >= info.file_size) std::abort();  // only truncation may fail past the headers
+        return 0;
+    }
+    if (img.data.size() != (size_t)info.width * info.height * 3) std::abort();
+    std::vector<uint8_t> again = encode_bmp(img);
+    if (decode_bmp(again.data(), again.size()).data != img.data) std::abort();
+    // Payload readers take whatever the pixels hold
+    try {
+        lsb_decode(img, 1 << 16);
+    } catch (const std::runtime_error&) {
+    }
+    std::vector<uint8_t> message;
+    container_try_decode(img, "", message);
+    return 0;
+}
+
+namespace {
+
+// Built-in mutator for builds without libFuzzer: valid tiny BMPs with their
+// header fields, sizes and bytes perturbed.
+uint64_t fuzz_bmp_seed(uint64_t seed) {
+    Case c(seed);
+    BMPImage img;
+    img.width = 1 + (int)c.below(9);
+    img.height = 1 + (int)c.below(9);
+    img.data = c.bytes((size_t)img.width * img.height * 3);
+    std::vector<uint8_t> file = encode_bmp(img);
+    auto put32 = [&](size_t at, uint32_t v) { std::memcpy(&file[at], &v, 4); };
+    const size_t fields[] = {18, 22, 10, 28, 30};  // width, height, offset, bit count, compression
+    const uint32_t edges[] = {0, 1, 3, 54, 0x7FFFFFFF, 0x80000000u, 0xFFFFFFFFu, (uint32_t)-(int32_t)img.height};
+    switch (c.below(5)) {
+    case 0:  // one header field, often set to an edge value
+        put32(fields[c.below(5)], c.below(2) ? edges[c.below(8)] : (uint32_t)c.rng());
+        break;
+    case 1:  // a few random bytes anywhere in the headers
+        for (int k = 1 + (int)c.below(4); k > 0; --k) file[c.below(kBmpHeaderBytes)] = (uint8_t)c.rng();
+        break;
+    case 2:  // truncation
+        file.resize(c.below(file.size()));
+        break;
+    case 3:  // top-down rows, some with trailing garbage
+        put32(22, (uint32_t)-img.height);
+        if (c.below(2)) file.resize(file.size() + c.below(16), 0xAA);
+        break;
+    default:  // random bytes behind a valid signature
+        file = c.bytes(c.below(80));
+        if (file.size() >= 2) file[0] = 'B', file[1] = 'M';
+    }
+    LLVMFuzzerTestOneInput(file.data(), file.size());
+    return 1;
+}
+
+} // namespace
+
+#ifndef TF_LIBFUZZER
+int main(int argc, char* argv[]) {
+    double seconds = 6;
+    uint64_t seed = 1;
+    std::string golden = "golden";
+    bool write = false;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--seconds" && i + 1 < argc) seconds = std::atof(argv[++i]);
+        else if (arg == "--seed" && i + 1 < argc) seed = std::strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--golden" && i + 1 < argc) golden = argv[++i];
+        else if (arg == "--write-golden") write = true;
+        else {
+            std::printf("usage: %s [--seconds N] [--seed N] [--golden DIR] [--write-golden]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (write) {
+        write_golden(golden);
+        return 0;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    test_hamming();
+    std::printf("[PASS] Hamming(7,4) tables, all nibbles and codewords\n");
+    run_suites(seconds, seed);
+    check_golden(golden);
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::printf("All %llu differential cases passed in %.1f s.\n", (unsigned long long)g_cases, elapsed);
+    return 0;
+}
+#endif
@@ -0,0 +1,90 @@
+// test_sequence.cpp
+// Y4M frame sequences: 8-bit colorspaces round trip, others are refused
+#include "src/sequence.h"
+#include <cassert>
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+constexpr int kWidth = 32;
+constexpr int kHeight = 24;
+constexpr int kFrames = 4;
+
+std::string scratch(const std::string& name) { return (fs::temp_directory_path() / name).string(); }
+
+// Writes kFrames frames of random plane bytes, `frame_bytes` each.
+void write_y4m(const std::string& path, const std::string& colorspace, size_t frame_bytes) {
+    std::FILE* f = std::fopen(path.c_str(), "wb");
+    assert(f);
+    std::string header = "YUV4MPEG2 W" + std::to_string(kWidth) + " H" + std::to_string(kHeight) +
+                         " F25:1 Ip A1:1 C" + colorspace + "\n";
+    std::fwrite(header.data(), 1, header.size(), f);
+    std::mt19937 rng(11);
+    std::vector<uint8_t> frame(frame_bytes);
+    for (int i = 0; i < kFrames; ++i) {
+        for (auto& b : frame) b = (uint8_t)rng();
+        std::fwrite("FRAME\n", 1, 6, f);
+        std::fwrite(frame.data(), 1, frame.size(), f);
+    }
+    std::fclose(f);
+}
+
+void test_round_trip(const std::string& colorspace, size_t frame_bytes) {
+    std::string input = scratch("tf_seq_in.y4m"), output = scratch("tf_seq_out.y4m");
+    write_y4m(input, colorspace, frame_bytes);
+    // Spans more than one frame
+    std::vector<uint8_t> message(frame_bytes / 8 + 8);
+    std::mt19937 rng(2);
+    for (auto& b : message) b = (uint8_t)rng();
+
+    SequenceOptions options;
+    options.passphrase = "seq";
+    SequenceStats stats = sequence_encode(input, output, message, options);
+    assert(stats.frames == kFrames && stats.payload_frames == 2);
+    assert(fs::file_size(output) == fs::file_size(input));
+    assert(sequence_decode(output, options) == message);
+    fs::remove(input);
+    fs::remove(output);
+    std::cout << "[PASS] Y4M round trip (C" << colorspace << ")\n";
+}
+
+void test_unsupported(const std::string& colorspace, size_t frame_bytes) {
+    std::string input = scratch("tf_seq_in.y4m"), output = scratch("tf_seq_out.y4m");
+    fs::remove(output);
+    write_y4m(input, colorspace, frame_bytes);
+    std::vector<uint8_t> message(16, 'x');
+    for (int decode = 0; decode < 2; ++decode) {
+        std::string error;
+        try {
+            if (decode) sequence_decode(input, SequenceOptions());
+            else sequence_encode(input, output, message, SequenceOptions());
+        } catch (const std::runtime_error& e) {
+            error = e.what();
+        }
+        assert(error.find("Unsupported Y4M colorspace") != std::string::npos);
+    }
+    // Refused before any output is written
+    assert(!fs::exists(output));
+    fs::remove(input);
+    std::cout << "[PASS] Y4M colorspace C" << colorspace << " refused\n";
+}
+
+int main() {
+    const size_t luma = kWidth * kHeight, quarter = luma / 4;
+    test_round_trip("420jpeg", luma + 2 * quarter);
+    test_round_trip("422", luma * 2);
+    test_round_trip("444", luma * 3);
+    test_round_trip("mono", luma);
+    test_unsupported("444alpha", luma * 4);
+    test_unsupported("420p10", (luma + 2 * quarter) * 2);
+    test_unsupported("422p12", luma * 4);
+    test_unsupported("444p16", luma * 6);
+    std::cout << "All sequence tests passed!\n";
+    return 0;
+}
@@ -0,0 +1,32 @@
+// test_simulate.cpp
+// Channel-noise simulator: every noise model injects the requested BER
+#include "src/simulate.h"
+#include <cassert>
+#include <cmath>
+#include <iostream>
+
+void test_measured_ber(NoiseModel model, int burst_length) {
+    SimulationOptions options;
+    options.codecs = {SimCodec::None};
+    options.bers = {1e-3, 1e-2, 5e-2, 2e-1};
+    options.interleave = {1};
+    options.model = model;
+    options.burst_length = burst_length;
+    options.payload_bytes = 4096;
+    options.trials = 4000;
+    for (const SimulationPoint& point : run_simulation(options)) {
+        // About 3 sigma for the fewest bursts (length 32 at 1e-3)
+        assert(std::fabs(point.measured_ber() / point.ber - 1) <= 0.05);
+    }
+    std::cout << "[PASS] Measured BER matches the request (" << noise_model_name(model);
+    if (model == NoiseModel::Burst) std::cout << ", length " << burst_length;
+    std::cout << ")\n";
+}
+
+int main() {
+    test_measured_ber(NoiseModel::Random, 1);
+    test_measured_ber(NoiseModel::Burst, 8);
+    test_measured_ber(NoiseModel::Burst, 32);
+    std::cout << "All simulator tests passed!\n";
+    return 0;
+}
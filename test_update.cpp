@@ -0,0 +1,120 @@
+// test_update.cpp
+// In-place update of legacy and container covers
+#include "src/bmp.h"
+#include "src/container.h"
+#include "src/stego.h"
+#include "src/update.h"
+#include <cassert>
+#include <filesystem>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+std::string scratch_path() { return (fs::temp_directory_path() / "tf_update_test.bmp").string(); }
+
+BMPImage make_cover(int width, int height) {
+    BMPImage img;
+    img.width = width;
+    img.height = height;
+    img.data.resize((size_t)width * height * 3);
+    std::mt19937 rng(3);
+    for (auto& b : img.data) b = (uint8_t)rng();
+    return img;
+}
+
+std::vector<uint8_t> random_message(size_t n, unsigned seed) {
+    std::vector<uint8_t> message(n);
+    std::mt19937 rng(seed);
+    for (auto& b : message) b = (uint8_t)rng();
+    return message;
+}
+
+void test_legacy(const std::string& passphrase) {
+    std::string path = scratch_path();
+    BMPImage img = make_cover(64, 48);
+    encode_legacy_message(img, random_message(300, 1), passphrase);
+    write_bmp(path, img);
+
+    std::vector<uint8_t> message = random_message(200, 2);
+    UpdateStats stats = lsb_update_file(path, message, passphrase);
+    assert(!stats.container);
+    assert(stats.old_header_valid && stats.old_payload_bytes == 600);
+    DecodedMessage decoded = decode_message_file(path, passphrase);
+    assert(!decoded.container);
+    assert(decoded.data == message);
+    fs::remove(path);
+    std::cout << "[PASS] Legacy update" << (passphrase.empty() ? "" : " (keyed)") << "\n";
+}
+
+void test_container(const std::string& label, KernelParams params, const std::string& passphrase) {
+    std::string path = scratch_path();
+    BMPImage img = make_cover(96, 64);
+    ContainerOptions options;
+    options.params = params;
+    options.passphrase = passphrase;
+    container_encode(img, random_message(500, 1), options);
+    write_bmp(path, img);
+
+    // Shorter, then longer than the original message
+    for (size_t n : {120, 900}) {
+        std::vector<uint8_t> message = random_message(n, (unsigned)n);
+        UpdateStats stats = lsb_update_file(path, message, passphrase);
+        assert(stats.container);
+        assert(stats.params.bits_per_channel == params.bits_per_channel);
+        assert(stats.params.channel_mask == params.channel_mask);
+        assert(stats.params.ecc == params.ecc);
+        DecodedMessage decoded = decode_message_file(path, passphrase);
+        assert(decoded.container);
+        assert(decoded.header.params.bits_per_channel == params.bits_per_channel);
+        assert(decoded.data == message);
+    }
+    fs::remove(path);
+    std::cout << "[PASS] Container update (" << label << ")\n";
+}
+
+void test_refusal() {
+    std::string path = scratch_path();
+    BMPImage img = make_cover(96, 64);
+    ContainerOptions options;
+    options.params = KernelParams{2, 0x7, BitOrder::MsbFirst, EccType::Hamming74};
+    options.passphrase = "k";
+    std::vector<uint8_t> original = random_message(500, 1);
+    container_encode(img, original, options);
+    write_bmp(path, img);
+    std::vector<uint8_t> before = encode_bmp(load_bmp(path));
+
+    // Wrong passphrase: neither a container nor a legacy header, file untouched
+    bool threw = false;
+    try {
+        lsb_update_file(path, random_message(100, 9), "other");
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    assert(threw);
+    // Overflow under the container's own kernel
+    threw = false;
+    try {
+        lsb_update_file(path, random_message(100000, 9), "k");
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    assert(threw);
+    assert(encode_bmp(load_bmp(path)) == before);
+    assert(decode_message_file(path, "k").data == original);
+    fs::remove(path);
+    std::cout << "[PASS] Update refuses covers it cannot read\n";
+}
+
+int main() {
+    test_legacy("");
+    test_legacy("k");
+    test_container("1 bit, hamming", KernelParams{1, 0x7, BitOrder::MsbFirst, EccType::Hamming74}, "");
+    test_container("2 bits, keyed", KernelParams{2, 0x7, BitOrder::MsbFirst, EccType::Hamming74}, "k");
+    test_container("2 bits, g only, no ECC, keyed", KernelParams{2, 0x2, BitOrder::LsbFirst, EccType::None}, "k");
+    test_refusal();
+    std::cout << "All update tests passed!\n";
+    return 0;
+}